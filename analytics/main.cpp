@@ -0,0 +1,293 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+const string CSV_HEADER = "TIME,ADDRESS,HOP_TABLE_SIZE,POSITION_X,POSITION_Y,ERROR_X,ERROR_Y,EVENTCODE";
+
+struct Options {
+    uint64_t bucket_ms = 500;
+    uint32_t grid_width = 10;
+    double step = 50;
+    double cell = 100;
+    uint32_t min_beacons = 3;
+    bool evolution = false;
+    bool heatmap = false;
+    bool disables = false;
+    bool nodes = false;
+    unsigned threads = 0;
+};
+
+// Last known state of a node while streaming a file
+struct NodeState {
+    int64_t first_localized_ms = -1;
+    uint32_t table_size = 0;
+    double error = 0;
+    bool localized = false;
+};
+
+// Everything computed from one result file
+struct FileResult {
+    string path;
+    string error;
+    uint64_t rows = 0;
+    map<uint32_t, NodeState> nodes;
+    // bucket -> mean localization error over the nodes localized at the end of the bucket
+    vector<pair<uint64_t, double>> evolution;
+    // time of each DISABLED_NODE and the EXPIRED_ENTRY events up to the next one
+    vector<pair<uint64_t, uint64_t>> disables;
+    // cell (row, column) -> sum of final errors and node count
+    map<pair<int, int>, pair<double, uint32_t>> heatmap;
+};
+
+vector<string> splitByComma(const string& line) {
+    vector<string> parts;
+    string buf;
+    for(char c : line) {
+        if(c == ',') {
+            parts.push_back(buf);
+            buf.clear();
+        } else if(c != ' ' && c != '\r') {
+            buf += c;
+        }
+    }
+    parts.push_back(buf);
+    return parts;
+}
+
+// 10.0.0.k is node k - 1, as assigned by Ipv4AddressHelper in the example
+uint32_t nodeFromAddress(const string& address) {
+    size_t dot = address.rfind('.');
+    size_t second = address.rfind('.', dot - 1);
+    uint32_t b3 = (uint32_t) atoi(address.substr(second + 1, dot - second - 1).c_str());
+    uint32_t b4 = (uint32_t) atoi(address.substr(dot + 1).c_str());
+    return b3 * 256 + b4 - 1;
+}
+
+double meanError(const map<uint32_t, NodeState>& nodes) {
+    double sum = 0;
+    uint32_t count = 0;
+    for(auto const& n : nodes) {
+        if(n.second.localized) {
+            sum += n.second.error;
+            count++;
+        }
+    }
+    return count ? sum / count : 0.0;
+}
+
+void analyzeFile(FileResult& result, const Options& opt) {
+    ifstream in(result.path);
+    if(!in) {
+        result.error = "cannot open";
+        return;
+    }
+
+    uint64_t current_bucket = 0;
+    bool have_bucket = false;
+    string line;
+    while(getline(in, line)) {
+        // stats_to_csv writes its header without a line break
+        if(line.compare(0, CSV_HEADER.size(), CSV_HEADER) == 0) {
+            line = line.substr(CSV_HEADER.size());
+        }
+        if(line.empty()) { continue; }
+        vector<string> parts = splitByComma(line);
+        if(parts.size() < 8 || parts[0].empty()) { continue; }
+        result.rows++;
+
+        uint64_t time = strtoull(parts[0].c_str(), nullptr, 10);
+        uint64_t bucket = time / opt.bucket_ms;
+        if(!have_bucket) {
+            current_bucket = bucket;
+            have_bucket = true;
+        }
+        while(current_bucket < bucket) {
+            result.evolution.push_back(make_pair(current_bucket * opt.bucket_ms, meanError(result.nodes)));
+            current_bucket++;
+        }
+
+        const string& event = parts[7];
+        if(event == "DISABLED_NODE") {
+            result.disables.push_back(make_pair(time, 0));
+            continue;
+        }
+        if(event == "EXPIRED_ENTRY") {
+            if(!result.disables.empty()) { result.disables.back().second++; }
+            continue;
+        }
+        if(parts[1].empty()) { continue; }
+
+        NodeState& node = result.nodes[nodeFromAddress(parts[1])];
+        node.table_size = (uint32_t) atoi(parts[2].c_str());
+        if(node.table_size >= opt.min_beacons) {
+            if(node.first_localized_ms < 0) { node.first_localized_ms = (int64_t) time; }
+            double ex = atof(parts[5].c_str());
+            double ey = atof(parts[6].c_str());
+            node.error = sqrt(ex * ex + ey * ey);
+            node.localized = true;
+        }
+    }
+    if(have_bucket) {
+        result.evolution.push_back(make_pair(current_bucket * opt.bucket_ms, meanError(result.nodes)));
+    }
+
+    // Bin the final error of every localized node by its grid position
+    for(auto const& n : result.nodes) {
+        if(!n.second.localized) { continue; }
+        double x = opt.step * (1 + n.first % opt.grid_width);
+        double y = opt.step * (1 + n.first / opt.grid_width);
+        pair<double, uint32_t>& cell = result.heatmap[make_pair((int) (y / opt.cell), (int) (x / opt.cell))];
+        cell.first += n.second.error;
+        cell.second++;
+    }
+}
+
+double percentile(vector<double> values, double p) {
+    if(values.empty()) { return 0; }
+    sort(values.begin(), values.end());
+    size_t index = (size_t) ceil(p * values.size()) - 1;
+    return values[min(index, values.size() - 1)];
+}
+
+void printSummary(const vector<FileResult>& results, const Options& opt) {
+    cout << "FILE,ROWS,NODES,NODES_" << opt.min_beacons << "_BEACONS,T" << opt.min_beacons << "_MEAN_MS,";
+    cout << "T" << opt.min_beacons << "_P50_MS,T" << opt.min_beacons << "_MAX_MS,FINAL_MEAN_ERROR,FINAL_P95_ERROR,";
+    cout << "DISABLES,EXPIRED_PER_DISABLE_MEAN,EXPIRED_PER_DISABLE_MAX\n";
+    for(const FileResult& r : results) {
+        if(!r.error.empty()) {
+            cout << r.path << ",ERROR," << r.error << "\n";
+            continue;
+        }
+        vector<double> times;
+        vector<double> errors;
+        for(auto const& n : r.nodes) {
+            if(n.second.first_localized_ms >= 0) { times.push_back((double) n.second.first_localized_ms); }
+            if(n.second.localized) { errors.push_back(n.second.error); }
+        }
+        double t_mean = 0;
+        for(double t : times) { t_mean += t; }
+        if(!times.empty()) { t_mean /= times.size(); }
+        double e_mean = 0;
+        for(double e : errors) { e_mean += e; }
+        if(!errors.empty()) { e_mean /= errors.size(); }
+        double x_mean = 0;
+        uint64_t x_max = 0;
+        for(auto const& d : r.disables) {
+            x_mean += d.second;
+            x_max = max(x_max, d.second);
+        }
+        if(!r.disables.empty()) { x_mean /= r.disables.size(); }
+
+        cout << r.path << "," << r.rows << "," << r.nodes.size() << "," << times.size() << ",";
+        cout << t_mean << "," << percentile(times, 0.5) << "," << percentile(times, 1.0) << ",";
+        cout << e_mean << "," << percentile(errors, 0.95) << ",";
+        cout << r.disables.size() << "," << x_mean << "," << x_max << "\n";
+    }
+}
+
+void printDetails(const vector<FileResult>& results, const Options& opt) {
+    if(opt.nodes) {
+        cout << "FILE,NODE,FIRST_" << opt.min_beacons << "_BEACONS_MS,FINAL_TABLE_SIZE,FINAL_ERROR\n";
+        for(const FileResult& r : results) {
+            for(auto const& n : r.nodes) {
+                cout << r.path << "," << n.first << "," << n.second.first_localized_ms << ",";
+                cout << n.second.table_size << "," << n.second.error << "\n";
+            }
+        }
+    }
+    if(opt.evolution) {
+        cout << "FILE,BUCKET_MS,MEAN_ERROR\n";
+        for(const FileResult& r : results) {
+            for(auto const& e : r.evolution) {
+                cout << r.path << "," << e.first << "," << e.second << "\n";
+            }
+        }
+    }
+    if(opt.disables) {
+        cout << "FILE,DISABLED_AT_MS,EXPIRED_ENTRIES_FOLLOWING\n";
+        for(const FileResult& r : results) {
+            for(auto const& d : r.disables) {
+                cout << r.path << "," << d.first << "," << d.second << "\n";
+            }
+        }
+    }
+    if(opt.heatmap) {
+        cout << "FILE,CELL_Y_M,CELL_X_M,NODES,MEAN_ERROR\n";
+        for(const FileResult& r : results) {
+            for(auto const& c : r.heatmap) {
+                cout << r.path << "," << c.first.first * opt.cell << "," << c.first.second * opt.cell << ",";
+                cout << c.second.second << "," << c.second.first / c.second.second << "\n";
+            }
+        }
+    }
+}
+
+void usage() {
+    cerr << "usage: analytics [options] result.csv [result.csv ...]\n";
+    cerr << "  -b ms        bucket size of the error evolution (default 500)\n";
+    cerr << "  -k n         beacons needed to count a node as localized (default 3)\n";
+    cerr << "  -w n         grid width in nodes (default 10)\n";
+    cerr << "  -s m         grid step in meters (default 50)\n";
+    cerr << "  -c m         heatmap cell size in meters (default 100)\n";
+    cerr << "  -j n         worker threads (default: all cores)\n";
+    cerr << "  --nodes      per-node time to localization and final error\n";
+    cerr << "  --evolution  mean error per bucket\n";
+    cerr << "  --disables   EXPIRED_ENTRY events following each DISABLED_NODE\n";
+    cerr << "  --heatmap    mean final error per grid cell\n";
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    vector<string> paths;
+    for(int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool has_value = i + 1 < argc;
+        if(arg == "-b" && has_value) { opt.bucket_ms = strtoull(argv[++i], nullptr, 10); }
+        else if(arg == "-k" && has_value) { opt.min_beacons = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-w" && has_value) { opt.grid_width = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-s" && has_value) { opt.step = atof(argv[++i]); }
+        else if(arg == "-c" && has_value) { opt.cell = atof(argv[++i]); }
+        else if(arg == "-j" && has_value) { opt.threads = (unsigned) atoi(argv[++i]); }
+        else if(arg == "--nodes") { opt.nodes = true; }
+        else if(arg == "--evolution") { opt.evolution = true; }
+        else if(arg == "--disables") { opt.disables = true; }
+        else if(arg == "--heatmap") { opt.heatmap = true; }
+        else if(arg == "-h" || arg == "--help") { usage(); return 0; }
+        else { paths.push_back(arg); }
+    }
+    if(paths.empty() || opt.bucket_ms == 0 || opt.grid_width == 0 || opt.cell <= 0) {
+        usage();
+        return 1;
+    }
+    unsigned threads = opt.threads ? opt.threads : thread::hardware_concurrency();
+    if(threads == 0) { threads = 1; }
+
+    vector<FileResult> results(paths.size());
+    for(size_t i = 0; i < paths.size(); i++) { results[i].path = paths[i]; }
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for(unsigned t = 0; t < threads && t < paths.size(); t++) {
+        workers.emplace_back([&]() {
+            size_t i;
+            while((i = next++) < results.size()) {
+                analyzeFile(results[i], opt);
+            }
+        });
+    }
+    for(thread& w : workers) { w.join(); }
+
+    printSummary(results, opt);
+    printDetails(results, opt);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#!/bin/sh
+# Runs dvhop-example once per distinct configuration.
+#
+# The cache key is a SHA-256 over the scenario parameters, the dvhop module
+# sources and the stats_to_csv source. When the key is already in the cache the stored results are copied
+# back without running anything; otherwise the simulation runs like
+# `make fullsim` and its results are stored under the key.
+#
+# usage: ./cached_sim.sh [size=N] [beacons=N] [step=M] [time=S] [damageExtent=N] [seed=N] [snapshotInterval=S]
+set -e
+
+NS3_DIR=${NS3_DIR:-~/ns-allinone-3.30.1/ns-3.30.1}
+CACHE_DIR=${CACHE_DIR:-./run_cache}
+
+# Defaults of dvhop-example, except snapshots which are on so they can be cached
+size=100
+beacons=12
+step=50
+time=10
+damageExtent=25
+seed=0
+snapshotInterval=1
+
+for arg in "$@"; do
+  case "$arg" in
+    size=*|beacons=*|step=*|time=*|damageExtent=*|seed=*|snapshotInterval=*)
+      eval "${arg%%=*}=\${arg#*=}" ;;
+    *)
+      echo "unknown parameter $arg" >&2
+      exit 1 ;;
+  esac
+done
+
+PARAMS="--size=$size --beacons=$beacons --step=$step --time=$time --damageExtent=$damageExtent --seed=$seed --snapshotInterval=$snapshotInterval"
+
+# Parameters, then every module source and the CSV converter with its own hash, in a stable order
+KEY=$( (echo "$PARAMS"; find ./dvhop -type f | LC_ALL=C sort | xargs sha256sum; sha256sum ./stats_to_csv/main.cpp) | sha256sum | cut -c1-64)
+ENTRY="$CACHE_DIR/$KEY"
+
+# Results kept per run, as they are named in the repository directory
+RESULTS="dvhop_output.txt dvhop_output.csv merged.pcap dvhop.snapshots dvhop.distances dvhop.positions dvhop.summary"
+
+if [ -f "$ENTRY/complete" ]; then
+  echo "Cache hit $KEY ($PARAMS)"
+  for f in $RESULTS; do
+    if [ -f "$ENTRY/$f" ]; then cp "$ENTRY/$f" .; fi
+  done
+  exit 0
+fi
+echo "Cache miss $KEY ($PARAMS)"
+
+echo "Copying source code to NS3 directory..."
+rm -rf "$NS3_DIR/src/dvhop"
+cp -R ./dvhop "$NS3_DIR/src"
+rm -f "$NS3_DIR"/*.pcap "$NS3_DIR/dvhop.snapshots"
+
+echo "Running 'dvhop-example $PARAMS'..."
+(cd "$NS3_DIR" && ./waf --run "dvhop-example $PARAMS") > dvhop_output.txt
+
+echo "Merging PCAP files..."
+rm -f merged.pcap
+if ls "$NS3_DIR"/*.pcap > /dev/null 2>&1; then
+  mergecap -w merged.pcap "$NS3_DIR"/*.pcap
+fi
+
+echo "Converting output to CSV..."
+(cd ./stats_to_csv && make build)
+./stats_to_csv/stats_to_csv < dvhop_output.txt > dvhop_output.csv
+
+for f in dvhop.snapshots dvhop.distances dvhop.positions dvhop.summary; do
+  if [ -f "$NS3_DIR/$f" ]; then cp "$NS3_DIR/$f" .; fi
+done
+
+# Fill a temporary entry and rename it, so an interrupted run never looks complete
+mkdir -p "$CACHE_DIR"
+TMP=$(mktemp -d "$CACHE_DIR/.tmp.XXXXXX")
+for f in $RESULTS; do
+  if [ -f "$f" ]; then cp "$f" "$TMP/"; fi
+done
+echo "$PARAMS" > "$TMP/params"
+touch "$TMP/complete"
+rm -rf "$ENTRY"
+mv "$TMP" "$ENTRY"
+echo "Stored $KEY"
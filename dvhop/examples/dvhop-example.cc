@@ -10,10 +10,25 @@
 #include "ns3/netanim-module.h"
 #include "ns3/wifi-mac-helper.h"
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
 #include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
 
 using namespace ns3;
 
+/// NetAnim output and the sampling window it records
+struct AnimationWindow
+{
+  AnimationInterface *anim;
+  Time start;
+  Time stop;
+};
+
 /**
  * This script is modified from the included example in the DV
  */
@@ -27,6 +42,10 @@ public:
   void Run ();
   /// Report results
   void Report (std::ostream & os);
+  /// True when a scenario list was given
+  bool IsBatch () const { return !scenarios.empty (); }
+  /// Run every scenario of the scenario list in this process, \return the number that failed
+  int RunScenarios (int argc, char **argv);
 
   /// Simulate damage to the WSN
   void DamageWSN(int n_to_damage);
@@ -51,6 +70,78 @@ private:
   bool printRoutes;
   /// Number of nodes to damage
   uint32_t d_extent;
+  /// Interval between binary distance table snapshots, seconds (0: disabled)
+  double snapshotInterval;
+  /// Time the protocol handlers if true
+  bool profile;
+  /// Store beacon positions once per simulation instead of once per node if true
+  bool sharedBeacons;
+  /// Send HELLOs without beacon positions if true
+  bool compactHello;
+  /// Maximum beacons per distance table (0: no limit)
+  uint32_t tableCapacity;
+  /// Beacon a full table drops: HighestHops, Oldest or Geometric
+  std::string evictionPolicy;
+  /// Run hierarchical DV-Hop with beacons as cluster heads if true
+  bool clustered;
+  /// Scope of the cluster heads' HELLOs in clustered mode, hops
+  uint32_t clusterHops;
+  /// Stop once no table or estimate changed for this long, seconds (0: run for totalTime)
+  double quietPeriod;
+  /// Statistics output file, stdout if empty, gzip-compressed if it ends in .gz
+  std::string statsFile;
+  /// Statistics records buffered between the simulator and the writer thread
+  uint32_t statsBuffer;
+  /// Drop statistics instead of waiting when the buffer is full if true
+  bool statsDrop;
+  /// Event scheduler: map, heap, calendar, list, wheel or a TypeId name
+  std::string scheduler;
+  /// Node positions and beacons, one "node x y isBeacon" per line, instead of the grid (empty: grid)
+  std::string topology;
+  /// Seed of the ns-3 random streams and of the position offsets and damage schedule (0: the defaults)
+  uint32_t seed;
+  /// Arithmetic of the localization: Double, Float or Q16.16
+  std::string numericType;
+  /// Hop size source: Local (per node) or Beacon (flooded beacon corrections)
+  std::string hopSizeMode;
+  /// Write stats records only on changes and keyframes if true
+  bool deltaReports;
+  /// Smallest position change reported in delta mode, meters
+  double reportEpsilon;
+  /// Longest time between two records of a node in delta mode, seconds (0: only changes)
+  double reportKeyframe;
+  /// Advertise new and shortened entries at once instead of at the next HELLO if true
+  bool triggeredUpdates;
+  /// Shortest time between two triggered updates of a node, seconds
+  double triggerInterval;
+  /// Refresh entries only from the neighbor they came from and switch to an alternate when it is silent if true
+  bool provenance;
+  /// Silence after which an entry gives up its neighbor, seconds
+  double providerTimeout;
+  /// Scenarios to run in this process, one "name [--arg=value ...]" per line (empty: a single run)
+  std::string scenarios;
+  //\}
+
+  ///\name animation
+  //\{
+  /// Write NetAnim output if true
+  bool animation;
+  /// NetAnim output file name
+  std::string animFile;
+  /// Start of the animation sampling window, seconds
+  double animStart;
+  /// End of the animation sampling window, seconds (0: end of simulation)
+  double animStop;
+  /// Trace every packet in the animation if true
+  bool animPackets;
+  /// Attach packet metadata to traced packets if true
+  bool animMetadata;
+  /// Maximum number of packets traced per animation file (0: no limit)
+  uint64_t animMaxPackets;
+  /// Record position estimate changes as node updates if true
+  bool animEstimates;
+  /// Compress the animation stream with gzip if true
+  bool animCompress;
   //\}
 
   ///\name network
@@ -66,14 +157,58 @@ private:
   void InstallInternetStack ();
   void InstallApplications ();
   void CreateBeacons();
+  bool LoadTopology ();
+  AnimationInterface *CreateAnimation (FILE **pipe);
+
+  /// Sampling window handed to the position estimate callbacks
+  AnimationWindow animWindow;
+
+  /// Detects steady state when quietPeriod is set
+  Ptr<ConvergenceMonitor> monitor;
+
+  ///\name loaded topology
+  //\{
+  std::vector<Vector> topologyPositions;
+  std::vector<bool> topologyBeacons;
+  //\}
 };
 
+// Records a node's new position estimate as a NetAnim node update
+static void
+AnimatePositionEstimate (const AnimationWindow *window, uint32_t nodeId, double x, double y)
+{
+  Time now = Simulator::Now ();
+  if (now < window->start || now > window->stop)
+    {
+      return;
+    }
+  std::ostringstream os;
+  os << "est (" << x << "," << y << ")";
+  window->anim->UpdateNodeDescription (nodeId, os.str ());
+}
+
+// Short names accepted for the ns-3 schedulers
+static std::string
+SchedulerTypeId (const std::string &name)
+{
+  if (name == "map")      return "ns3::MapScheduler";
+  if (name == "heap")     return "ns3::HeapScheduler";
+  if (name == "calendar") return "ns3::CalendarScheduler";
+  if (name == "list")     return "ns3::ListScheduler";
+  if (name == "wheel")    return "ns3::TimingWheelScheduler";
+  return name;
+}
+
 int main (int argc, char **argv)
 {
   DVHopExample test;
   if (!test.Configure (argc, argv))
     NS_FATAL_ERROR ("Configuration failed. Aborted.");
 
+  if (test.IsBatch ())
+    {
+      return test.RunScenarios (argc, argv) == 0 ? 0 : 1;
+    }
   test.Run ();
   test.Report (std::cout);
   return 0;
@@ -87,7 +222,41 @@ DVHopExample::DVHopExample () :
   totalTime (10), // Default simulation time: 10 seconds
   pcap (true), // Generate PCAPs by default
   printRoutes (true), // Print routes by default
-  d_extent(25) // Damage 25 nodes over the course of the simulation by default
+  d_extent(25), // Damage 25 nodes over the course of the simulation by default
+  snapshotInterval (0), // No binary distance table snapshots by default
+  profile (false),
+  sharedBeacons (true),
+  compactHello (false),
+  tableCapacity (0),
+  evictionPolicy ("HighestHops"),
+  clustered (false),
+  clusterHops (4),
+  quietPeriod (0), // Always simulate totalTime by default
+  statsFile (""), // Statistics go to stdout by default
+  statsBuffer (65536),
+  statsDrop (false), // Never lose statistics by default
+  scheduler ("map"), // The ns-3 default scheduler
+  topology (""), // Grid deployment by default
+  seed (0), // ns-3 seed 12345 and the C library's std::rand sequence, as before the option
+  numericType ("Double"),
+  hopSizeMode ("Local"), // Classic per-node hop size by default
+  deltaReports (false), // A record per HELLO by default
+  reportEpsilon (0.01),
+  reportKeyframe (1),
+  triggeredUpdates (false), // Periodic HELLOs only by default
+  triggerInterval (0.05),
+  provenance (false), // Any neighbor refreshes an entry by default
+  providerTimeout (0.6),
+  scenarios (""), // A single run by default
+  animation (false), // Animation output is expensive, off by default
+  animFile ("animation.xml"),
+  animStart (0),
+  animStop (0),
+  animPackets (false),
+  animMetadata (false),
+  animMaxPackets (0),
+  animEstimates (true),
+  animCompress (false)
 {
 }
 
@@ -97,7 +266,6 @@ bool DVHopExample::Configure (int argc, char **argv)
   // Enable DVHop logs by default. Comment this if too noisy
   LogComponentEnable("DVHopRoutingProtocol", LOG_LEVEL_ALL);
 
-  SeedManager::SetSeed (12345);
   CommandLine cmd;
 
   cmd.AddValue ("pcap", "Write PCAP traces.", pcap);
@@ -107,43 +275,323 @@ bool DVHopExample::Configure (int argc, char **argv)
   cmd.AddValue ("time", "Simulation time, s.", totalTime);
   cmd.AddValue ("step", "Grid step, m", step);
   cmd.AddValue ("damageExtent", "How much to damage the WSN", d_extent);
+  cmd.AddValue ("snapshotInterval", "Interval between binary distance table snapshots, s (0: disabled).", snapshotInterval);
+  cmd.AddValue ("profile", "Time the protocol handlers, reported in dvhop.summary.", profile);
+  cmd.AddValue ("sharedBeacons", "Store beacon positions once per simulation instead of once per node.", sharedBeacons);
+  cmd.AddValue ("compactHello", "Leave beacon positions out of HELLOs, receivers cache them.", compactHello);
+  cmd.AddValue ("tableCapacity", "Maximum beacons per distance table (0: no limit).", tableCapacity);
+  cmd.AddValue ("evictionPolicy", "Beacon a full table drops: HighestHops, Oldest or Geometric.", evictionPolicy);
+  cmd.AddValue ("clustered", "Hierarchical DV-Hop: beacons are cluster heads with a limited scope.", clustered);
+  cmd.AddValue ("clusterHops", "Scope of a cluster head in clustered mode, hops.", clusterHops);
+  cmd.AddValue ("quietPeriod", "Stop after this long without table or estimate changes, s (0: disabled).", quietPeriod);
+  cmd.AddValue ("statsFile", "Statistics output file, stdout if empty, gzip-compressed if it ends in .gz.", statsFile);
+  cmd.AddValue ("statsBuffer", "Statistics records buffered for the writer thread.", statsBuffer);
+  cmd.AddValue ("statsDrop", "Drop statistics instead of waiting when the buffer is full.", statsDrop);
+  cmd.AddValue ("scheduler", "Event scheduler: map, heap, calendar, list, wheel or a TypeId name.", scheduler);
+  cmd.AddValue ("topology", "Node positions and beacons (\"node x y isBeacon\" lines, e.g. from placement) instead of the grid.", topology);
+  cmd.AddValue ("animation", "Write NetAnim output.", animation);
+  cmd.AddValue ("animFile", "NetAnim output file.", animFile);
+  cmd.AddValue ("animStart", "Start of the animation sampling window, s.", animStart);
+  cmd.AddValue ("animStop", "End of the animation sampling window, s (0: end of simulation).", animStop);
+  cmd.AddValue ("animPackets", "Trace packets in the animation.", animPackets);
+  cmd.AddValue ("animMetadata", "Attach packet metadata to traced packets.", animMetadata);
+  cmd.AddValue ("animMaxPackets", "Max packets traced per animation file (0: no limit).", animMaxPackets);
+  cmd.AddValue ("animEstimates", "Record position estimate changes as node updates.", animEstimates);
+  cmd.AddValue ("animCompress", "Stream the animation through gzip.", animCompress);
+
+  cmd.AddValue ("numericType", "Arithmetic of the localization: Double, Float or Q16.16.", numericType);
+  cmd.AddValue ("hopSizeMode", "Hop size source: Local (per node) or Beacon (flooded beacon corrections).", hopSizeMode);
+  cmd.AddValue ("deltaReports", "Write stats records only when an estimate or beacon count changes, and at keyframes.", deltaReports);
+  cmd.AddValue ("reportEpsilon", "Smallest position change reported with deltaReports, m.", reportEpsilon);
+  cmd.AddValue ("reportKeyframe", "Longest time between two records of a node with deltaReports, s (0: only changes).", reportKeyframe);
+  cmd.AddValue ("triggeredUpdates", "Advertise new and shortened table entries at once, between the periodic HELLOs.", triggeredUpdates);
+  cmd.AddValue ("triggerInterval", "Shortest time between two triggered updates of a node, s.", triggerInterval);
+  cmd.AddValue ("provenance", "Follow the neighbor each table entry came from and switch to an alternate once it is silent.", provenance);
+  cmd.AddValue ("providerTimeout", "Silence after which an entry gives up its neighbor with provenance, s.", providerTimeout);
+  cmd.AddValue ("scenarios", "Scenario list file: one \"name [--arg=value ...]\" per line, each run in turn in this process.", scenarios);
+  cmd.AddValue ("seed", "Random seed; runs with the same parameters and seed give the same results (0: the defaults).", seed);
 
   cmd.Parse (argc, argv);
+  // Without a seed, std::rand restarts at the sequence of an unseeded program, so
+  // every scenario of a list still gives the results it gives alone
+  SeedManager::SetSeed (seed != 0 ? seed : 12345);
+  std::srand (seed != 0 ? seed : 1);
+  if (!topology.empty ())
+    {
+      return LoadTopology ();
+    }
   return true;
 }
 
+// Reads a topology file, written as dvhop.positions or by the placement optimizer.
+// The number of nodes and beacons come from the file.
+bool DVHopExample::LoadTopology ()
+{
+  std::ifstream in (topology.c_str ());
+  if (!in)
+    {
+      std::cout << "Cannot open topology " << topology << "\n";
+      return false;
+    }
+  std::string line;
+  while (std::getline (in, line))
+    {
+      unsigned node;
+      double x, y;
+      int beacon = 0;
+      if (sscanf (line.c_str (), "%u %lf %lf %d", &node, &x, &y, &beacon) < 3)
+        {
+          continue;
+        }
+      if (node != topologyPositions.size ())
+        {
+          std::cout << "Topology " << topology << " must list nodes 0 to n-1 in order\n";
+          return false;
+        }
+      topologyPositions.push_back (Vector (x, y, 0));
+      topologyBeacons.push_back (beacon != 0);
+    }
+  size = topologyPositions.size ();
+  beacons = std::count (topologyBeacons.begin (), topologyBeacons.end (), true);
+  if (size < 2 || beacons < 1)
+    {
+      std::cout << "Topology " << topology << " needs at least 2 nodes and 1 beacon\n";
+      return false;
+    }
+  return true;
+}
+
+// Runs the scenarios of the scenario list one after the other in this process.
+// Each line names a scenario and gives its arguments, which override the ones of
+// the command line; the scenario's output files go to a directory of that name.
+int DVHopExample::RunScenarios (int argc, char **argv)
+{
+  std::ifstream in (scenarios.c_str ());
+  if (!in)
+    {
+      std::cout << "Cannot open scenario list " << scenarios << "\n";
+      return 1;
+    }
+  char cwd[4096];
+  if (getcwd (cwd, sizeof (cwd)) == 0)
+    {
+      NS_FATAL_ERROR ("Cannot read the working directory.");
+    }
+
+  // Arguments shared by every scenario, without the scenario list itself
+  std::vector<std::string> common;
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 12, "--scenarios=") != 0)
+        {
+          common.push_back (arg);
+        }
+    }
+
+  int failed = 0;
+  std::string line;
+  while (std::getline (in, line))
+    {
+      std::istringstream tokens (line);
+      std::string name;
+      if (!(tokens >> name) || name[0] == '#')
+        {
+          continue;
+        }
+      std::vector<std::string> args (1, argv[0]);
+      args.insert (args.end (), common.begin (), common.end ());
+      std::string arg;
+      while (tokens >> arg)
+        {
+          args.push_back (arg);
+        }
+      std::vector<char *> scenarioArgv;
+      for (size_t i = 0; i < args.size (); i++)
+        {
+          scenarioArgv.push_back (&args[i][0]);
+        }
+
+      std::cout << "Scenario " << name << "\n";
+      // Configured from the starting directory, so a relative topology file is found
+      DVHopExample scenario;
+      if (!scenario.Configure (scenarioArgv.size (), &scenarioArgv[0]))
+        {
+          std::cout << "Scenario " << name << ": configuration failed, skipped\n";
+          failed++;
+          continue;
+        }
+      if (scenario.statsFile.empty ())
+        {
+          // Statistics of different scenarios must not mix on stdout
+          scenario.statsFile = "dvhop_output.txt";
+        }
+      SystemPath::MakeDirectories (name);
+      if (chdir (name.c_str ()) != 0)
+        {
+          std::cout << "Scenario " << name << ": cannot enter its directory, skipped\n";
+          failed++;
+          continue;
+        }
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      scenario.Run ();
+      std::chrono::duration<double> wall = std::chrono::steady_clock::now () - start;
+      scenario.Report (std::cout);
+
+      // Process-wide state Simulator::Destroy leaves behind
+      Names::Clear ();
+      dvhop::BeaconRegistry::GetShared ()->Clear ();
+      if (chdir (cwd) != 0)
+        {
+          NS_FATAL_ERROR ("Cannot return to " << cwd);
+        }
+      std::cout << "Scenario " << name << " done in " << wall.count () << " s\n";
+    }
+  return failed;
+}
+
 // Runs ns3 simulation
 void DVHopExample::Run ()
 {
 //  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", UintegerValue (1)); // enable rts cts all the time.
+  ObjectFactory schedulerFactory;
+  schedulerFactory.SetTypeId (SchedulerTypeId (scheduler));
+  Simulator::SetScheduler (schedulerFactory);
+
   CreateNodes();
   CreateDevices();
   InstallInternetStack();
   CreateBeacons();
+  if (quietPeriod > 0)
+    {
+      monitor = Create<ConvergenceMonitor> (Seconds (quietPeriod));
+      monitor->Install ();
+    }
   DamageWSN(d_extent);
 
   std::cout << "Starting simulation for " << totalTime << " s ...\n";
 
   Simulator::Stop (Seconds (totalTime));
 
-  AnimationInterface anim("animation.xml");
+  dvhop::StatsWriter &stats = dvhop::StatsWriter::Get ();
+  if (!stats.Open (statsFile, statsDrop ? dvhop::StatsWriter::OVERFLOW_DROP : dvhop::StatsWriter::OVERFLOW_BLOCK, statsBuffer))
+    {
+      NS_FATAL_ERROR ("Could not open the statistics output " << statsFile);
+    }
+
+  FILE *animPipe = 0;
+  AnimationInterface *anim = 0;
+  if (animation)
+    {
+      anim = CreateAnimation (&animPipe);
+    }
 
   Simulator::Run ();
+
+  // Let the writer thread drain so nothing printed afterwards lands in the middle of the statistics
+  stats.Close ();
+
+  // Counters live in the protocol instances, read them before they are destroyed
+  DVHopHelper dvhop;
+  Ptr<OutputStreamWrapper> summaryStream = Create<OutputStreamWrapper> ("dvhop.summary", std::ios::out);
+  dvhop.PrintProtocolSummary (summaryStream);
+
   Simulator::Destroy ();
+
+  // The animation file must be closed before gzip can see the end of the stream
+  delete anim;
+  if (animPipe)
+    {
+      pclose (animPipe);
+    }
+}
+
+// Sets up NetAnim output restricted to the sampling window, optionally compressed
+AnimationInterface *
+DVHopExample::CreateAnimation (FILE **pipe)
+{
+  std::string fileName = animFile;
+  if (animCompress)
+    {
+      // NetAnim opens the file by name, so hand it the write end of a gzip pipe
+      *pipe = dvhop::OpenGzip (animFile + ".gz");
+      if (*pipe == 0)
+        {
+          NS_FATAL_ERROR ("Could not start gzip for the animation stream.");
+        }
+      std::ostringstream os;
+      os << "/dev/fd/" << fileno (*pipe);
+      fileName = os.str ();
+      if (animMaxPackets > 0)
+        {
+          std::cout << "animMaxPackets ignored: a compressed animation cannot be split into files.\n";
+          animMaxPackets = 0;
+        }
+    }
+
+  Time start = Seconds (animStart);
+  Time stop = Seconds (animStop > 0 ? animStop : totalTime);
+
+  AnimationInterface *anim = new AnimationInterface (fileName);
+  anim->SetStartTime (start);
+  anim->SetStopTime (stop);
+  anim->EnablePacketMetadata (animMetadata);
+  if (!animPackets)
+    {
+      anim->SkipPacketTracing ();
+    }
+  if (animMaxPackets > 0)
+    {
+      anim->SetMaxPktsPerTraceFile (animMaxPackets);
+    }
+
+  animWindow.anim = anim;
+  animWindow.start = start;
+  animWindow.stop = stop;
+  if (animEstimates)
+    {
+      for (uint32_t i = 0; i < size; i++)
+        {
+          Ptr<dvhop::RoutingProtocol> dvhop =
+            DynamicCast<dvhop::RoutingProtocol> (nodes.Get (i)->GetObject<Ipv4> ()->GetRoutingProtocol ());
+          dvhop->TraceConnectWithoutContext ("PositionEstimate",
+                                             MakeBoundCallback (&AnimatePositionEstimate, &animWindow, i));
+        }
+    }
+  return anim;
 }
 
-void DVHopExample::Report (std::ostream &)
+void DVHopExample::Report (std::ostream &os)
 {
+  const dvhop::StatsWriter &stats = dvhop::StatsWriter::Get ();
+  os << "Statistics: " << stats.GetWritten () << " records written, " << stats.GetDropped () << " dropped, "
+     << stats.GetStalls () << " simulator stalls on a full buffer\n";
+  if (monitor)
+    {
+      if (monitor->HasConverged ())
+        {
+          os << "Converged at " << monitor->GetConvergenceTime ().GetSeconds () << " s\n";
+        }
+      else
+        {
+          os << "No convergence within " << totalTime << " s\n";
+        }
+    }
 }
 
 //Disables the node at specified index
 void DVHopExample::DisableNode(int index)
 {
-  std::cout << "@STATS@TIME@" << Simulator::Now().GetMilliSeconds();
-  std::cout << "@EVENT@DISABLED_NODE@\n";
+  dvhop::StatsWriter::Get ().WriteEvent (Simulator::Now().GetMilliSeconds(), dvhop::STATS_EVENT_DISABLED_NODE);
 
   Ptr<ConstantPositionMobilityModel> mob = nodes.Get(index)->GetObject<ConstantPositionMobilityModel>();
   mob->SetPosition(Vector(100000 * (index + 1), 100000 * (index + 1), 100000 * (index + 1)));
+
+  if (monitor)
+    {
+      monitor->DisturbanceDone ();
+    }
 }
 
 // Takes the number of nodes to damage then figures out a list of random nodes to disable.
@@ -157,6 +605,10 @@ void DVHopExample::DamageWSN(int n_to_damage) {
     int scheduled_time_ms = std::rand() % total_time_ms;
     std::cout << "Scheduled damage at " << scheduled_time_ms << "\n";
     Simulator::Schedule(MilliSeconds(scheduled_time_ms), &DVHopExample::DisableNode, this, r_index);
+    if (monitor)
+      {
+        monitor->AddPendingDisturbance ();
+      }
   }
 }
 
@@ -172,8 +624,20 @@ void DVHopExample::CreateNodes ()
       std::cout << "Creating node: "<< os.str ()<< std::endl ;
       Names::Add (os.str (), nodes.Get (i));
     }
-  // Create grid and position nodes
   MobilityHelper mobility;
+  if (!topologyPositions.empty ())
+    {
+      Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+      for (uint32_t i = 0; i < size; i++)
+        {
+          positions->Add (topologyPositions[i]);
+        }
+      mobility.SetPositionAllocator (positions);
+      mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+      mobility.Install (nodes);
+      return;
+    }
+  // Create grid and position nodes
   mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
                                  "MinX", DoubleValue (step),
                                  "MinY", DoubleValue (step),
@@ -202,7 +666,17 @@ uint32_t stepThrough = this->size / this->beacons;
   Ptr<Ipv4RoutingProtocol> proto;
   Ptr<dvhop::RoutingProtocol> dvhop;
   Ptr<ConstantPositionMobilityModel> mob;
-  for(uint32_t i = 0; i < size; i++) {
+  if (!topologyPositions.empty ()) {
+    // Exact positions and beacons from the topology file
+    for (uint32_t i = 0; i < size; i++) {
+      dvhop = DynamicCast<dvhop::RoutingProtocol> (nodes.Get (i)->GetObject<Ipv4>()->GetRoutingProtocol ());
+      dvhop->SetPosition (topologyPositions[i].x, topologyPositions[i].y);
+      dvhop->SetPresetXY (topologyPositions[i].x, topologyPositions[i].y);
+      dvhop->SetIsBeacon (topologyBeacons[i]);
+    }
+    stepThrough = 0;
+  }
+  for(uint32_t i = 0; i < size && stepThrough > 0; i++) {
     proto = nodes.Get (i)->GetObject<Ipv4>()->GetRoutingProtocol ();
     mob = nodes.Get(i)->GetObject<ConstantPositionMobilityModel>();
     dvhop = DynamicCast<dvhop::RoutingProtocol> (proto);
@@ -214,11 +688,18 @@ uint32_t stepThrough = this->size / this->beacons;
     dvhop->SetPresetXY(r_x, r_y);
   }
 
-  for ( uint32_t i = 0; i < beacons; i++) {
+  for ( uint32_t i = 0; i < beacons && stepThrough > 0; i++) {
     proto = nodes.Get (i * stepThrough)->GetObject<Ipv4>()->GetRoutingProtocol ();
     dvhop = DynamicCast<dvhop::RoutingProtocol> (proto);
     dvhop->SetIsBeacon (true);
   }
+
+  // True positions, used to replay recorded hop tables offline
+  std::ofstream positions ("dvhop.positions");
+  for (uint32_t i = 0; i < size; i++) {
+    dvhop = DynamicCast<dvhop::RoutingProtocol> (nodes.Get (i)->GetObject<Ipv4>()->GetRoutingProtocol ());
+    positions << i << " " << dvhop->GetXPosition () << " " << dvhop->GetYPosition () << " " << dvhop->IsBeacon () << "\n";
+  }
 }
 
 // Install WiFi devices on nodes
@@ -244,6 +725,23 @@ void DVHopExample::InstallInternetStack ()
 {
   DVHopHelper dvhop;
   // you can configure DVhop attributes here using aodv.Set(name, value)
+  dvhop.Set ("Profiling", BooleanValue (profile));
+  // Compact HELLO receivers cache positions of their own
+  dvhop.Set ("SharedBeaconRegistry", BooleanValue (sharedBeacons && !compactHello));
+  dvhop.Set ("CompactHello", BooleanValue (compactHello));
+  dvhop.Set ("TableCapacity", UintegerValue (tableCapacity));
+  dvhop.Set ("EvictionPolicy", StringValue (evictionPolicy));
+  dvhop.Set ("Clustered", BooleanValue (clustered));
+  dvhop.Set ("ClusterHops", UintegerValue (clusterHops));
+  dvhop.Set ("NumericType", StringValue (numericType));
+  dvhop.Set ("HopSizeMode", StringValue (hopSizeMode));
+  dvhop.Set ("DeltaReports", BooleanValue (deltaReports));
+  dvhop.Set ("ReportEpsilon", DoubleValue (reportEpsilon));
+  dvhop.Set ("ReportKeyframeInterval", TimeValue (Seconds (reportKeyframe)));
+  dvhop.Set ("TriggeredUpdates", BooleanValue (triggeredUpdates));
+  dvhop.Set ("TriggeredUpdateInterval", TimeValue (Seconds (triggerInterval)));
+  dvhop.Set ("NeighborProvenance", BooleanValue (provenance));
+  dvhop.Set ("ProviderTimeout", TimeValue (Seconds (providerTimeout)));
   InternetStackHelper stack;
   stack.SetRoutingHelper (dvhop); // has effect on the next Install ()
   stack.Install (nodes);
@@ -251,9 +749,22 @@ void DVHopExample::InstallInternetStack ()
   address.SetBase ("10.0.0.0", "255.0.0.0");
   interfaces = address.Assign (devices);
 
+  // Fixed streams: a scenario gives the same results alone or after others in the same process
+  WifiHelper wifi;
+  int64_t stream = 0;
+  stream += wifi.AssignStreams (devices, stream);
+  stream += stack.AssignStreams (nodes, stream);
+  dvhop.AssignStreams (nodes, stream);
+
   Ptr<OutputStreamWrapper> distStream = Create<OutputStreamWrapper>("dvhop.distances", std::ios::out);
   dvhop.PrintDistanceTableAllAt(Seconds(9), distStream);
 
+  if (snapshotInterval > 0)
+    {
+      Ptr<OutputStreamWrapper> snapshotStream = Create<OutputStreamWrapper> ("dvhop.snapshots", std::ios::out | std::ios::binary);
+      dvhop.SnapshotDistanceTablesAt (Seconds (snapshotInterval), Seconds (snapshotInterval), snapshotStream);
+    }
+
   if (printRoutes)
     {
       Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper> ("dvhop.routes", std::ios::out);
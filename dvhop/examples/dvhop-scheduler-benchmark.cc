@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/dvhop-module.h"
+#include "ns3/core-module.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <chrono>
+
+using namespace ns3;
+
+/**
+ * Replays the event pattern of a DV-Hop grid without the network stack and
+ * measures the event rate of each scheduler:
+ *  - every node re-arms its HELLO timer each helloInterval,
+ *  - each timer expiry schedules one jittered send (0-10 ms) per known beacon,
+ *  - each send schedules a reception a few microseconds later at every neighbor.
+ */
+class SchedulerBenchmark
+{
+public:
+  SchedulerBenchmark (uint32_t nodes, uint32_t beacons, uint32_t neighbors, Time helloInterval);
+
+  /// Runs the workload for the given simulated time, \return the number of events processed
+  uint64_t Run (Time duration);
+
+private:
+  void HelloTimerExpire (uint32_t node);
+  void SendTo (uint32_t node);
+  void Receive (uint32_t node);
+  uint32_t Random (uint32_t max);
+
+  uint32_t m_nodes;
+  uint32_t m_beacons;
+  uint32_t m_neighbors;
+  Time     m_helloInterval;
+  uint64_t m_events;
+  uint64_t m_rng;
+};
+
+SchedulerBenchmark::SchedulerBenchmark (uint32_t nodes, uint32_t beacons, uint32_t neighbors, Time helloInterval)
+  : m_nodes (nodes),
+    m_beacons (beacons),
+    m_neighbors (neighbors),
+    m_helloInterval (helloInterval),
+    m_events (0),
+    m_rng (12345)
+{
+}
+
+uint32_t
+SchedulerBenchmark::Random (uint32_t max)
+{
+  // Same sequence for every scheduler
+  m_rng = m_rng * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (uint32_t) ((m_rng >> 33) % max);
+}
+
+void
+SchedulerBenchmark::HelloTimerExpire (uint32_t node)
+{
+  m_events++;
+  for (uint32_t b = 0; b < m_beacons; b++)
+    {
+      Simulator::Schedule (MilliSeconds (Random (11)), &SchedulerBenchmark::SendTo, this, node);
+    }
+  Simulator::Schedule (m_helloInterval, &SchedulerBenchmark::HelloTimerExpire, this, node);
+}
+
+void
+SchedulerBenchmark::SendTo (uint32_t node)
+{
+  m_events++;
+  for (uint32_t n = 0; n < m_neighbors; n++)
+    {
+      Simulator::Schedule (MicroSeconds (1 + Random (50)), &SchedulerBenchmark::Receive, this, (node + n + 1) % m_nodes);
+    }
+}
+
+void
+SchedulerBenchmark::Receive (uint32_t node)
+{
+  m_events++;
+}
+
+uint64_t
+SchedulerBenchmark::Run (Time duration)
+{
+  m_events = 0;
+  m_rng = 12345;
+  for (uint32_t i = 0; i < m_nodes; i++)
+    {
+      Simulator::Schedule (MilliSeconds (Random (m_helloInterval.GetMilliSeconds () + 1)),
+                           &SchedulerBenchmark::HelloTimerExpire, this, i);
+    }
+  Simulator::Stop (duration);
+  Simulator::Run ();
+  Simulator::Destroy ();
+  return m_events;
+}
+
+// Short names accepted for the ns-3 schedulers
+static std::string
+SchedulerTypeId (const std::string &name)
+{
+  if (name == "map")      return "ns3::MapScheduler";
+  if (name == "heap")     return "ns3::HeapScheduler";
+  if (name == "calendar") return "ns3::CalendarScheduler";
+  if (name == "list")     return "ns3::ListScheduler";
+  if (name == "wheel")    return "ns3::TimingWheelScheduler";
+  return name;
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t nodes = 1000;
+  uint32_t beacons = 12;
+  uint32_t neighbors = 8;
+  double helloInterval = 0.5;
+  double time = 10;
+  std::string schedulers = "map,heap,calendar,wheel";
+
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Number of nodes.", nodes);
+  cmd.AddValue ("beacons", "Beacons known by every node, one send each per HELLO.", beacons);
+  cmd.AddValue ("neighbors", "Receptions per send.", neighbors);
+  cmd.AddValue ("helloInterval", "HELLO interval, s.", helloInterval);
+  cmd.AddValue ("time", "Simulated time per run, s.", time);
+  cmd.AddValue ("schedulers", "Comma separated schedulers: map, heap, calendar, list, wheel or a TypeId name.", schedulers);
+  cmd.Parse (argc, argv);
+
+  std::cout << "SCHEDULER\tEVENTS\tWALL_S\tEVENTS_PER_S\n";
+  std::istringstream names (schedulers);
+  std::string name;
+  while (std::getline (names, name, ','))
+    {
+      ObjectFactory factory;
+      factory.SetTypeId (SchedulerTypeId (name));
+      Simulator::SetScheduler (factory);
+
+      SchedulerBenchmark benchmark (nodes, beacons, neighbors, Seconds (helloInterval));
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      uint64_t events = benchmark.Run (Seconds (time));
+      std::chrono::duration<double> wall = std::chrono::steady_clock::now () - start;
+
+      std::cout << name << "\t" << events << "\t" << std::fixed << std::setprecision (3) << wall.count () << "\t"
+                << std::setprecision (0) << events / wall.count () << "\n";
+      std::cout.unsetf (std::ios::floatfield);
+    }
+  return 0;
+}
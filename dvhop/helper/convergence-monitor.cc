@@ -0,0 +1,105 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "convergence-monitor.h"
+#include "ns3/dvhop.h"
+#include "ns3/node-list.h"
+#include "ns3/simulator.h"
+#include "ns3/ipv4.h"
+#include "ns3/callback.h"
+#include "ns3/stats-writer.h"
+
+namespace ns3 {
+
+  ConvergenceMonitor::ConvergenceMonitor (Time quietPeriod)
+    : m_quietPeriod (quietPeriod),
+      m_pending (0),
+      m_changed (false),
+      m_converged (false)
+  {
+    NS_ASSERT (quietPeriod.IsStrictlyPositive ());
+  }
+
+  void
+  ConvergenceMonitor::Install ()
+  {
+    for (uint32_t i = 0; i < NodeList::GetNNodes (); i++)
+      {
+        Ptr<Ipv4> ipv4 = NodeList::GetNode (i)->GetObject<Ipv4> ();
+        if (!ipv4)
+          {
+            continue;
+          }
+        Ptr<dvhop::RoutingProtocol> rp = DynamicCast<dvhop::RoutingProtocol> (ipv4->GetRoutingProtocol ());
+        if (!rp)
+          {
+            continue;
+          }
+        rp->TraceConnectWithoutContext ("DistanceTableChange",
+                                        MakeCallback (&ConvergenceMonitor::NotifyTableChange, Ptr<ConvergenceMonitor> (this)));
+        rp->TraceConnectWithoutContext ("PositionEstimate",
+                                        MakeCallback (&ConvergenceMonitor::NotifyPositionChange, Ptr<ConvergenceMonitor> (this)));
+      }
+
+    m_lastChange = Simulator::Now ();
+    m_checkEvent = Simulator::Schedule (m_quietPeriod, &ConvergenceMonitor::Check, Ptr<ConvergenceMonitor> (this));
+  }
+
+  void
+  ConvergenceMonitor::AddPendingDisturbance ()
+  {
+    m_pending++;
+  }
+
+  void
+  ConvergenceMonitor::DisturbanceDone ()
+  {
+    NS_ASSERT (m_pending > 0);
+    m_pending--;
+    Changed ();
+  }
+
+  void
+  ConvergenceMonitor::NotifyTableChange (Ipv4Address beacon, uint16_t hops)
+  {
+    Changed ();
+  }
+
+  void
+  ConvergenceMonitor::NotifyPositionChange (double x, double y)
+  {
+    Changed ();
+  }
+
+  void
+  ConvergenceMonitor::Changed ()
+  {
+    // Only remember the time, the pending check moves itself past it when it fires
+    m_lastChange = Simulator::Now ();
+    m_changed = true;
+  }
+
+  void
+  ConvergenceMonitor::Check ()
+  {
+    if (m_converged)
+      {
+        return;
+      }
+    Time now = Simulator::Now ();
+    if (m_changed && m_pending == 0 && now - m_lastChange >= m_quietPeriod)
+      {
+        m_converged = true;
+        dvhop::StatsWriter::Get ().WriteEvent (m_lastChange.GetMilliSeconds (), dvhop::STATS_EVENT_CONVERGED);
+        Simulator::Stop ();
+        return;
+      }
+
+    Time next = m_lastChange + m_quietPeriod;
+    if (next <= now)
+      {
+        next = now + m_quietPeriod;
+      }
+    m_checkEvent = Simulator::Schedule (next - now, &ConvergenceMonitor::Check, Ptr<ConvergenceMonitor> (this));
+  }
+
+}
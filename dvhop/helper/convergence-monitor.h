@@ -0,0 +1,68 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef CONVERGENCE_MONITOR_H
+#define CONVERGENCE_MONITOR_H
+
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+  /**
+   * Watches the DistanceTableChange and PositionEstimate traces of every
+   * dvhop::RoutingProtocol in NodeList and stops the simulator once nothing
+   * changed for a quiet period while no disturbance (e.g. node damage) is pending.
+   * Nothing is declared before the first change, so a network that has not
+   * started talking yet is not taken for a converged one.
+   *
+   * On convergence it prints @STATS@TIME@<ms>@EVENT@CONVERGED@, where the time is
+   * the last change seen, i.e. the moment the network reached steady state
+   */
+  class ConvergenceMonitor : public SimpleRefCount<ConvergenceMonitor>
+  {
+  public:
+    ConvergenceMonitor (Time quietPeriod);
+
+    /**
+     *Connects to the nodes in NodeList and starts watching from now
+     */
+    void Install ();
+
+    /**
+     *Announces a scheduled event that will disturb the network, convergence is not declared before it happened
+     */
+    void AddPendingDisturbance ();
+
+    /**
+     *Reports that an announced disturbance happened, it counts as a change
+     */
+    void DisturbanceDone ();
+
+    /**
+     *Whether the network was found to be in steady state
+     */
+    bool HasConverged () const          { return m_converged; }
+
+    /**
+     *Time of the last change before convergence was declared
+     */
+    Time GetConvergenceTime () const    { return m_lastChange; }
+
+  private:
+    void NotifyTableChange (Ipv4Address beacon, uint16_t hops);
+    void NotifyPositionChange (double x, double y);
+    void Changed ();
+    void Check ();
+
+    Time     m_quietPeriod;
+    Time     m_lastChange;
+    EventId  m_checkEvent;
+    uint32_t m_pending;
+    bool     m_changed;    // Whether any change was seen since Install
+    bool     m_converged;
+  };
+
+}
+
+#endif /* CONVERGENCE_MONITOR_H */
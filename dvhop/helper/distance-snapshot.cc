@@ -0,0 +1,176 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "distance-snapshot.h"
+#include "ns3/dvhop.h"
+#include "ns3/node-list.h"
+#include "ns3/simulator.h"
+#include "ns3/ipv4.h"
+
+#include <cstring>
+
+namespace ns3 {
+
+  const uint16_t DistanceSnapshotWriter::VERSION = 1;
+
+  DistanceSnapshotWriter::DistanceSnapshotWriter (Ptr<OutputStreamWrapper> stream)
+    : m_stream (stream),
+      m_keyframeWritten (false)
+  {
+  }
+
+  void
+  DistanceSnapshotWriter::Schedule (Time start, Time interval)
+  {
+    Simulator::Schedule (start, &DistanceSnapshotWriter::CaptureAndReschedule, Ptr<DistanceSnapshotWriter> (this), interval);
+  }
+
+  void
+  DistanceSnapshotWriter::CaptureAndReschedule (Time interval)
+  {
+    Capture ();
+    if (interval.IsStrictlyPositive ())
+      {
+        Simulator::Schedule (interval, &DistanceSnapshotWriter::CaptureAndReschedule, Ptr<DistanceSnapshotWriter> (this), interval);
+      }
+  }
+
+  void
+  DistanceSnapshotWriter::Capture ()
+  {
+    bool keyframe = !m_keyframeWritten;
+
+    //Collect the current state and the records that differ from the previous snapshot
+    std::map<uint32_t, NodeState> current;
+    std::vector<uint32_t> changedNodes;
+    for (uint32_t i = 0; i < NodeList::GetNNodes (); i++)
+      {
+        Ptr<Node> node = NodeList::GetNode (i);
+        Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+        if (!ipv4)
+          {
+            continue;
+          }
+        Ptr<dvhop::RoutingProtocol> rp = DynamicCast<dvhop::RoutingProtocol> (ipv4->GetRoutingProtocol ());
+        if (!rp)
+          {
+            continue;
+          }
+
+        NodeState &state = current[node->GetId ()];
+        state.isBeacon = rp->IsBeacon ();
+        state.x = rp->GetXPosition ();
+        state.y = rp->GetYPosition ();
+        const dvhop::DistanceTable &table = rp->GetDistanceTable ();
+        std::vector<Ipv4Address> beacons = table.GetKnownBeacons ();
+        for (std::vector<Ipv4Address>::const_iterator b = beacons.begin (); b != beacons.end (); ++b)
+          {
+            state.hops[b->Get ()] = table.GetHopsTo (*b);
+          }
+
+        std::map<uint32_t, NodeState>::const_iterator prev = m_previous.find (node->GetId ());
+        if (keyframe || prev == m_previous.end ()
+            || prev->second.x != state.x || prev->second.y != state.y
+            || prev->second.isBeacon != state.isBeacon || prev->second.hops != state.hops)
+          {
+            changedNodes.push_back (node->GetId ());
+          }
+      }
+
+    if (keyframe)
+      {
+        m_stream->GetStream ()->write ("DVHS", 4);
+        WriteU16 (VERSION);
+      }
+    WriteU8 (keyframe ? 'K' : 'D');
+    WriteU64 ((uint64_t) Simulator::Now ().GetNanoSeconds ());
+    WriteU32 (changedNodes.size ());
+
+    for (std::vector<uint32_t>::const_iterator n = changedNodes.begin (); n != changedNodes.end (); ++n)
+      {
+        const NodeState &state = current[*n];
+        std::map<uint32_t, NodeState>::const_iterator prev = m_previous.find (*n);
+        bool full = keyframe || prev == m_previous.end ();
+
+        //Sparse row: every entry for a keyframe, otherwise only added, changed and removed cells
+        std::vector<std::pair<uint32_t, uint16_t> > entries;
+        for (std::map<uint32_t, uint16_t>::const_iterator e = state.hops.begin (); e != state.hops.end (); ++e)
+          {
+            if (full)
+              {
+                entries.push_back (*e);
+                continue;
+              }
+            std::map<uint32_t, uint16_t>::const_iterator old = prev->second.hops.find (e->first);
+            if (old == prev->second.hops.end () || old->second != e->second)
+              {
+                entries.push_back (*e);
+              }
+          }
+        if (!full)
+          {
+            for (std::map<uint32_t, uint16_t>::const_iterator e = prev->second.hops.begin (); e != prev->second.hops.end (); ++e)
+              {
+                if (state.hops.find (e->first) == state.hops.end ())
+                  {
+                    entries.push_back (std::make_pair (e->first, (uint16_t) 0));
+                  }
+              }
+          }
+
+        bool positionChanged = full || prev->second.x != state.x || prev->second.y != state.y;
+        WriteU32 (*n);
+        WriteU8 ((positionChanged ? 1 : 0) | (state.isBeacon ? 2 : 0));
+        if (positionChanged)
+          {
+            WriteDouble (state.x);
+            WriteDouble (state.y);
+          }
+        WriteU16 (entries.size ());
+        for (std::vector<std::pair<uint32_t, uint16_t> >::const_iterator e = entries.begin (); e != entries.end (); ++e)
+          {
+            WriteU32 (e->first);
+            WriteU16 (e->second);
+          }
+      }
+
+    m_stream->GetStream ()->flush ();
+    m_previous.swap (current);
+    m_keyframeWritten = true;
+  }
+
+  void
+  DistanceSnapshotWriter::WriteU8 (uint8_t v)
+  {
+    m_stream->GetStream ()->put ((char) v);
+  }
+
+  void
+  DistanceSnapshotWriter::WriteU16 (uint16_t v)
+  {
+    WriteU8 (v & 0xff);
+    WriteU8 (v >> 8);
+  }
+
+  void
+  DistanceSnapshotWriter::WriteU32 (uint32_t v)
+  {
+    WriteU16 (v & 0xffff);
+    WriteU16 (v >> 16);
+  }
+
+  void
+  DistanceSnapshotWriter::WriteU64 (uint64_t v)
+  {
+    WriteU32 (v & 0xffffffff);
+    WriteU32 (v >> 32);
+  }
+
+  void
+  DistanceSnapshotWriter::WriteDouble (double v)
+  {
+    uint64_t bits;
+    std::memcpy (&bits, &v, sizeof (bits));
+    WriteU64 (bits);
+  }
+
+}
@@ -0,0 +1,86 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DISTANCE_SNAPSHOT_H
+#define DISTANCE_SNAPSHOT_H
+
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+#include "ns3/output-stream-wrapper.h"
+
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+  /*
+   Binary snapshot stream, all integers little endian, doubles as IEEE-754 bits
+
+   File header
+   +--------+--------+--------+--------+--------+--------+
+   |  'D'   |  'V'   |  'H'   |  'S'   |   Version (u16) |
+   +--------+--------+--------+--------+--------+--------+
+
+   Snapshot record, one per snapshot time
+   +--------+----------------------------+--------------------+
+   | Kind   | Time in nanoseconds (i64)  | Node records (u32) |
+   +--------+----------------------------+--------------------+
+   Kind is 'K' for a keyframe holding every node and entry, or 'D' for a delta
+   holding only the nodes and entries that changed since the previous snapshot
+
+   Node record
+   +-------------+--------+---------------------+------------------+
+   | Node (u32)  | Flags  | [X (f64) | Y (f64)] | Entries (u16)    |
+   +-------------+--------+---------------------+------------------+
+   Flags bit 0: position estimate present, bit 1: node is a beacon
+
+   Entry, a cell of the sparse node x beacon hop matrix
+   +-----------------------+--------------+
+   | Beacon address (u32)  | Hops (u16)   |
+   +-----------------------+--------------+
+   Hops 0 in a delta means the beacon was removed from the node's table
+   */
+
+  /**
+   * Captures the distance table and position estimate of every node in
+   * NodeList in a single event and appends it to a binary stream
+   */
+  class DistanceSnapshotWriter : public SimpleRefCount<DistanceSnapshotWriter>
+  {
+  public:
+    static const uint16_t VERSION;
+
+    DistanceSnapshotWriter (Ptr<OutputStreamWrapper> stream);
+
+    /**
+     *Schedules the first capture at start and, if interval is not zero, one every interval afterwards
+     */
+    void Schedule (Time start, Time interval);
+
+    /**
+     *Writes one snapshot of the whole network, as a delta after the first one
+     */
+    void Capture ();
+
+  private:
+    struct NodeState
+    {
+      bool isBeacon;
+      double x;
+      double y;
+      std::map<uint32_t, uint16_t> hops;
+    };
+
+    void CaptureAndReschedule (Time interval);
+    void WriteU8 (uint8_t v);
+    void WriteU16 (uint16_t v);
+    void WriteU32 (uint32_t v);
+    void WriteU64 (uint64_t v);
+    void WriteDouble (double v);
+
+    Ptr<OutputStreamWrapper> m_stream;
+    std::map<uint32_t, NodeState> m_previous;
+    bool m_keyframeWritten;
+  };
+
+}
+
+#endif /* DISTANCE_SNAPSHOT_H */
@@ -1,6 +1,7 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
 #include "dvhop-helper.h"
+#include "distance-snapshot.h"
 #include "ns3/dvhop.h"
 #include "ns3/node-list.h"
 #include "ns3/names.h"
@@ -11,6 +12,8 @@
 #include "ns3/dvhop.h"
 #include "ns3/wifi-mac-helper.h"
 
+#include <iomanip>
+
 namespace ns3 {
 
   DVHopHelper::DVHopHelper():Ipv4RoutingHelper()
@@ -73,6 +76,65 @@ namespace ns3 {
 
   }
 
+  void
+  DVHopHelper::SnapshotDistanceTablesAt (Time start, Time interval, Ptr<OutputStreamWrapper> stream) const
+  {
+    Ptr<DistanceSnapshotWriter> writer = Create<DistanceSnapshotWriter> (stream);
+    writer->Schedule (start, interval);
+  }
+
+  void
+  DVHopHelper::PrintProtocolSummary (Ptr<OutputStreamWrapper> stream) const
+  {
+    std::ostream *os = stream->GetStream ();
+    dvhop::ProtocolCounters total;
+    dvhop::HandlerProfile profile[dvhop::PROFILE_HANDLER_COUNT];
+
+    *os << "NODE\tHELLO_TX\tHELLO_RX\tPOSITION_TX\tBYTES_TX\tINSERTS\tIMPROVEMENTS\tTOUCHES\tEXPIRATIONS\tEVICTIONS\tREJECTIONS\tSWITCHES\tLOCALIZED\tSKIPPED\n";
+    for (uint32_t i = 0; i < NodeList::GetNNodes (); i++)
+      {
+        Ptr<Ipv4> ipv4 = NodeList::GetNode (i)->GetObject<Ipv4> ();
+        if (!ipv4)
+          {
+            continue;
+          }
+        Ptr<dvhop::RoutingProtocol> rp = DynamicCast<dvhop::RoutingProtocol> (ipv4->GetRoutingProtocol ());
+        if (!rp)
+          {
+            continue;
+          }
+        const dvhop::ProtocolCounters &c = rp->GetCounters ();
+        *os << i << "\t" << c.hellosSent << "\t" << c.hellosReceived << "\t"
+            << c.positionsSent << "\t" << c.bytesSent << "\t"
+            << c.inserts << "\t" << c.improvements << "\t" << c.touches << "\t" << c.expirations << "\t"
+            << c.evictions << "\t" << c.rejections << "\t" << c.switches << "\t"
+            << c.localizationsRun << "\t" << c.localizationsSkipped << "\n";
+        total += c;
+        for (int h = 0; h < dvhop::PROFILE_HANDLER_COUNT; h++)
+          {
+            profile[h].calls += rp->GetProfile ((dvhop::ProfiledHandler) h).calls;
+            profile[h].nanoseconds += rp->GetProfile ((dvhop::ProfiledHandler) h).nanoseconds;
+          }
+      }
+    *os << "TOTAL\t" << total.hellosSent << "\t" << total.hellosReceived << "\t"
+        << total.positionsSent << "\t" << total.bytesSent << "\t"
+        << total.inserts << "\t" << total.improvements << "\t" << total.touches << "\t" << total.expirations << "\t"
+        << total.evictions << "\t" << total.rejections << "\t" << total.switches << "\t"
+        << total.localizationsRun << "\t" << total.localizationsSkipped << "\n";
+
+    *os << "\nHANDLER\tCALLS\tTOTAL_MS\tMEAN_US\n";
+    std::streamsize precision = os->precision ();
+    for (int h = 0; h < dvhop::PROFILE_HANDLER_COUNT; h++)
+      {
+        double totalMs = profile[h].nanoseconds / 1e6;
+        double meanUs = profile[h].calls ? profile[h].nanoseconds / 1e3 / profile[h].calls : 0.0;
+        *os << dvhop::ProfiledHandlerName ((dvhop::ProfiledHandler) h) << "\t" << profile[h].calls << "\t"
+            << std::fixed << std::setprecision (3) << totalMs << "\t" << meanUs << "\n";
+      }
+    os->unsetf (std::ios::floatfield);
+    os->precision (precision);
+  }
+
   void
   DVHopHelper::Print (Ptr<Node> node, Ptr<OutputStreamWrapper> stream) const
   {
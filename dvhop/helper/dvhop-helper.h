@@ -46,6 +46,20 @@ namespace ns3 {
      */
     void PrintDistanceTableAllAt (Time printTime, Ptr<OutputStreamWrapper> stream) const;
 
+    /**
+     *Write a binary snapshot of every node's distance table and position estimate,
+     *captured in a single event at start and then every interval (a zero interval takes one snapshot).
+     *Snapshots after the first are stored as deltas, see DistanceSnapshotWriter for the format.
+     *The stream should be opened with std::ios::binary
+     */
+    void SnapshotDistanceTablesAt (Time start, Time interval, Ptr<OutputStreamWrapper> stream) const;
+
+    /**
+     *Print the activity counters of every node, their totals and, when the Profiling
+     *attribute was set, the time spent per handler. Meant to be called once after Simulator::Run
+     */
+    void PrintProtocolSummary (Ptr<OutputStreamWrapper> stream) const;
+
   private:
     void Print (Ptr<Node> node, Ptr<OutputStreamWrapper> stream) const;
 
@@ -0,0 +1,329 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "batch-localization.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DVHOP_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ns3
+{
+  namespace dvhop
+  {
+    // Below this the beacons are treated as coincident or collinear
+    static const double DEGENERATE_EPSILON = 1e-9;
+
+    /*
+     * All kernels evaluate the same expressions in the same order as
+     * RoutingProtocol::AvgHopSize and RoutingProtocol::Trilaterate, so that
+     * results agree with the per-node code.
+     */
+
+    static inline void
+    LocalizeOne (const BeaconTriples &in, size_t k, BatchPositions &out)
+    {
+      double x1 = in.x1[k], y1 = in.y1[k];
+      double x2 = in.x2[k], y2 = in.y2[k];
+      double x3 = in.x3[k], y3 = in.y3[k];
+      double sumHops = in.hops1[k] + in.hops2[k] + in.hops3[k];
+
+      double dx12 = x2 - x1, dy12 = y2 - y1;
+      double p12 = std::sqrt (dx12 * dx12 + dy12 * dy12);
+
+      double hopSize;
+      if (in.hopSize)
+        {
+          hopSize = in.hopSize[k];
+        }
+      else
+        {
+          double dx23 = x3 - x2, dy23 = y3 - y2;
+          double dx31 = x1 - x3, dy31 = y1 - y3;
+          double d23 = std::sqrt (dx23 * dx23 + dy23 * dy23);
+          double d31 = std::sqrt (dx31 * dx31 + dy31 * dy31);
+          double avgHops = sumHops / 3.0;
+          avgHops = (sumHops > 0.0) ? avgHops : 1.0;
+          hopSize = (p12 + d23 + d31) / (3.0 * avgHops);
+        }
+
+      double r1 = in.hops1[k] * hopSize;
+      double r2 = in.hops2[k] * hopSize;
+      double r3 = in.hops3[k] * hopSize;
+
+      bool ok = (p12 > DEGENERATE_EPSILON) && (sumHops > 0.0);
+      double safeP12 = ok ? p12 : 1.0;
+      double exx = dx12 / safeP12;
+      double exy = dy12 / safeP12;
+
+      double ax = x3 - x1;
+      double ay = y3 - y1;
+      double i = exx * ax + exy * ay;
+      double bx = x3 - x1 - i * exx;
+      double by = y3 - y1 - i * exy;
+      double bn = std::sqrt (bx * bx + by * by);
+      ok = ok && (bn > DEGENERATE_EPSILON * safeP12);
+      double safeBn = ok ? bn : 1.0;
+      double eyx = bx / safeBn;
+      double eyy = by / safeBn;
+      double j = eyx * ax + eyy * ay;
+      double safeJ = ok ? j : 1.0;
+
+      double x = (r1 * r1 - r2 * r2 + safeP12 * safeP12) / (safeP12 * 2.0);
+      double y = (r1 * r1 - r3 * r3 + i * i + j * j) / (safeJ * 2.0) - i * x / safeJ;
+
+      double cx = (x1 + x2 + x3) / 3.0;
+      double cy = (y1 + y2 + y3) / 3.0;
+      out.x[k] = ok ? x1 + x * exx + y * eyx : cx;
+      out.y[k] = ok ? y1 + x * exy + y * eyy : cy;
+      out.valid[k] = ok ? 1 : 0;
+    }
+
+    static void
+    LocalizeScalar (const BeaconTriples &in, size_t begin, size_t count, BatchPositions &out)
+    {
+      for (size_t k = begin; k < count; k++)
+        {
+          LocalizeOne (in, k, out);
+        }
+    }
+
+#ifdef DVHOP_BATCH_X86
+    // Keep mul/add pairs unfused so the vector kernels round like the scalar code
+#pragma GCC push_options
+#pragma GCC optimize ("fp-contract=off")
+
+    __attribute__ ((target ("avx2")))
+    static void
+    LocalizeAvx2 (const BeaconTriples &in, size_t count, BatchPositions &out)
+    {
+      const __m256d zero = _mm256_setzero_pd ();
+      const __m256d one = _mm256_set1_pd (1.0);
+      const __m256d two = _mm256_set1_pd (2.0);
+      const __m256d three = _mm256_set1_pd (3.0);
+      const __m256d eps = _mm256_set1_pd (DEGENERATE_EPSILON);
+
+      size_t k = 0;
+      for (; k + 4 <= count; k += 4)
+        {
+          __m256d x1 = _mm256_loadu_pd (in.x1 + k), y1 = _mm256_loadu_pd (in.y1 + k);
+          __m256d x2 = _mm256_loadu_pd (in.x2 + k), y2 = _mm256_loadu_pd (in.y2 + k);
+          __m256d x3 = _mm256_loadu_pd (in.x3 + k), y3 = _mm256_loadu_pd (in.y3 + k);
+          __m256d h1 = _mm256_loadu_pd (in.hops1 + k);
+          __m256d h2 = _mm256_loadu_pd (in.hops2 + k);
+          __m256d h3 = _mm256_loadu_pd (in.hops3 + k);
+          __m256d sumHops = _mm256_add_pd (_mm256_add_pd (h1, h2), h3);
+
+          __m256d dx12 = _mm256_sub_pd (x2, x1), dy12 = _mm256_sub_pd (y2, y1);
+          __m256d p12 = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (dx12, dx12), _mm256_mul_pd (dy12, dy12)));
+          __m256d hopsOk = _mm256_cmp_pd (sumHops, zero, _CMP_GT_OQ);
+
+          __m256d hopSize;
+          if (in.hopSize)
+            {
+              hopSize = _mm256_loadu_pd (in.hopSize + k);
+            }
+          else
+            {
+              __m256d dx23 = _mm256_sub_pd (x3, x2), dy23 = _mm256_sub_pd (y3, y2);
+              __m256d dx31 = _mm256_sub_pd (x1, x3), dy31 = _mm256_sub_pd (y1, y3);
+              __m256d d23 = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (dx23, dx23), _mm256_mul_pd (dy23, dy23)));
+              __m256d d31 = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (dx31, dx31), _mm256_mul_pd (dy31, dy31)));
+              __m256d avgHops = _mm256_blendv_pd (one, _mm256_div_pd (sumHops, three), hopsOk);
+              hopSize = _mm256_div_pd (_mm256_add_pd (_mm256_add_pd (p12, d23), d31), _mm256_mul_pd (three, avgHops));
+            }
+
+          __m256d r1 = _mm256_mul_pd (h1, hopSize);
+          __m256d r2 = _mm256_mul_pd (h2, hopSize);
+          __m256d r3 = _mm256_mul_pd (h3, hopSize);
+
+          __m256d ok = _mm256_and_pd (_mm256_cmp_pd (p12, eps, _CMP_GT_OQ), hopsOk);
+          __m256d safeP12 = _mm256_blendv_pd (one, p12, ok);
+          __m256d exx = _mm256_div_pd (dx12, safeP12);
+          __m256d exy = _mm256_div_pd (dy12, safeP12);
+
+          __m256d ax = _mm256_sub_pd (x3, x1);
+          __m256d ay = _mm256_sub_pd (y3, y1);
+          __m256d i = _mm256_add_pd (_mm256_mul_pd (exx, ax), _mm256_mul_pd (exy, ay));
+          __m256d bx = _mm256_sub_pd (ax, _mm256_mul_pd (i, exx));
+          __m256d by = _mm256_sub_pd (ay, _mm256_mul_pd (i, exy));
+          __m256d bn = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (bx, bx), _mm256_mul_pd (by, by)));
+          ok = _mm256_and_pd (ok, _mm256_cmp_pd (bn, _mm256_mul_pd (eps, safeP12), _CMP_GT_OQ));
+          __m256d safeBn = _mm256_blendv_pd (one, bn, ok);
+          __m256d eyx = _mm256_div_pd (bx, safeBn);
+          __m256d eyy = _mm256_div_pd (by, safeBn);
+          __m256d j = _mm256_add_pd (_mm256_mul_pd (eyx, ax), _mm256_mul_pd (eyy, ay));
+          __m256d safeJ = _mm256_blendv_pd (one, j, ok);
+
+          __m256d r1sq = _mm256_mul_pd (r1, r1);
+          __m256d x = _mm256_div_pd (_mm256_add_pd (_mm256_sub_pd (r1sq, _mm256_mul_pd (r2, r2)), _mm256_mul_pd (safeP12, safeP12)),
+                                     _mm256_mul_pd (safeP12, two));
+          __m256d yNum = _mm256_add_pd (_mm256_add_pd (_mm256_sub_pd (r1sq, _mm256_mul_pd (r3, r3)), _mm256_mul_pd (i, i)), _mm256_mul_pd (j, j));
+          __m256d y = _mm256_sub_pd (_mm256_div_pd (yNum, _mm256_mul_pd (safeJ, two)),
+                                     _mm256_div_pd (_mm256_mul_pd (i, x), safeJ));
+
+          __m256d px = _mm256_add_pd (_mm256_add_pd (x1, _mm256_mul_pd (x, exx)), _mm256_mul_pd (y, eyx));
+          __m256d py = _mm256_add_pd (_mm256_add_pd (y1, _mm256_mul_pd (x, exy)), _mm256_mul_pd (y, eyy));
+          __m256d cx = _mm256_div_pd (_mm256_add_pd (_mm256_add_pd (x1, x2), x3), three);
+          __m256d cy = _mm256_div_pd (_mm256_add_pd (_mm256_add_pd (y1, y2), y3), three);
+          _mm256_storeu_pd (out.x + k, _mm256_blendv_pd (cx, px, ok));
+          _mm256_storeu_pd (out.y + k, _mm256_blendv_pd (cy, py, ok));
+
+          int mask = _mm256_movemask_pd (ok);
+          out.valid[k] = mask & 1;
+          out.valid[k + 1] = (mask >> 1) & 1;
+          out.valid[k + 2] = (mask >> 2) & 1;
+          out.valid[k + 3] = (mask >> 3) & 1;
+        }
+      LocalizeScalar (in, k, count, out);
+    }
+
+    // _mm512_sqrt_pd reads an undefined register that GCC warns about
+    __attribute__ ((target ("avx512f")))
+    static inline __m512d
+    Sqrt512 (__m512d v)
+    {
+      return _mm512_mask_sqrt_pd (v, (__mmask8) 0xff, v);
+    }
+
+    __attribute__ ((target ("avx512f")))
+    static void
+    LocalizeAvx512 (const BeaconTriples &in, size_t count, BatchPositions &out)
+    {
+      const __m512d zero = _mm512_setzero_pd ();
+      const __m512d one = _mm512_set1_pd (1.0);
+      const __m512d two = _mm512_set1_pd (2.0);
+      const __m512d three = _mm512_set1_pd (3.0);
+      const __m512d eps = _mm512_set1_pd (DEGENERATE_EPSILON);
+
+      size_t k = 0;
+      for (; k + 8 <= count; k += 8)
+        {
+          __m512d x1 = _mm512_loadu_pd (in.x1 + k), y1 = _mm512_loadu_pd (in.y1 + k);
+          __m512d x2 = _mm512_loadu_pd (in.x2 + k), y2 = _mm512_loadu_pd (in.y2 + k);
+          __m512d x3 = _mm512_loadu_pd (in.x3 + k), y3 = _mm512_loadu_pd (in.y3 + k);
+          __m512d h1 = _mm512_loadu_pd (in.hops1 + k);
+          __m512d h2 = _mm512_loadu_pd (in.hops2 + k);
+          __m512d h3 = _mm512_loadu_pd (in.hops3 + k);
+          __m512d sumHops = _mm512_add_pd (_mm512_add_pd (h1, h2), h3);
+
+          __m512d dx12 = _mm512_sub_pd (x2, x1), dy12 = _mm512_sub_pd (y2, y1);
+          __m512d p12 = Sqrt512 (_mm512_add_pd (_mm512_mul_pd (dx12, dx12), _mm512_mul_pd (dy12, dy12)));
+          __mmask8 hopsOk = _mm512_cmp_pd_mask (sumHops, zero, _CMP_GT_OQ);
+
+          __m512d hopSize;
+          if (in.hopSize)
+            {
+              hopSize = _mm512_loadu_pd (in.hopSize + k);
+            }
+          else
+            {
+              __m512d dx23 = _mm512_sub_pd (x3, x2), dy23 = _mm512_sub_pd (y3, y2);
+              __m512d dx31 = _mm512_sub_pd (x1, x3), dy31 = _mm512_sub_pd (y1, y3);
+              __m512d d23 = Sqrt512 (_mm512_add_pd (_mm512_mul_pd (dx23, dx23), _mm512_mul_pd (dy23, dy23)));
+              __m512d d31 = Sqrt512 (_mm512_add_pd (_mm512_mul_pd (dx31, dx31), _mm512_mul_pd (dy31, dy31)));
+              __m512d avgHops = _mm512_mask_blend_pd (hopsOk, one, _mm512_div_pd (sumHops, three));
+              hopSize = _mm512_div_pd (_mm512_add_pd (_mm512_add_pd (p12, d23), d31), _mm512_mul_pd (three, avgHops));
+            }
+
+          __m512d r1 = _mm512_mul_pd (h1, hopSize);
+          __m512d r2 = _mm512_mul_pd (h2, hopSize);
+          __m512d r3 = _mm512_mul_pd (h3, hopSize);
+
+          __mmask8 ok = _mm512_cmp_pd_mask (p12, eps, _CMP_GT_OQ) & hopsOk;
+          __m512d safeP12 = _mm512_mask_blend_pd (ok, one, p12);
+          __m512d exx = _mm512_div_pd (dx12, safeP12);
+          __m512d exy = _mm512_div_pd (dy12, safeP12);
+
+          __m512d ax = _mm512_sub_pd (x3, x1);
+          __m512d ay = _mm512_sub_pd (y3, y1);
+          __m512d i = _mm512_add_pd (_mm512_mul_pd (exx, ax), _mm512_mul_pd (exy, ay));
+          __m512d bx = _mm512_sub_pd (ax, _mm512_mul_pd (i, exx));
+          __m512d by = _mm512_sub_pd (ay, _mm512_mul_pd (i, exy));
+          __m512d bn = Sqrt512 (_mm512_add_pd (_mm512_mul_pd (bx, bx), _mm512_mul_pd (by, by)));
+          ok = ok & _mm512_cmp_pd_mask (bn, _mm512_mul_pd (eps, safeP12), _CMP_GT_OQ);
+          __m512d safeBn = _mm512_mask_blend_pd (ok, one, bn);
+          __m512d eyx = _mm512_div_pd (bx, safeBn);
+          __m512d eyy = _mm512_div_pd (by, safeBn);
+          __m512d j = _mm512_add_pd (_mm512_mul_pd (eyx, ax), _mm512_mul_pd (eyy, ay));
+          __m512d safeJ = _mm512_mask_blend_pd (ok, one, j);
+
+          __m512d r1sq = _mm512_mul_pd (r1, r1);
+          __m512d x = _mm512_div_pd (_mm512_add_pd (_mm512_sub_pd (r1sq, _mm512_mul_pd (r2, r2)), _mm512_mul_pd (safeP12, safeP12)),
+                                     _mm512_mul_pd (safeP12, two));
+          __m512d yNum = _mm512_add_pd (_mm512_add_pd (_mm512_sub_pd (r1sq, _mm512_mul_pd (r3, r3)), _mm512_mul_pd (i, i)), _mm512_mul_pd (j, j));
+          __m512d y = _mm512_sub_pd (_mm512_div_pd (yNum, _mm512_mul_pd (safeJ, two)),
+                                     _mm512_div_pd (_mm512_mul_pd (i, x), safeJ));
+
+          __m512d px = _mm512_add_pd (_mm512_add_pd (x1, _mm512_mul_pd (x, exx)), _mm512_mul_pd (y, eyx));
+          __m512d py = _mm512_add_pd (_mm512_add_pd (y1, _mm512_mul_pd (x, exy)), _mm512_mul_pd (y, eyy));
+          __m512d cx = _mm512_div_pd (_mm512_add_pd (_mm512_add_pd (x1, x2), x3), three);
+          __m512d cy = _mm512_div_pd (_mm512_add_pd (_mm512_add_pd (y1, y2), y3), three);
+          _mm512_storeu_pd (out.x + k, _mm512_mask_blend_pd (ok, cx, px));
+          _mm512_storeu_pd (out.y + k, _mm512_mask_blend_pd (ok, cy, py));
+
+          for (int lane = 0; lane < 8; lane++)
+            {
+              out.valid[k + lane] = (ok >> lane) & 1;
+            }
+        }
+      LocalizeScalar (in, k, count, out);
+    }
+
+#pragma GCC pop_options
+#endif
+
+    bool
+    BatchKernelSupported (BatchKernel kernel)
+    {
+      switch (kernel)
+        {
+        case BATCH_KERNEL_AUTO:
+        case BATCH_KERNEL_SCALAR:
+          return true;
+#ifdef DVHOP_BATCH_X86
+        case BATCH_KERNEL_AVX2:
+          return __builtin_cpu_supports ("avx2");
+        case BATCH_KERNEL_AVX512:
+          return __builtin_cpu_supports ("avx512f");
+#endif
+        default:
+          return false;
+        }
+    }
+
+    BatchKernel
+    BatchLocalize (const BeaconTriples &in, size_t count, BatchPositions &out, BatchKernel kernel)
+    {
+      if (kernel == BATCH_KERNEL_AUTO)
+        {
+          kernel = BatchKernelSupported (BATCH_KERNEL_AVX512) ? BATCH_KERNEL_AVX512
+                 : BatchKernelSupported (BATCH_KERNEL_AVX2) ? BATCH_KERNEL_AVX2
+                 : BATCH_KERNEL_SCALAR;
+        }
+      else if (!BatchKernelSupported (kernel))
+        {
+          kernel = BATCH_KERNEL_SCALAR;
+        }
+
+      switch (kernel)
+        {
+#ifdef DVHOP_BATCH_X86
+        case BATCH_KERNEL_AVX512:
+          LocalizeAvx512 (in, count, out);
+          break;
+        case BATCH_KERNEL_AVX2:
+          LocalizeAvx2 (in, count, out);
+          break;
+#endif
+        default:
+          kernel = BATCH_KERNEL_SCALAR;
+          LocalizeScalar (in, 0, count, out);
+          break;
+        }
+      return kernel;
+    }
+  }
+}
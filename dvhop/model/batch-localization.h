@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef BATCH_LOCALIZATION_H
+#define BATCH_LOCALIZATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+    /**
+     * @brief Structure-of-arrays input for BatchLocalize: the three beacons
+     * chosen by each node and the hop count to each of them. Every array
+     * holds one element per node.
+     */
+    struct BeaconTriples
+    {
+      const double *x1;
+      const double *y1;
+      const double *hops1;
+      const double *x2;
+      const double *y2;
+      const double *hops2;
+      const double *x3;
+      const double *y3;
+      const double *hops3;
+      /// Optional hop size per node; when null it is computed from the three beacons (see RoutingProtocol::AvgHopSize)
+      const double *hopSize;
+    };
+
+    /**
+     * @brief Structure-of-arrays output of BatchLocalize
+     */
+    struct BatchPositions
+    {
+      double  *x;
+      double  *y;
+      /// 1 when the beacons allowed trilateration, 0 when the geometry was degenerate
+      /// (coincident or collinear beacons, zero hops) and the beacons' centroid was returned instead
+      uint8_t *valid;
+    };
+
+    enum BatchKernel
+    {
+      BATCH_KERNEL_AUTO,
+      BATCH_KERNEL_SCALAR,
+      BATCH_KERNEL_AVX2,
+      BATCH_KERNEL_AVX512
+    };
+
+    /**
+     * @brief BatchKernelSupported Whether the kernel can run on this CPU
+     */
+    bool BatchKernelSupported (BatchKernel kernel);
+
+    /**
+     * @brief BatchLocalize Runs the per-node DV-Hop localization of RoutingProtocol
+     * (hop size from the three beacons, then Trilaterate) over count nodes at once.
+     * Degenerate geometry is handled with masks, not branches.
+     * @param in The beacons and hop counts of each node
+     * @param count Number of nodes
+     * @param out The estimated positions
+     * @param kernel The kernel to use, BATCH_KERNEL_AUTO picks the widest one the CPU supports
+     * @return The kernel that was used
+     */
+    BatchKernel BatchLocalize (const BeaconTriples &in, size_t count, BatchPositions &out,
+                               BatchKernel kernel = BATCH_KERNEL_AUTO);
+  }
+}
+
+#endif // BATCH_LOCALIZATION_H
@@ -0,0 +1,70 @@
+#include "beacon-registry.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    Ptr<BeaconRegistry>
+    BeaconRegistry::GetShared ()
+    {
+      static Ptr<BeaconRegistry> shared = Create<BeaconRegistry> ();
+      return shared;
+    }
+
+    uint32_t
+    BeaconRegistry::Intern (Ipv4Address beacon, Position pos)
+    {
+      std::unordered_map<uint32_t, uint32_t>::const_iterator it = m_indices.find (beacon.Get ());
+      if (it != m_indices.end ())
+        {
+          return it->second;
+        }
+      uint32_t index;
+      if (!m_free.empty ())
+        {
+          index = m_free.back ();
+          m_free.pop_back ();
+          m_addresses[index] = beacon.Get ();
+          m_positions[index] = pos;
+        }
+      else
+        {
+          index = m_addresses.size ();
+          m_addresses.push_back (beacon.Get ());
+          m_positions.push_back (pos);
+        }
+      m_indices.insert (std::make_pair (beacon.Get (), index));
+      return index;
+    }
+
+    bool
+    BeaconRegistry::Lookup (Ipv4Address beacon, uint32_t &index) const
+    {
+      std::unordered_map<uint32_t, uint32_t>::const_iterator it = m_indices.find (beacon.Get ());
+      if (it == m_indices.end ())
+        {
+          return false;
+        }
+      index = it->second;
+      return true;
+    }
+
+    void
+    BeaconRegistry::Forget (uint32_t index)
+    {
+      m_indices.erase (m_addresses[index]);
+      m_free.push_back (index);
+    }
+
+    void
+    BeaconRegistry::Clear ()
+    {
+      m_addresses.clear ();
+      m_positions.clear ();
+      m_indices.clear ();
+      m_free.clear ();
+    }
+
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef BEACONREGISTRY_H
+#define BEACONREGISTRY_H
+
+#include <vector>
+#include <unordered_map>
+#include "ns3/ipv4-address.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/ptr.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+    typedef std::pair<double, double> Position;
+
+    /**
+     * @brief The BeaconRegistry class interns beacon addresses and positions
+     * so distance tables can refer to a beacon by a small index.
+     *
+     * Every DistanceTable has a registry of its own unless it is given the
+     * simulation-wide one returned by GetShared, in which case each beacon's
+     * position is stored once for the whole network.
+     */
+    class BeaconRegistry : public SimpleRefCount<BeaconRegistry>
+    {
+    public:
+      /**
+       * @brief GetShared The registry shared by every node of the simulation
+       */
+      static Ptr<BeaconRegistry> GetShared ();
+
+      /**
+       * @brief Intern Gets the index of a beacon, registering it with the position given if it is new
+       * @param beacon The beacon address
+       * @param pos The beacon position, ignored if the beacon is already registered
+       * @return The index of the beacon
+       */
+      uint32_t    Intern (Ipv4Address beacon, Position pos);
+
+      /**
+       * @brief Lookup Finds the index of a registered beacon
+       * @return false if the beacon was never registered
+       */
+      bool        Lookup (Ipv4Address beacon, uint32_t &index) const;
+
+      Ipv4Address GetAddress (uint32_t index) const   { return Ipv4Address (m_addresses[index]); }
+      uint32_t    GetAddressValue (uint32_t index) const { return m_addresses[index]; }
+      Position    GetPosition (uint32_t index) const  { return m_positions[index]; }
+      void        SetPosition (uint32_t index, Position pos) { m_positions[index] = pos; }
+      uint32_t    GetSize () const                    { return m_addresses.size () - m_free.size (); }
+
+      /**
+       * @brief Forget Drops a beacon, its index is reused by a later Intern.
+       * Only valid when no distance table refers to the beacon anymore
+       * @param index The index of the beacon
+       */
+      void        Forget (uint32_t index);
+
+      /**
+       * @brief Clear Forgets every beacon. Only valid when no distance table refers to the registry anymore
+       */
+      void        Clear ();
+
+    private:
+      std::vector<uint32_t>                  m_addresses;
+      std::vector<Position>                  m_positions;
+      std::unordered_map<uint32_t, uint32_t> m_indices;
+      std::vector<uint32_t>                  m_free;
+    };
+  }
+}
+
+#endif // BEACONREGISTRY_H
@@ -1,5 +1,7 @@
 #include "distance-table.h"
 #include "ns3/simulator.h"
+#include "ns3/assert.h"
+#include "stats-writer.h"
 #include <algorithm>
 
 namespace ns3
@@ -9,16 +11,116 @@ namespace ns3
 
 
     DistanceTable::DistanceTable()
+      : m_registry (Create<BeaconRegistry> ()),
+        m_tracked (false),
+        m_capacity (0),
+        m_policy (EVICT_HIGHEST_HOPS)
     {
     }
 
+    void
+    DistanceTable::SetCapacity (uint32_t capacity, EvictionPolicy policy)
+    {
+      m_capacity = capacity;
+      m_policy = policy;
+    }
+
+    void
+    DistanceTable::SetProvenance (bool enabled)
+    {
+      m_tracked = enabled;
+      m_provenance.clear ();
+      if (enabled)
+        {
+          m_provenance.reserve (m_entries.size ());
+          for (std::vector<Entry>::const_iterator it = m_entries.begin (); it != m_entries.end (); ++it)
+            {
+              m_provenance.push_back (NewProvenance (it->hops, 0));
+            }
+        }
+      else
+        {
+          std::vector<Provenance> ().swap (m_provenance);
+        }
+    }
+
+    DistanceTable::Provenance
+    DistanceTable::NewProvenance (uint16_t hops, uint32_t provider)
+    {
+      Provenance state;
+      state.feasibleHops = hops;
+      state.provider = provider;
+      for (int k = 0; k < ALTERNATES; k++)
+        {
+          state.alternates[k].neighbor = 0;
+        }
+      return state;
+    }
+
+    void
+    DistanceTable::SetRegistry (Ptr<BeaconRegistry> registry)
+    {
+      NS_ASSERT (registry);
+      NS_ASSERT_MSG (m_entries.empty (), "The registry of a DistanceTable can only change while it is empty");
+      m_registry = registry;
+    }
+
+    std::vector<DistanceTable::Entry>::iterator
+    DistanceTable::LowerBound (Ipv4Address beacon)
+    {
+      uint32_t address = beacon.Get ();
+      std::vector<Entry>::iterator first = m_entries.begin ();
+      size_t count = m_entries.size ();
+      while (count > 0)
+        {
+          size_t half = count / 2;
+          if (m_registry->GetAddressValue ((first + half)->beacon) < address)
+            {
+              first += half + 1;
+              count -= half + 1;
+            }
+          else
+            {
+              count = half;
+            }
+        }
+      return first;
+    }
+
+    std::vector<DistanceTable::Entry>::iterator
+    DistanceTable::Find (Ipv4Address beacon)
+    {
+      std::vector<Entry>::iterator it = LowerBound (beacon);
+      if (it != m_entries.end () && m_registry->GetAddressValue (it->beacon) == beacon.Get ())
+        {
+          return it;
+        }
+      return m_entries.end ();
+    }
+
+    std::vector<DistanceTable::Entry>::const_iterator
+    DistanceTable::Find (Ipv4Address beacon) const
+    {
+      return const_cast<DistanceTable *> (this)->Find (beacon);
+    }
+
+    BeaconInfo
+    DistanceTable::ToBeaconInfo (const Entry &entry) const
+    {
+      BeaconInfo info;
+      info.SetHops (entry.hops);
+      info.SetPosition (m_registry->GetPosition (entry.beacon));
+      info.SetTime (MilliSeconds (entry.updatedMs));
+      return info;
+    }
+
     uint16_t
     DistanceTable::GetHopsTo (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      std::vector<Entry>::const_iterator it = Find (beacon);
+      if( it != m_entries.end ())
         {
-          return ((BeaconInfo)it->second).GetHops ();
+          return it->hops;
         }
 
       else return 0;
@@ -27,78 +129,371 @@ namespace ns3
     Position
     DistanceTable::GetBeaconPosition (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      std::vector<Entry>::const_iterator it = Find (beacon);
+      if( it != m_entries.end ())
         {
-          return ((BeaconInfo)it->second).GetPosition ();
+          return m_registry->GetPosition (it->beacon);
         }
 
       else return std::make_pair<double,double>(-1.0,-1.0);
     }
 
 
-    void
-    DistanceTable::AddBeacon (Ipv4Address beacon, uint16_t hops, double xPos, double yPos)
+    bool
+    DistanceTable::AddBeacon (Ipv4Address beacon, uint16_t hops, double xPos, double yPos, Ipv4Address *evicted,
+                              Ipv4Address provider)
     {
-      std::map<Ipv4Address, BeaconInfo>::iterator it = m_table.find (beacon);
-      BeaconInfo info;
-      if( it != m_table.end ())
+      std::vector<Entry>::iterator it = LowerBound (beacon);
+      if( it != m_entries.end () && m_registry->GetAddressValue (it->beacon) == beacon.Get ())
         {
-          info.SetPosition (it->second.GetPosition ());
-          info.SetHops (hops);
-          info.SetTime (Simulator::Now ());
-          it->second = info;
+          // Known beacon, its position stays the one first registered
+          it->hops = hops;
+          it->updatedMs = Simulator::Now ().GetMilliSeconds ();
+          if (m_tracked)
+            {
+              Provenance &state = m_provenance[it - m_entries.begin ()];
+              state.feasibleHops = std::min (state.feasibleHops, hops);
+              state.provider = provider.Get ();
+              for (int k = 0; k < ALTERNATES; k++)
+                {
+                  // The new provider, and alternates no longer nearer than the entry ever was
+                  if (state.alternates[k].neighbor == state.provider || state.alternates[k].hops > state.feasibleHops)
+                    {
+                      state.alternates[k].neighbor = 0;
+                    }
+                }
+            }
+          return true;
         }
-      else
+
+      if (m_capacity > 0 && m_entries.size () >= m_capacity)
+        {
+          std::vector<Entry>::iterator victim = SelectVictim (hops, Position (xPos, yPos));
+          if (victim == m_entries.end ())
+            {
+              return false;
+            }
+          if (evicted)
+            {
+              *evicted = m_registry->GetAddress (victim->beacon);
+            }
+          size_t insertAt = it - m_entries.begin ();
+          if (victim < it)
+            {
+              insertAt--;
+            }
+          Release (*victim);
+          if (m_tracked)
+            {
+              m_provenance.erase (m_provenance.begin () + (victim - m_entries.begin ()));
+            }
+          m_entries.erase (victim);
+          it = m_entries.begin () + insertAt;
+        }
+
+      Entry entry;
+      entry.beacon = m_registry->Intern (beacon, std::pair<double,double>(xPos, yPos));
+      entry.hops = hops;
+      entry.updatedMs = Simulator::Now ().GetMilliSeconds ();
+      if (m_tracked)
+        {
+          m_provenance.insert (m_provenance.begin () + (it - m_entries.begin ()), NewProvenance (hops, provider.Get ()));
+        }
+      m_entries.insert (it, entry);
+      return true;
+    }
+
+    std::vector<DistanceTable::Entry>::iterator
+    DistanceTable::SelectVictim (uint16_t hops, Position pos)
+    {
+      std::vector<Entry>::iterator victim = m_entries.begin ();
+      switch (m_policy)
+        {
+        case EVICT_HIGHEST_HOPS:
+          {
+            // Among equally far beacons the least recently refreshed goes first
+            for (std::vector<Entry>::iterator j = m_entries.begin (); j != m_entries.end (); ++j)
+              {
+                if (j->hops > victim->hops || (j->hops == victim->hops && j->updatedMs < victim->updatedMs))
+                  {
+                    victim = j;
+                  }
+              }
+            // Ties keep the beacon already in the table
+            return hops < victim->hops ? victim : m_entries.end ();
+          }
+        case EVICT_OLDEST:
+          {
+            for (std::vector<Entry>::iterator j = m_entries.begin (); j != m_entries.end (); ++j)
+              {
+                if (j->updatedMs < victim->updatedMs)
+                  {
+                    victim = j;
+                  }
+              }
+            return victim;
+          }
+        case EVICT_GEOMETRIC:
+          {
+            // Closest pair among the entries and the new beacon, index m_entries.size () standing for the latter
+            size_t count = m_entries.size ();
+            std::vector<Position> points;
+            points.reserve (count + 1);
+            for (std::vector<Entry>::const_iterator j = m_entries.begin (); j != m_entries.end (); ++j)
+              {
+                points.push_back (m_registry->GetPosition (j->beacon));
+              }
+            points.push_back (pos);
+
+            size_t a = 0, b = count;
+            double best = -1;
+            for (size_t i = 0; i < points.size (); i++)
+              {
+                for (size_t k = i + 1; k < points.size (); k++)
+                  {
+                    double dx = points[i].first - points[k].first;
+                    double dy = points[i].second - points[k].second;
+                    double d = dx * dx + dy * dy;
+                    if (best < 0 || d < best)
+                      {
+                        best = d;
+                        a = i;
+                        b = k;
+                      }
+                  }
+              }
+
+            // Of the two, drop the farther in hops, the new beacon or else the older one on ties
+            if (b == count)
+              {
+                return hops >= m_entries[a].hops ? m_entries.end () : m_entries.begin () + a;
+              }
+            const Entry &ea = m_entries[a];
+            const Entry &eb = m_entries[b];
+            if (ea.hops != eb.hops)
+              {
+                return m_entries.begin () + (ea.hops > eb.hops ? a : b);
+              }
+            return m_entries.begin () + (ea.updatedMs <= eb.updatedMs ? a : b);
+          }
+        }
+      return victim;
+    }
+
+    void
+    DistanceTable::Release (const Entry &entry)
+    {
+      // Nothing but this table refers to a private registry, which can then stay as small as the table
+      if (m_registry->GetReferenceCount () == 1)
         {
-          info.SetHops (hops);
-          info.SetPosition (std::pair<double,double>(xPos, yPos));
-          info.SetTime (Simulator::Now ());
-          m_table.insert (std::pair<Ipv4Address, BeaconInfo>(beacon, info));
+          m_registry->Forget (entry.beacon);
         }
     }
 
 
+    void
+    DistanceTable::UpdatePosition (Ipv4Address beacon, Position pos)
+    {
+      std::vector<Entry>::iterator it = Find (beacon);
+      if (it != m_entries.end ())
+        {
+          m_registry->SetPosition (it->beacon, pos);
+        }
+    }
+
     Time
     DistanceTable::LastUpdatedAt (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      std::vector<Entry>::const_iterator it = Find (beacon);
+      if( it != m_entries.end ())
         {
-          return ((BeaconInfo)it->second).GetTime ();
+          return MilliSeconds (it->updatedMs);
         }
 
       else return Time::Max ();
     }
 
-    void DistanceTable::TrimExpiredEntries() {
-      std::vector<Ipv4Address> expired_addrs;
-      expired_addrs.clear();
-      for(auto const& x : m_table) {
-        Time b_time = x.second.GetTime();
-        Time now = Simulator::Now();
-        if(now.GetMilliSeconds() > b_time.GetMilliSeconds() + 1000) {
-          expired_addrs.push_back(x.first);
+    uint32_t DistanceTable::TrimExpiredEntries(std::vector<Ipv4Address> *expired) {
+      int64_t now = Simulator::Now().GetMilliSeconds();
+      uint32_t removed = 0;
+      size_t kept = 0;
+      std::vector<Entry>::iterator out = m_entries.begin();
+      for(std::vector<Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if(now > (int64_t) it->updatedMs + EXPIRY_MS) {
+          StatsWriter::Get().WriteEvent(now, STATS_EVENT_EXPIRED_ENTRY);
+          if(expired) {
+            expired->push_back(m_registry->GetAddress(it->beacon));
+          }
+          Release(*it);
+          removed++;
+        } else {
+          if(m_tracked) {
+            m_provenance[kept] = m_provenance[it - m_entries.begin()];
+          }
+          kept++;
+          *out++ = *it;
         }
       }
-      for(uint i = 0; i < expired_addrs.size(); i++) {
-        std::cout << "@STATS@TIME@" << Simulator::Now().GetMilliSeconds();
-        std::cout << "@EVENT@EXPIRED_ENTRY@\n";
-        m_table.erase(expired_addrs.at(i));
+      m_entries.erase(out, m_entries.end());
+      if(m_tracked) {
+        m_provenance.resize(kept);
       }
+      return removed;
     }
 
     void DistanceTable::Touch(Ipv4Address beacon) {
-      m_table.at(beacon).SetTime(Simulator::Now());
+      std::vector<Entry>::iterator it = Find(beacon);
+      NS_ASSERT_MSG(it != m_entries.end(), "Touching a beacon missing from the table");
+      it->updatedMs = Simulator::Now().GetMilliSeconds();
+    }
+
+    bool
+    DistanceTable::Refresh (Ipv4Address beacon, uint16_t hops, Ipv4Address neighbor)
+    {
+      NS_ASSERT_MSG (m_tracked, "Refreshing an entry of a table without provenance");
+      std::vector<Entry>::iterator it = Find (beacon);
+      NS_ASSERT_MSG (it != m_entries.end (), "Refreshing a beacon missing from the table");
+      Provenance &state = m_provenance[it - m_entries.begin ()];
+      uint32_t now = Simulator::Now ().GetMilliSeconds ();
+      uint32_t address = neighbor.Get ();
+      if (state.provider == 0 && hops == it->hops)
+        {
+          state.provider = address;
+        }
+      if (address != state.provider)
+        {
+          OfferAlternate (state, address, hops, now);
+          return false;
+        }
+      if (hops > it->hops)
+        {
+          // The provider's path grew. Only a path heard twice refreshes the entry, so entries
+          // bouncing between nodes that lost the beacon grow until they expire
+          it->hops = hops;
+          return true;
+        }
+      it->updatedMs = now;
+      return false;
+    }
+
+    void
+    DistanceTable::OfferAlternate (Provenance &state, uint32_t neighbor, uint16_t hops, uint32_t nowMs)
+    {
+      int slot = -1;
+      for (int k = 0; k < ALTERNATES; k++)
+        {
+          if (state.alternates[k].neighbor == neighbor)
+            {
+              slot = k;
+            }
+        }
+      if (hops > state.feasibleHops)
+        {
+          if (slot >= 0)
+            {
+              state.alternates[slot].neighbor = 0;
+            }
+          return;
+        }
+      if (slot < 0)
+        {
+          // A free or expired slot, else the farthest alternate if the neighbor is nearer
+          int worst = 0;
+          for (int k = 0; k < ALTERNATES && slot < 0; k++)
+            {
+              const Provider &alternate = state.alternates[k];
+              if (alternate.neighbor == 0 || nowMs > alternate.heardMs + EXPIRY_MS)
+                {
+                  slot = k;
+                }
+              else if (alternate.hops > state.alternates[worst].hops)
+                {
+                  worst = k;
+                }
+            }
+          if (slot < 0)
+            {
+              if (hops >= state.alternates[worst].hops)
+                {
+                  return;
+                }
+              slot = worst;
+            }
+        }
+      state.alternates[slot].neighbor = neighbor;
+      state.alternates[slot].heardMs = nowMs;
+      state.alternates[slot].hops = hops;
+    }
+
+    uint32_t
+    DistanceTable::SwitchSilentProviders (Time timeout, std::vector<Ipv4Address> *switched)
+    {
+      if (!m_tracked)
+        {
+          return 0;
+        }
+      int64_t now = Simulator::Now ().GetMilliSeconds ();
+      int64_t limit = timeout.GetMilliSeconds ();
+      uint32_t count = 0;
+      for (std::vector<Entry>::iterator it = m_entries.begin (); it != m_entries.end (); ++it)
+        {
+          if (now <= (int64_t) it->updatedMs + limit)
+            {
+              continue;
+            }
+          Provenance &state = m_provenance[it - m_entries.begin ()];
+          int best = -1;
+          for (int k = 0; k < ALTERNATES; k++)
+            {
+              const Provider &alternate = state.alternates[k];
+              if (alternate.neighbor == 0 || now > (int64_t) alternate.heardMs + limit
+                  || alternate.hops > state.feasibleHops)
+                {
+                  continue;
+                }
+              if (best < 0 || alternate.hops < state.alternates[best].hops
+                  || (alternate.hops == state.alternates[best].hops && alternate.heardMs > state.alternates[best].heardMs))
+                {
+                  best = k;
+                }
+            }
+          if (best < 0)
+            {
+              continue;
+            }
+          Provider &alternate = state.alternates[best];
+          state.provider = alternate.neighbor;
+          it->hops = alternate.hops;
+          it->updatedMs = alternate.heardMs;
+          alternate.neighbor = 0;
+          if (switched)
+            {
+              switched->push_back (m_registry->GetAddress (it->beacon));
+            }
+          count++;
+        }
+      return count;
+    }
+
+    Ipv4Address
+    DistanceTable::GetProvider (Ipv4Address beacon) const
+    {
+      std::vector<Entry>::const_iterator it = Find (beacon);
+      if (!m_tracked || it == m_entries.end ())
+        {
+          return Ipv4Address::GetAny ();
+        }
+      return Ipv4Address (m_provenance[it - m_entries.begin ()].provider);
     }
 
     std::vector<Ipv4Address>
     DistanceTable::GetKnownBeacons() const
     {
       std::vector<Ipv4Address> theBeacons;
-      for(std::map<Ipv4Address, BeaconInfo>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+      theBeacons.reserve (m_entries.size ());
+      for(std::vector<Entry>::const_iterator j = m_entries.begin (); j != m_entries.end (); ++j)
         {
-          theBeacons.push_back (j->first);
+          theBeacons.push_back (m_registry->GetAddress (j->beacon));
         }
       return theBeacons;
     }
@@ -106,11 +501,11 @@ namespace ns3
     void
     DistanceTable::Print (Ptr<OutputStreamWrapper> os) const
     {
-      *os->GetStream () << m_table.size () << " entries\n";
-      for(std::map<Ipv4Address,BeaconInfo>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+      *os->GetStream () << m_entries.size () << " entries\n";
+      for(std::vector<Entry>::const_iterator j = m_entries.begin (); j != m_entries.end (); ++j)
         {
-          //                    BeaconAddr           BeaconInfo
-          *os->GetStream () <<  j->first << "\t" << j->second;
+          //                    BeaconAddr                                  BeaconInfo
+          *os->GetStream () <<  m_registry->GetAddress (j->beacon) << "\t" << ToBeaconInfo (*j);
         }
     }
 
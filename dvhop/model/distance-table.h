@@ -6,12 +6,12 @@
 #include "ns3/ipv4.h"
 #include "ns3/nstime.h"
 #include "ns3/output-stream-wrapper.h"
+#include "beacon-registry.h"
 
 namespace ns3
 {
   namespace dvhop
   {
-    typedef std::pair<double, double> Position;
 
     class BeaconInfo
     {
@@ -32,20 +32,58 @@ namespace ns3
 
     std::ostream & operator<< (std::ostream & os, BeaconInfo const &);
 
+    /// Which beacon a full DistanceTable drops to make room, the newcomer included
+    enum EvictionPolicy
+    {
+      EVICT_HIGHEST_HOPS,   //!< The farthest beacon, so the table keeps the nearest ones
+      EVICT_OLDEST,         //!< The beacon refreshed longest ago
+      EVICT_GEOMETRIC       //!< One of the two closest beacons, so the kept ones stay spread out
+    };
+
     /**
      * @brief The DistanceTable class stores local
      *information about the beacons known to the node.
+     *
+     * Beacon addresses and positions live in a BeaconRegistry, the table itself
+     * only keeps a compact entry per beacon, ordered by beacon address.
      */
     class DistanceTable
     {
     public:
       DistanceTable();
 
+      /**
+       * @brief SetRegistry Stores beacon addresses and positions in the given registry,
+       * e.g. BeaconRegistry::GetShared (). Only allowed while the table is empty
+       * @param registry The registry
+       */
+      void SetRegistry(Ptr<BeaconRegistry> registry);
+
+      /**
+       * @brief SetCapacity Bounds the number of entries. Only affects later insertions
+       * @param capacity Maximum number of beacons, 0 for no limit
+       * @param policy Which beacon to drop when a new one arrives at a full table
+       */
+      void SetCapacity(uint32_t capacity, EvictionPolicy policy);
+
+      uint32_t        GetCapacity() const        { return m_capacity; }
+      EvictionPolicy  GetEvictionPolicy() const  { return m_policy; }
+
+      /**
+       * @brief SetProvenance Tracks which neighbor each entry came from, see Refresh.
+       * The state is only allocated while enabled; entries already in the table
+       * start with an unknown provider
+       * @param enabled Whether to track providers and alternates
+       */
+      void SetProvenance(bool enabled);
+
+      bool GetProvenance() const  { return m_tracked; }
+
       /**
        * @brief GetSize The number of entries stored in this table
        * @return The size
        */
-      size_t  GetSize() const  { return m_table.size (); }
+      size_t  GetSize() const  { return m_entries.size (); }
 
 
       /**
@@ -62,6 +100,13 @@ namespace ns3
        */
       Position    GetBeaconPosition(Ipv4Address beacon) const;
 
+      /**
+       * @brief UpdatePosition Replaces the position of a beacon in the table, e.g. after it moved
+       * @param beacon The beacon address
+       * @param pos The new position
+       */
+      void        UpdatePosition(Ipv4Address beacon, Position pos);
+
       /**
        * @brief LastUpdatedAt Gets the time in which the information for the beacon was updated for the last time
        * @param beacon The address of the beacon
@@ -71,14 +116,45 @@ namespace ns3
 
       /**
        * Removes expired paths from the distance table 
+       * @param expired If not null, receives the addresses of the removed beacons
+       * @return The number of entries removed
        */
-      void TrimExpiredEntries();
+      uint32_t TrimExpiredEntries(std::vector<Ipv4Address> *expired = 0);
 
       /**
        * Sets the last updated time of the given beacon to now
        */
       void Touch(Ipv4Address beacon);
 
+      /**
+       * @brief Refresh Records a neighbor's advertisement of a known beacon that is not shorter than its entry.
+       * Only valid with provenance enabled. The entry follows its provider, the neighbor it was learnt from, also on a longer path, and only the
+       * provider refreshes it; other neighbors strictly nearer to the beacon than the entry ever was are kept
+       * as alternates. Entries added without a provider adopt the first neighbor advertising the same hops
+       * @param beacon The beacon address, which must be in the table
+       * @param hops Hops to the beacon through the neighbor
+       * @param neighbor The advertising neighbor
+       * @return true if the hop count of the entry changed
+       */
+      bool Refresh(Ipv4Address beacon, uint16_t hops, Ipv4Address neighbor);
+
+      /**
+       * @brief SwitchSilentProviders Moves every entry whose provider was not heard for longer than timeout
+       * to its nearest alternate heard within timeout. Entries without one are left to expire.
+       * Does nothing without provenance
+       * @param timeout The silence after which a provider is given up
+       * @param switched If not null, receives the addresses of the switched beacons
+       * @return The number of entries switched
+       */
+      uint32_t SwitchSilentProviders(Time timeout, std::vector<Ipv4Address> *switched = 0);
+
+      /**
+       * @brief GetProvider Gets the neighbor the entry of a beacon follows
+       * @param beacon The beacon address
+       * @return The neighbor, or Ipv4Address::GetAny () if unknown
+       */
+      Ipv4Address GetProvider(Ipv4Address beacon) const;
+
       /**
        * @brief GetKnownBeacons
        * @return A vector containing the known beacons
@@ -97,10 +173,66 @@ namespace ns3
        * @param hops Hops to the beacon
        * @param xPos X coordinate
        * @param yPos Y coordinate
+       * @param evicted If not null, receives the beacon dropped to make room for this one
+       * @param provider The neighbor the hops were heard from, which the entry follows from now on (provenance only)
+       * @return false if the table is full and the eviction policy dropped the new beacon
        */
-      void AddBeacon(Ipv4Address beacon, uint16_t hops, double xPos, double yPos);
+      bool AddBeacon(Ipv4Address beacon, uint16_t hops, double xPos, double yPos, Ipv4Address *evicted = 0,
+                     Ipv4Address provider = Ipv4Address::GetAny ());
     private:
-      std::map<Ipv4Address, BeaconInfo>  m_table;
+      // Entries not refreshed for this long are removed by TrimExpiredEntries
+      static const uint32_t EXPIRY_MS = 1000;
+
+      // Next-best neighbors kept per entry
+      static const int ALTERNATES = 2;
+
+      // 12 bytes per known beacon
+      struct Entry
+      {
+        uint32_t beacon;     // Index in m_registry
+        uint32_t updatedMs;  // Milliseconds of simulation time, enough for 49 days. With provenance, last refresh by the provider
+        uint16_t hops;
+      };
+
+      // A neighbor advertising a beacon, 12 bytes
+      struct Provider
+      {
+        uint32_t neighbor;   // IPv4 address, 0 for a free slot
+        uint32_t heardMs;
+        uint16_t hops;       // Through this neighbor
+      };
+
+      // Where an entry came from, 32 bytes, kept apart so tables without provenance stay at 12 bytes per beacon
+      struct Provenance
+      {
+        uint16_t feasibleHops;  // Fewest hops the entry had, neighbors nearer than that cannot route through this node
+        uint32_t provider;      // IPv4 address of the neighbor the entry follows, 0 if unknown
+        Provider alternates[ALTERNATES];
+      };
+
+      // Provenance of a new entry, or of an entry whose provider is unknown
+      static Provenance                   NewProvenance(uint16_t hops, uint32_t provider);
+
+      // Keeps a neighbor as an alternate if it is feasible and beats a kept one
+      static void                         OfferAlternate(Provenance &state, uint32_t neighbor, uint16_t hops, uint32_t nowMs);
+
+      std::vector<Entry>::iterator        Find(Ipv4Address beacon);
+      std::vector<Entry>::const_iterator  Find(Ipv4Address beacon) const;
+      std::vector<Entry>::iterator        LowerBound(Ipv4Address beacon);
+      BeaconInfo                          ToBeaconInfo(const Entry &entry) const;
+
+      // Entry the eviction policy drops for a new beacon, m_entries.end () for the new beacon itself
+      std::vector<Entry>::iterator        SelectVictim(uint16_t hops, Position pos);
+
+      // Called for every entry leaving the table
+      void                                Release(const Entry &entry);
+
+      Ptr<BeaconRegistry>      m_registry;
+      std::vector<Entry>       m_entries;
+      bool                     m_tracked;     // Whether m_provenance is kept
+      std::vector<Provenance>  m_provenance;  // Parallel to m_entries while tracked, empty otherwise
+      uint32_t                 m_capacity;
+      EvictionPolicy           m_policy;
     };
   }
 }
@@ -7,9 +7,105 @@ namespace ns3
   namespace dvhop
   {
 
+    NS_OBJECT_ENSURE_REGISTERED (TypeHeader);
+
+    TypeHeader::TypeHeader (MessageType t) :
+      m_type (t), m_valid (true)
+    {
+    }
+
+    TypeId
+    TypeHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::TypeHeader")
+          .SetParent<Header> ()
+          .AddConstructor<TypeHeader> ();
+      return tid;
+    }
+
+    TypeId
+    TypeHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    uint32_t
+    TypeHeader::GetSerializedSize () const
+    {
+      return 1;
+    }
+
+    void
+    TypeHeader::Serialize (Buffer::Iterator i) const
+    {
+      i.WriteU8 ((uint8_t) m_type);
+    }
+
+    uint32_t
+    TypeHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+      uint8_t type = i.ReadU8 ();
+      m_valid = true;
+      switch (type)
+        {
+        case DVHOP_HELLO:
+        case DVHOP_COMPACT_HELLO:
+        case DVHOP_POSITION_REQUEST:
+        case DVHOP_POSITION:
+          {
+            m_type = (MessageType) type;
+            break;
+          }
+        default:
+          m_valid = false;
+        }
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize ());
+      return dist;
+    }
+
+    void
+    TypeHeader::Print (std::ostream &os) const
+    {
+      switch (m_type)
+        {
+        case DVHOP_HELLO:
+          {
+            os << "HELLO";
+            break;
+          }
+        case DVHOP_COMPACT_HELLO:
+          {
+            os << "COMPACT_HELLO";
+            break;
+          }
+        case DVHOP_POSITION_REQUEST:
+          {
+            os << "POSITION_REQUEST";
+            break;
+          }
+        case DVHOP_POSITION:
+          {
+            os << "POSITION";
+            break;
+          }
+        default:
+          os << "UNKNOWN_TYPE";
+        }
+    }
+
+    std::ostream &
+    operator<< (std::ostream &os, TypeHeader const &h)
+    {
+      h.Print (os);
+      return os;
+    }
+
     NS_OBJECT_ENSURE_REGISTERED (FloodingHeader);
 
-    FloodingHeader::FloodingHeader()
+    FloodingHeader::FloodingHeader() :
+      m_hopSize (0)
     {
     }
 
@@ -20,6 +116,7 @@ namespace ns3
       m_seqNo    = seqNo;
       m_hopCount = hopCount;
       m_beaconId = beacon;
+      m_hopSize  = 0;
     }
 
     TypeId
@@ -40,7 +137,7 @@ namespace ns3
     uint32_t
     FloodingHeader::GetSerializedSize () const
     {
-      return 24; //Total number of bytes when serialized
+      return HasHopSize () ? 32 : 24; //Total number of bytes when serialized
     }
 
     void
@@ -60,8 +157,16 @@ namespace ns3
       start.WriteHtonU64 (dst);
 
       start.WriteU16 (m_seqNo);
-      start.WriteU16 (m_hopCount);
+      start.WriteU16 (HasHopSize () ? (m_hopCount | 0x8000) : m_hopCount);
       WriteTo(start, m_beaconId);
+
+      if (HasHopSize ())
+        {
+          double h = m_hopSize;
+          char* const p3 = reinterpret_cast<char*>(&h);
+          std::copy(p3, p3+sizeof(uint64_t), reinterpret_cast<char*>(&dst));
+          start.WriteHtonU64 (dst);
+        }
     }
 
     uint32_t
@@ -85,6 +190,15 @@ namespace ns3
       m_hopCount = i.ReadU16 ();
       ReadFrom (i, m_beaconId);
 
+      m_hopSize = 0;
+      if (m_hopCount & 0x8000)
+        {
+          m_hopCount &= 0x7fff;
+          uint64_t midH = i.ReadNtohU64 ();
+          char* const p3 = reinterpret_cast<char*>(&midH);
+          std::copy(p3, p3 + sizeof(double), reinterpret_cast<char*>(&m_hopSize));
+        }
+
       //Validate the readed bytes match the serialized size
       uint32_t dist = i.GetDistanceFrom (start);
       NS_ASSERT (dist == GetSerializedSize () );
@@ -94,7 +208,12 @@ namespace ns3
     void
     FloodingHeader::Print (std::ostream &os) const
     {
-      os << "Beacon: " << m_beaconId << " ,hopCount: " << m_hopCount << ", (" << m_xPos << ", "<< m_yPos<< ")\n";
+      os << "Beacon: " << m_beaconId << " ,hopCount: " << m_hopCount << ", (" << m_xPos << ", "<< m_yPos<< ")";
+      if (HasHopSize ())
+        {
+          os << ", hopSize: " << m_hopSize;
+        }
+      os << "\n";
 
     }
 
@@ -105,6 +224,201 @@ namespace ns3
       return os;
     }
 
+    // Doubles travel as their IEEE-754 bits in network order, like in FloodingHeader
+    static void
+    WriteDouble (Buffer::Iterator &i, double v)
+    {
+      uint64_t bits;
+      std::copy (reinterpret_cast<char*> (&v), reinterpret_cast<char*> (&v) + sizeof (uint64_t), reinterpret_cast<char*> (&bits));
+      i.WriteHtonU64 (bits);
+    }
+
+    static double
+    ReadDouble (Buffer::Iterator &i)
+    {
+      uint64_t bits = i.ReadNtohU64 ();
+      double v;
+      std::copy (reinterpret_cast<char*> (&bits), reinterpret_cast<char*> (&bits) + sizeof (double), reinterpret_cast<char*> (&v));
+      return v;
+    }
+
+    NS_OBJECT_ENSURE_REGISTERED (CompactHelloHeader);
+
+    CompactHelloHeader::CompactHelloHeader () :
+      m_seqNo (0), m_hopCount (0), m_version (0)
+    {
+    }
+
+    CompactHelloHeader::CompactHelloHeader (Ipv4Address beacon, uint16_t seqNo, uint16_t hopCount, uint16_t version) :
+      m_beaconId (beacon), m_seqNo (seqNo), m_hopCount (hopCount), m_version (version)
+    {
+    }
+
+    TypeId
+    CompactHelloHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::CompactHelloHeader")
+          .SetParent<Header> ()
+          .AddConstructor<CompactHelloHeader> ();
+      return tid;
+    }
+
+    TypeId
+    CompactHelloHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    uint32_t
+    CompactHelloHeader::GetSerializedSize () const
+    {
+      return 10;
+    }
+
+    void
+    CompactHelloHeader::Serialize (Buffer::Iterator start) const
+    {
+      WriteTo (start, m_beaconId);
+      start.WriteHtonU16 (m_seqNo);
+      start.WriteHtonU16 (m_hopCount);
+      start.WriteHtonU16 (m_version);
+    }
+
+    uint32_t
+    CompactHelloHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+      ReadFrom (i, m_beaconId);
+      m_seqNo = i.ReadNtohU16 ();
+      m_hopCount = i.ReadNtohU16 ();
+      m_version = i.ReadNtohU16 ();
+
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize ());
+      return dist;
+    }
+
+    void
+    CompactHelloHeader::Print (std::ostream &os) const
+    {
+      os << "Beacon: " << m_beaconId << " ,seqNo: " << m_seqNo << " ,hopCount: " << m_hopCount
+         << " ,version: " << m_version << "\n";
+    }
+
+    NS_OBJECT_ENSURE_REGISTERED (PositionRequestHeader);
+
+    PositionRequestHeader::PositionRequestHeader (Ipv4Address beacon) :
+      m_beaconId (beacon)
+    {
+    }
+
+    TypeId
+    PositionRequestHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::PositionRequestHeader")
+          .SetParent<Header> ()
+          .AddConstructor<PositionRequestHeader> ();
+      return tid;
+    }
+
+    TypeId
+    PositionRequestHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    uint32_t
+    PositionRequestHeader::GetSerializedSize () const
+    {
+      return 4;
+    }
+
+    void
+    PositionRequestHeader::Serialize (Buffer::Iterator start) const
+    {
+      WriteTo (start, m_beaconId);
+    }
+
+    uint32_t
+    PositionRequestHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+      ReadFrom (i, m_beaconId);
+
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize ());
+      return dist;
+    }
+
+    void
+    PositionRequestHeader::Print (std::ostream &os) const
+    {
+      os << "Beacon: " << m_beaconId << "\n";
+    }
+
+    NS_OBJECT_ENSURE_REGISTERED (PositionHeader);
+
+    PositionHeader::PositionHeader () :
+      m_version (0), m_xPos (0), m_yPos (0)
+    {
+    }
+
+    PositionHeader::PositionHeader (Ipv4Address beacon, uint16_t version, double xPos, double yPos) :
+      m_beaconId (beacon), m_version (version), m_xPos (xPos), m_yPos (yPos)
+    {
+    }
+
+    TypeId
+    PositionHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::PositionHeader")
+          .SetParent<Header> ()
+          .AddConstructor<PositionHeader> ();
+      return tid;
+    }
+
+    TypeId
+    PositionHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    uint32_t
+    PositionHeader::GetSerializedSize () const
+    {
+      return 22;
+    }
+
+    void
+    PositionHeader::Serialize (Buffer::Iterator start) const
+    {
+      WriteTo (start, m_beaconId);
+      start.WriteHtonU16 (m_version);
+      WriteDouble (start, m_xPos);
+      WriteDouble (start, m_yPos);
+    }
+
+    uint32_t
+    PositionHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+      ReadFrom (i, m_beaconId);
+      m_version = i.ReadNtohU16 ();
+      m_xPos = ReadDouble (i);
+      m_yPos = ReadDouble (i);
+
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize ());
+      return dist;
+    }
+
+    void
+    PositionHeader::Print (std::ostream &os) const
+    {
+      os << "Beacon: " << m_beaconId << " ,version: " << m_version
+         << " ,position: (" << m_xPos << "," << m_yPos << ")\n";
+    }
+
 
 
   }
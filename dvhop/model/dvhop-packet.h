@@ -11,6 +11,39 @@ namespace ns3
 {
   namespace dvhop
   {
+    enum MessageType
+    {
+      DVHOP_HELLO            = 1,   //!< FloodingHeader follows
+      DVHOP_COMPACT_HELLO    = 3,   //!< CompactHelloHeader follows
+      DVHOP_POSITION_REQUEST = 4,   //!< PositionRequestHeader follows
+      DVHOP_POSITION         = 5    //!< PositionHeader follows
+    };
+
+    /**
+     * @brief TypeHeader The first byte of every DV-Hop packet
+     */
+    class TypeHeader : public Header
+    {
+    public:
+      TypeHeader (MessageType t = DVHOP_HELLO);
+
+      static TypeId    GetTypeId ();
+      TypeId           GetInstanceTypeId () const;
+      uint32_t         GetSerializedSize () const;
+      void             Serialize (Buffer::Iterator start) const;
+      uint32_t         Deserialize (Buffer::Iterator start);
+      void             Print (std::ostream &os) const;
+
+      MessageType Get () const   { return m_type; }
+      bool        IsValid () const { return m_valid; }
+
+    private:
+      MessageType m_type;
+      bool        m_valid;
+    };
+
+    std::ostream & operator<< (std::ostream & os, TypeHeader const &);
+
     /*
     0                   1                   2                   3
     0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -23,11 +56,16 @@ namespace ns3
     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
     |                            Y Position (2)                     |
     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-    |           Hops                |       Sequence number         |
+    |       Sequence number         |C|         Hops                |
     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
     |                        Beacon IP address                      |
     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                 Hop size correction (1), if C                 |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                 Hop size correction (2), if C                 |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 
+    C: the beacon's hop size correction follows, HELLOs are 24 bytes without it
     */
     class FloodingHeader: public Header
     {
@@ -52,12 +90,16 @@ namespace ns3
       void SetYPosition(double pos)         { m_yPos = pos;   }
       void SetSequenceNumber(uint16_t sn)  { m_seqNo = sn;   }
       void SetBeaconAddress(Ipv4Address a) { m_beaconId = a; }
+      // Hop size computed by the beacon, 0 to leave it out
+      void SetHopSize(double hopSize)      { m_hopSize = hopSize; }
 
       double    GetXPosition()        {   return m_xPos;     }
       double    GetYPosition()        {   return m_yPos;     }
       uint16_t GetHopCount()         {   return m_hopCount; }
       uint16_t GetSequenceNumber()   {   return m_seqNo;    }
       Ipv4Address GetBeaconAddress() {   return m_beaconId; }
+      double   GetHopSize()          {   return m_hopSize;  }
+      bool     HasHopSize() const    {   return m_hopSize > 0; }
 
 
     private:
@@ -66,10 +108,101 @@ namespace ns3
       uint16_t     m_seqNo;
       uint16_t     m_hopCount;
       Ipv4Address  m_beaconId;
+      double       m_hopSize;
     };
 
     std::ostream & operator<< (std::ostream & os, FloodingHeader const &);
 
+    /*
+    0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                        Beacon IP address                      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |       Sequence number         |             Hops              |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |       Position version        |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    */
+    /**
+     * @brief CompactHelloHeader A HELLO without the beacon position, which receivers
+     * keep in a cache and ask for when they miss it or the version changed
+     */
+    class CompactHelloHeader : public Header
+    {
+    public:
+      CompactHelloHeader ();
+      CompactHelloHeader (Ipv4Address beacon, uint16_t seqNo, uint16_t hopCount, uint16_t version);
+
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual void     Serialize (Buffer::Iterator start) const;
+      virtual uint32_t Deserialize (Buffer::Iterator start);
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Print (std::ostream &os) const;
+
+      Ipv4Address GetBeaconAddress () const    { return m_beaconId; }
+      uint16_t    GetSequenceNumber () const   { return m_seqNo; }
+      uint16_t    GetHopCount () const         { return m_hopCount; }
+      uint16_t    GetVersion () const          { return m_version; }
+
+    private:
+      Ipv4Address m_beaconId;
+      uint16_t    m_seqNo;
+      uint16_t    m_hopCount;
+      uint16_t    m_version;
+    };
+
+    /**
+     * @brief PositionRequestHeader Asks the neighbors for the position of a beacon (4 bytes: its address)
+     */
+    class PositionRequestHeader : public Header
+    {
+    public:
+      PositionRequestHeader (Ipv4Address beacon = Ipv4Address ());
+
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual void     Serialize (Buffer::Iterator start) const;
+      virtual uint32_t Deserialize (Buffer::Iterator start);
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Print (std::ostream &os) const;
+
+      Ipv4Address GetBeaconAddress () const    { return m_beaconId; }
+
+    private:
+      Ipv4Address m_beaconId;
+    };
+
+    /**
+     * @brief PositionHeader The position of a beacon and its version
+     * (22 bytes: address, version, X, Y)
+     */
+    class PositionHeader : public Header
+    {
+    public:
+      PositionHeader ();
+      PositionHeader (Ipv4Address beacon, uint16_t version, double xPos, double yPos);
+
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual void     Serialize (Buffer::Iterator start) const;
+      virtual uint32_t Deserialize (Buffer::Iterator start);
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Print (std::ostream &os) const;
+
+      Ipv4Address GetBeaconAddress () const    { return m_beaconId; }
+      uint16_t    GetVersion () const          { return m_version; }
+      double      GetXPosition () const        { return m_xPos; }
+      double      GetYPosition () const        { return m_yPos; }
+
+    private:
+      Ipv4Address m_beaconId;
+      uint16_t    m_version;
+      double      m_xPos;
+      double      m_yPos;
+    };
+
 
   }
 }
@@ -2,6 +2,7 @@
 
 #include "dvhop.h"
 #include "dvhop-packet.h"
+#include "stats-writer.h"
 #include "ns3/log.h"
 #include "ns3/boolean.h"
 #include "ns3/random-variable-stream.h"
@@ -12,6 +13,10 @@
 #include "ns3/adhoc-wifi-mac.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/uinteger.h"
+#include "ns3/enum.h"
+#include "ns3/double.h"
+#include <cmath>
 
 
 
@@ -35,11 +40,110 @@ namespace ns3 {
                          TimeValue (MilliSeconds(500)),                        // default value
                          MakeTimeAccessor (&RoutingProtocol::HelloInterval),   // accessed through
                          MakeTimeChecker ())
+          .AddAttribute ("TriggeredUpdates",
+                         "Advertise new and shortened distance table entries at once instead of at the next HELLO.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_triggeredUpdates),
+                         MakeBooleanChecker ())
+          .AddAttribute ("TriggeredUpdateInterval",
+                         "Shortest time between two triggered updates of a node; changes in between wait and go together.",
+                         TimeValue (MilliSeconds (50)),
+                         MakeTimeAccessor (&RoutingProtocol::TriggeredUpdateInterval),
+                         MakeTimeChecker ())
+          .AddAttribute ("NeighborProvenance",
+                         "Remember which neighbor each distance table entry came from and its next-best alternatives: "
+                         "only that neighbor refreshes the entry, which moves to an alternate once it is silent for ProviderTimeout.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_provenance),
+                         MakeBooleanChecker ())
+          .AddAttribute ("ProviderTimeout",
+                         "Silence after which an entry gives up the neighbor it follows, in neighbor provenance mode.",
+                         TimeValue (MilliSeconds (600)),
+                         MakeTimeAccessor (&RoutingProtocol::m_providerTimeout),
+                         MakeTimeChecker ())
           .AddAttribute ("UniformRv",
                          "Access to the underlying UniformRandomVariable",
                          StringValue ("ns3::UniformRandomVariable"),
                          MakePointerAccessor (&RoutingProtocol::m_URandom),
-                         MakePointerChecker<UniformRandomVariable> ());                                  // the checker is used to set bounds in values
+                         MakePointerChecker<UniformRandomVariable> ())                                   // the checker is used to set bounds in values
+          .AddAttribute ("SharedBeaconRegistry",
+                         "Keep beacon addresses and positions once per simulation instead of once per node. "
+                         "Not with CompactHello, whose nodes learn positions at different times.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::SetSharedBeaconRegistry,
+                                              &RoutingProtocol::GetSharedBeaconRegistry),
+                         MakeBooleanChecker ())
+          .AddAttribute ("TableCapacity",
+                         "Maximum number of beacons in the distance table, and so advertised in HELLOs (0: no limit).",
+                         UintegerValue (0),
+                         MakeUintegerAccessor (&RoutingProtocol::m_tableCapacity),
+                         MakeUintegerChecker<uint32_t> ())
+          .AddAttribute ("EvictionPolicy",
+                         "Beacon dropped when a new one arrives at a full distance table.",
+                         EnumValue (EVICT_HIGHEST_HOPS),
+                         MakeEnumAccessor (&RoutingProtocol::m_evictionPolicy),
+                         MakeEnumChecker (EVICT_HIGHEST_HOPS, "HighestHops",
+                                          EVICT_OLDEST, "Oldest",
+                                          EVICT_GEOMETRIC, "Geometric"))
+          .AddAttribute ("CompactHello",
+                         "Send HELLOs without beacon positions, which receivers cache and request when missing.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_compactHello),
+                         MakeBooleanChecker ())
+          .AddAttribute ("Clustered",
+                         "Run hierarchical DV-Hop: beacons are cluster heads and beacon entries only travel ClusterHops hops.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_clustered),
+                         MakeBooleanChecker ())
+          .AddAttribute ("ClusterHops",
+                         "Hops a cluster head's HELLOs travel in clustered mode.",
+                         UintegerValue (4),
+                         MakeUintegerAccessor (&RoutingProtocol::m_clusterHops),
+                         MakeUintegerChecker<uint16_t> (1))
+          .AddAttribute ("NumericType",
+                         "Arithmetic of the hop size and trilateration: the double reference, or float and Q16.16 fixed point as on motes.",
+                         EnumValue (NUMERIC_DOUBLE),
+                         MakeEnumAccessor (&RoutingProtocol::m_numericType),
+                         MakeEnumChecker (NUMERIC_DOUBLE, "Double",
+                                          NUMERIC_FLOAT, "Float",
+                                          NUMERIC_Q16_16, "Q16.16"))
+          .AddAttribute ("HopSizeMode",
+                         "Hop size source: Local computes it per node from the 3 beacons used, Beacon floods each beacon's "
+                         "correction (distance over hops to the other beacons) and nodes use the nearest beacon's. "
+                         "Compact HELLOs carry no correction.",
+                         EnumValue (HOP_SIZE_LOCAL),
+                         MakeEnumAccessor (&RoutingProtocol::m_hopSizeMode),
+                         MakeEnumChecker (HOP_SIZE_LOCAL, "Local",
+                                          HOP_SIZE_BEACON, "Beacon"))
+          .AddAttribute ("DeltaReports",
+                         "Write a stats record only when the position estimate moved more than ReportEpsilon, "
+                         "the number of known beacons changed or ReportKeyframeInterval passed, instead of on every HELLO.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_deltaReports),
+                         MakeBooleanChecker ())
+          .AddAttribute ("ReportEpsilon",
+                         "Smallest move of the position estimate reported in delta reporting mode, m.",
+                         DoubleValue (0.01),
+                         MakeDoubleAccessor (&RoutingProtocol::m_reportEpsilon),
+                         MakeDoubleChecker<double> (0))
+          .AddAttribute ("ReportKeyframeInterval",
+                         "Longest time between two records of a node in delta reporting mode (0: only changes).",
+                         TimeValue (Seconds (1)),
+                         MakeTimeAccessor (&RoutingProtocol::m_reportKeyframe),
+                         MakeTimeChecker ())
+          .AddAttribute ("Profiling",
+                         "Record the wall-clock time spent in the protocol handlers.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_profiling),
+                         MakeBooleanChecker ())
+          .AddTraceSource ("PositionEstimate",
+                           "The trilaterated position estimate of this node changed.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_positionEstimateTrace),
+                           "ns3::dvhop::RoutingProtocol::PositionTracedCallback")
+          .AddTraceSource ("DistanceTableChange",
+                           "A distance table entry was added, got a shorter path, changed provider or expired.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_distanceTableTrace),
+                           "ns3::dvhop::RoutingProtocol::DistanceTableTracedCallback");
       return tid;
     }
 
@@ -51,10 +155,36 @@ namespace ns3 {
     RoutingProtocol::RoutingProtocol () :
       HelloInterval (MilliSeconds(500)),   // Send HELLO 2x each second
       m_htimer (Timer::CANCEL_ON_DESTROY), // Set timer for HELLO
+      m_triggeredUpdates (false),
+      TriggeredUpdateInterval (MilliSeconds (50)),
+      m_ttimer (Timer::CANCEL_ON_DESTROY),
+      m_lastTriggered (Time::Min ()),
+      m_clustered (false),
+      m_clusterHops (4),
+      m_tableCapacity (0),
+      m_evictionPolicy (EVICT_HIGHEST_HOPS),
+      m_sharedRegistry (false),
+      m_provenance (false),
+      m_providerTimeout (MilliSeconds (600)),
       m_isBeacon(false),
       m_xPosition(-1.0),
       m_yPosition(-1.0),
-      m_seqNo (0)
+      m_activeInterfaces (0),
+      m_compactHello (false),
+      m_positionVersion (0),
+      m_positionPushed (false),
+      m_seqNo (0),
+      m_numericType (NUMERIC_DOUBLE),
+      m_hopSizeMode (HOP_SIZE_LOCAL),
+      m_hopSize (0),
+      m_deltaReports (false),
+      m_reportEpsilon (0.01),
+      m_reportKeyframe (Seconds (1)),
+      m_reported (false),
+      m_reportedX (0),
+      m_reportedY (0),
+      m_reportedTableSize (0),
+      m_profiling (false)
     {
     }
 
@@ -69,12 +199,17 @@ namespace ns3 {
     {
       m_ipv4 = 0;
       //Close every raw socket in the node (one per interface)
-      for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::iterator iter =
-           m_socketAddresses.begin (); iter != m_socketAddresses.end (); iter++)
+      for (std::vector<InterfaceContext>::iterator iter = m_interfaces.begin ();
+           iter != m_interfaces.end (); iter++)
         {
-          iter->first->Close ();
+          if (iter->socket)
+            {
+              iter->socket->Close ();
+            }
         }
-      m_socketAddresses.clear ();
+      m_interfaces.clear ();
+      m_deviceInterfaces.clear ();
+      m_activeInterfaces = 0;
       Ipv4RoutingProtocol::DoDispose ();
     }
 
@@ -94,7 +229,7 @@ namespace ns3 {
           return route;
         }
 
-      if (m_socketAddresses.empty ())
+      if (m_activeInterfaces == 0)
         {
           sockerr = Socket::ERROR_NOROUTETOHOST;
           NS_LOG_LOGIC ("No DVHop interfaces");
@@ -103,7 +238,7 @@ namespace ns3 {
         }
 
 
-      int32_t ifIndex = m_ipv4->GetInterfaceForDevice(oif); //Get the interface for this device
+      int32_t ifIndex = GetInterfaceForDevice (oif); //Get the interface for this device
       if(ifIndex < 0 )
         {
           sockerr = Socket::ERROR_NOROUTETOHOST;
@@ -112,19 +247,29 @@ namespace ns3 {
           return route;
         }
 
-      Ipv4InterfaceAddress iface = m_ipv4->GetAddress(ifIndex, 0);
+      const InterfaceContext &context = m_interfaces[ifIndex];
       sockerr = Socket::ERROR_NOTERROR;
       Ipv4Address dst = header.GetDestination ();
 
-      NS_LOG_DEBUG("Sending packet to: " << dst<< ", From:"<< iface.GetLocal ());
+      NS_LOG_DEBUG("Sending packet to: " << dst<< ", From:"<< context.address.GetLocal ());
+
+      //HELLOs go to one of the broadcast addresses, whose routes are built with the interface context
+      if (dst == context.address.GetBroadcast ())
+        {
+          return context.subnetRoute;
+        }
+      if (dst.IsBroadcast ())
+        {
+          return context.allHostsRoute;
+        }
 
       //Construct a route object to return
       //TODO: Remove hardcoded routes
       Ptr<Ipv4Route> route = Create<Ipv4Route>();
 
       route->SetDestination (dst);
-      route->SetGateway (iface.GetBroadcast ());//nextHop
-      route->SetSource (iface.GetLocal ());
+      route->SetGateway (context.address.GetBroadcast ());//nextHop
+      route->SetSource (context.address.GetLocal ());
       route->SetOutputDevice (oif);
       return route;
 
@@ -139,7 +284,7 @@ namespace ns3 {
     {
       NS_LOG_FUNCTION ("Packet received: " << p->GetUid () << header.GetDestination () << idev->GetAddress ());
 
-      if(m_socketAddresses.empty ())
+      if(m_activeInterfaces == 0)
         {//No interface is listening
           NS_LOG_LOGIC ("No DVHop interfaces");
           return false;
@@ -147,8 +292,7 @@ namespace ns3 {
 
       NS_ASSERT (m_ipv4 != 0);                               //The IPv4 Stack is running in this node
       NS_ASSERT (p != 0);                                    //The packet is not null
-      int32_t iif = m_ipv4->GetInterfaceForDevice (idev);    //Get the interface index
-      NS_ASSERT (iif >= 0);                                  //The input device also supports IPv4
+      int32_t iif = GetInterfaceForDevice (idev);            //Get the interface index
 
 
       Ipv4Address dst = header.GetDestination ();
@@ -162,40 +306,42 @@ namespace ns3 {
         }
 
       //Broadcast local delivery or forwarding
-      for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
-        {
-          Ipv4InterfaceAddress iface = j->second;
-          if(m_ipv4->GetInterfaceForAddress (iface.GetLocal ()) == iif)
-            {//We got the interface that received the packet
-              if(dst == iface.GetBroadcast () || dst.IsBroadcast ())
-                {//...and it's a broadcasted packet
-                  Ptr<Packet> packet = p->Copy ();
-                  if(  ! ldcb.IsNull () )
-                    {//Forward the packet to further processing to the LocalDeliveryCallback defined
-                      // Reduce spammy log messages -J
-                      // NS_LOG_DEBUG("Forwarding packet to Local Delivery Callback");
-                      ldcb(packet,header,iif);
-                    }
-                  else
-                    {
-                      NS_LOG_ERROR("Unable to deliver packet: LocalDeliverCallback is null.");
-                      errcb(packet,header,Socket::ERROR_NOROUTETOHOST);
-                    }
-                  // TTL hardcoded to 1 at the moment - Only sync hop tables with neighbors
-                  if (header.GetTtl () > 1)
-                    {
-                      NS_LOG_LOGIC ("Forward broadcast...");
-                      //Get a route and call UnicastForwardCallback
-                    }
-                  else
-                    {
-                      // Reduce spammy log messages -J
-                      // NS_LOG_LOGIC ("TTL Exceeded, drop packet");
-                    }
-                  return true;
+      if(iif >= 0)
+        {//DV-Hop runs on the interface that received the packet
+          const InterfaceContext &context = m_interfaces[iif];
+          if(dst == context.address.GetBroadcast () || dst.IsBroadcast ())
+            {//...and it's a broadcasted packet
+              Ptr<Packet> packet = p->Copy ();
+              if(  ! ldcb.IsNull () )
+                {//Forward the packet to further processing to the LocalDeliveryCallback defined
+                  // Reduce spammy log messages -J
+                  // NS_LOG_DEBUG("Forwarding packet to Local Delivery Callback");
+                  ldcb(packet,header,iif);
+                }
+              else
+                {
+                  NS_LOG_ERROR("Unable to deliver packet: LocalDeliverCallback is null.");
+                  errcb(packet,header,Socket::ERROR_NOROUTETOHOST);
+                }
+              // TTL hardcoded to 1 at the moment - Only sync hop tables with neighbors
+              if (header.GetTtl () > 1)
+                {
+                  NS_LOG_LOGIC ("Forward broadcast...");
+                  //Get a route and call UnicastForwardCallback
+                }
+              else
+                {
+                  // Reduce spammy log messages -J
+                  // NS_LOG_LOGIC ("TTL Exceeded, drop packet");
                 }
+              return true;
             }
         }
+      else
+        {//Devices without a DV-Hop socket (e.g. loopback) only see unicast delivery
+          iif = m_ipv4->GetInterfaceForDevice (idev);
+        }
+      NS_ASSERT (iif >= 0);                                  //The input device also supports IPv4
 
 
       //Unicast local delivery
@@ -246,17 +392,7 @@ namespace ns3 {
       if (iface.GetLocal () == Ipv4Address ("127.0.0.1"))
         return;
 
-      // Create a socket to listen only on this interface
-      Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (),
-                                                 UdpSocketFactory::GetTypeId ());
-      NS_ASSERT (socket != 0);
-      socket->SetRecvCallback (MakeCallback (&RoutingProtocol::RecvDvhop, this));
-      socket->BindToNetDevice (l3->GetNetDevice (interface));
-      socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DVHOP_PORT));
-      socket->SetAllowBroadcast (true);
-      socket->SetAttribute ("IpTtl", UintegerValue (1));
-      m_socketAddresses.insert (std::make_pair (socket, iface));
-
+      OpenInterface (interface, iface);
     }
 
 
@@ -266,14 +402,13 @@ namespace ns3 {
       NS_LOG_FUNCTION (this << m_ipv4->GetAddress (interface, 0).GetLocal ());
 
       // Close socket
-      Ptr<Socket> socket = FindSocketWithInterfaceAddress (m_ipv4->GetAddress (interface, 0));
-      NS_ASSERT (socket);
-      socket->Close ();
-      m_socketAddresses.erase (socket);
-      if (m_socketAddresses.empty ())
+      NS_ASSERT (interface < m_interfaces.size () && m_interfaces[interface].socket);
+      CloseInterface (interface);
+      if (m_activeInterfaces == 0)
         {
           NS_LOG_LOGIC ("No DV-Hop interfaces");
           m_htimer.Cancel ();
+          m_stimer.Cancel ();
           return;
         }
     }
@@ -288,21 +423,11 @@ namespace ns3 {
       if (l3->GetNAddresses (interface) == 1)
         {
           Ipv4InterfaceAddress iface = l3->GetAddress (interface, 0);
-          Ptr<Socket> socket = FindSocketWithInterfaceAddress (iface);
-          if (!socket)
+          if (interface >= m_interfaces.size () || !m_interfaces[interface].socket)
             {
               if (iface.GetLocal () == Ipv4Address ("127.0.0.1"))
                 return;
-              // Create a socket to listen only on this interface
-              Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (),
-                                                         UdpSocketFactory::GetTypeId ());
-              NS_ASSERT (socket != 0);
-              socket->SetRecvCallback (MakeCallback (&RoutingProtocol::RecvDvhop,this));
-              socket->BindToNetDevice (l3->GetNetDevice (interface));
-              // Bind to any IP address so that broadcasts can be received
-              socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DVHOP_PORT));
-              socket->SetAllowBroadcast (true);
-              m_socketAddresses.insert (std::make_pair (socket, iface));
+              OpenInterface (interface, iface);
             }
         }
       else
@@ -316,35 +441,112 @@ namespace ns3 {
     RoutingProtocol::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
     {
       NS_LOG_FUNCTION (this);
-      Ptr<Socket> socket = FindSocketWithInterfaceAddress (address);
-      if (socket)
+      if (interface < m_interfaces.size () && m_interfaces[interface].socket
+          && m_interfaces[interface].address == address)
         {
-          m_socketAddresses.erase (socket);
+          CloseInterface (interface);
           Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
           if (l3->GetNAddresses (interface))
             {
-              Ipv4InterfaceAddress iface = l3->GetAddress (interface, 0);
-              // Create a socket to listen only on this interface
-              Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (),
-                                                         UdpSocketFactory::GetTypeId ());
-              NS_ASSERT (socket != 0);
-              socket->SetRecvCallback (MakeCallback (&RoutingProtocol::RecvDvhop, this));
-              // Bind to any IP address so that broadcasts can be received
-              socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DVHOP_PORT));
-              socket->SetAllowBroadcast (true);
-              m_socketAddresses.insert (std::make_pair (socket, iface));
+              OpenInterface (interface, l3->GetAddress (interface, 0));
             }
-          if (m_socketAddresses.empty ())
+          if (m_activeInterfaces == 0)
             {
-              NS_LOG_LOGIC ("No aodv interfaces");
+              NS_LOG_LOGIC ("No DV-Hop interfaces");
               m_htimer.Cancel ();
+              m_stimer.Cancel ();
               return;
             }
         }
       else
         {
-          NS_LOG_LOGIC ("Remove address not participating in AODV operation");
+          NS_LOG_LOGIC ("Remove address not participating in DV-Hop operation");
+        }
+    }
+
+    void
+    RoutingProtocol::OpenInterface (uint32_t interface, Ipv4InterfaceAddress iface)
+    {
+      NS_LOG_FUNCTION (this << interface << iface);
+      Ptr<NetDevice> device = m_ipv4->GetNetDevice (interface);
+
+      // Create a socket to listen only on this interface
+      Ptr<Socket> socket = Socket::CreateSocket (GetObject<Node> (),
+                                                 UdpSocketFactory::GetTypeId ());
+      NS_ASSERT (socket != 0);
+      socket->SetRecvCallback (MakeCallback (&RoutingProtocol::RecvDvhop, this));
+      socket->BindToNetDevice (device);
+      // Bind to any IP address so that broadcasts can be received
+      socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DVHOP_PORT));
+      socket->SetAllowBroadcast (true);
+      socket->SetAttribute ("IpTtl", UintegerValue (1));
+
+      if (interface >= m_interfaces.size ())
+        {
+          m_interfaces.resize (interface + 1);
+        }
+      InterfaceContext &context = m_interfaces[interface];
+      NS_ASSERT (!context.socket);
+      context.socket = socket;
+      context.address = iface;
+
+      // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
+      if (iface.GetMask () == Ipv4Mask::GetOnes ())
+        {
+          context.helloDestination = Ipv4Address::GetBroadcast ();
+        }
+      else
+        {
+          context.helloDestination = iface.GetBroadcast ();
+        }
+
+      context.subnetRoute = Create<Ipv4Route> ();
+      context.subnetRoute->SetDestination (iface.GetBroadcast ());
+      context.subnetRoute->SetGateway (iface.GetBroadcast ());
+      context.subnetRoute->SetSource (iface.GetLocal ());
+      context.subnetRoute->SetOutputDevice (device);
+
+      context.allHostsRoute = Create<Ipv4Route> ();
+      context.allHostsRoute->SetDestination (Ipv4Address::GetBroadcast ());
+      context.allHostsRoute->SetGateway (iface.GetBroadcast ());
+      context.allHostsRoute->SetSource (iface.GetLocal ());
+      context.allHostsRoute->SetOutputDevice (device);
+
+      if (device->GetIfIndex () >= m_deviceInterfaces.size ())
+        {
+          m_deviceInterfaces.resize (device->GetIfIndex () + 1, -1);
+        }
+      m_deviceInterfaces[device->GetIfIndex ()] = interface;
+      m_activeInterfaces++;
+    }
+
+    void
+    RoutingProtocol::CloseInterface (uint32_t interface)
+    {
+      NS_LOG_FUNCTION (this << interface);
+      if (interface >= m_interfaces.size () || !m_interfaces[interface].socket)
+        {
+          return;
+        }
+      m_interfaces[interface].socket->Close ();
+      m_interfaces[interface] = InterfaceContext ();
+
+      uint32_t deviceIndex = m_ipv4->GetNetDevice (interface)->GetIfIndex ();
+      if (deviceIndex < m_deviceInterfaces.size ())
+        {
+          m_deviceInterfaces[deviceIndex] = -1;
+        }
+      m_activeInterfaces--;
+    }
+
+    int32_t
+    RoutingProtocol::GetInterfaceForDevice (Ptr<const NetDevice> device) const
+    {
+      if (!device || device->GetIfIndex () >= m_deviceInterfaces.size ())
+        {
+          return -1;
         }
+      return m_deviceInterfaces[device->GetIfIndex ()];
     }
 
 
@@ -391,6 +593,15 @@ namespace ns3 {
     {
       NS_LOG_FUNCTION (this);
       //Initialize timers and extra behaviour not initialized in the constructor
+      if (m_compactHello && m_sharedRegistry)
+        {
+          // One node's new position would reach every table before the others hear of it
+          NS_LOG_WARN ("CompactHello keeps beacon positions per node, not sharing the beacon registry.");
+          SetSharedBeaconRegistry (false);
+        }
+      m_disTable.SetCapacity (m_tableCapacity, m_evictionPolicy);
+      m_disTable.SetProvenance (m_provenance);
+      m_ttimer.SetFunction (&RoutingProtocol::SendTriggeredUpdate, this);
     }
 
 
@@ -416,118 +627,212 @@ namespace ns3 {
     void
     RoutingProtocol::SendHello ()
     {
+      ScopedProfile profile (Profile (PROFILE_SEND_HELLO));
       //NS_LOG_FUNCTION (this);
       /* Broadcast a HELLO packet the message fields set as follows:
    *   Sequence Number    The node's latest sequence number.
    *   Hop Count                      0
    */
 
-      for(std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin(); j != m_socketAddresses.end (); ++j)
+      // Every entry goes out now, including the ones waiting for a triggered update
+      m_changedEntries.clear ();
+      m_ttimer.Cancel ();
+
+      // Once per HELLO interval, so the work is O(beacons^2) per interval network-wide
+      if (m_isBeacon && m_hopSizeMode == HOP_SIZE_BEACON)
         {
-          Ptr<Socket> socket = j->first;
-          Ipv4InterfaceAddress iface = j->second;
+          m_hopSize = ComputeHopSize ();
+        }
+
+      for(std::vector<InterfaceContext>::const_iterator j = m_interfaces.begin(); j != m_interfaces.end (); ++j)
+        {
+          if (!j->socket)
+            {
+              continue;
+            }
+          Ptr<Socket> socket = j->socket;
+          const Ipv4InterfaceAddress &iface = j->address;
           /*TODO: Remove the hardcoded position*/
 
           std::vector<Ipv4Address> knownBeacons = m_disTable.GetKnownBeacons ();
           std::vector<Ipv4Address>::const_iterator addr;
           for (addr = knownBeacons.begin (); addr != knownBeacons.end (); ++addr)
             {
-              //Create a HELLO Packet for each known Beacon to this node
-              Position beaconPos = m_disTable.GetBeaconPosition (*addr);
-              FloodingHeader helloHeader(beaconPos.first,              //X Position
-                                         beaconPos.second,             //Y Position
-                                         m_seqNo++,                    //Sequence Numbr
-                                         m_disTable.GetHopsTo (*addr), //Hop Count
-                                         *addr);                       //Beacon Address
-              NS_LOG_DEBUG (iface.GetLocal ()<< " Sending Hello...");
-              Ptr<Packet> packet = Create<Packet>();
-              packet->AddHeader (helloHeader);
-              // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
-              Ipv4Address destination;
-              if (iface.GetMask () == Ipv4Mask::GetOnes ())
-                {
-                  destination = Ipv4Address ("255.255.255.255");
-                }
-              else
-                {
-                  destination = iface.GetBroadcast ();
-                }
-              Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
-              Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
+              AdvertiseEntry (socket, j->helloDestination, *addr);
             }
 
           /*If this node is a beacon, it should broadcast its position always*/
           NS_LOG_DEBUG ("Node "<< iface.GetLocal () << " isBeacon? " << m_isBeacon);
-          if (m_isBeacon){
+          if (m_isBeacon && m_compactHello){
+              // Neighbors learn the position from the first broadcast after each change, or ask for it
+              if (!m_positionPushed)
+                {
+                  Ptr<Packet> position = Create<Packet> ();
+                  position->AddHeader (PositionHeader (iface.GetLocal (), m_positionVersion, m_xPosition, m_yPosition));
+                  position->AddHeader (TypeHeader (DVHOP_POSITION));
+                  Simulator::Schedule (Time (MilliSeconds (m_URandom->GetInteger (0, 10))),
+                                       &RoutingProtocol::SendTo, this, socket, position, j->helloDestination);
+                }
+              Ptr<Packet> packet = Create<Packet> ();
+              packet->AddHeader (CompactHelloHeader (iface.GetLocal (), m_seqNo++, 0, m_positionVersion));
+              packet->AddHeader (TypeHeader (DVHOP_COMPACT_HELLO));
+              Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
+              Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, j->helloDestination);
+            }
+          else if (m_isBeacon){
               //Create a HELLO Packet for each known Beacon to this node
               FloodingHeader helloHeader(m_xPosition,                 //X Position
                                          m_yPosition,                 //Y Position
                                          m_seqNo++,                   //Sequence Numbr
                                          0,                           //Hop Count
                                          iface.GetLocal ());          //Beacon Address
+              if (m_hopSizeMode == HOP_SIZE_BEACON)
+                {
+                  helloHeader.SetHopSize (m_hopSize);
+                }
               //std::cout <<__FILE__<< __LINE__ << helloHeader << std::endl;
               NS_LOG_DEBUG (__FILE__ << __LINE__ << helloHeader << std::endl);
               NS_LOG_DEBUG (iface.GetLocal ()<< " Sending Hello...");
               Ptr<Packet> packet = Create<Packet>();
               packet->AddHeader (helloHeader);
-              // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
-              Ipv4Address destination;
-              if (iface.GetMask () == Ipv4Mask::GetOnes ())
-                {
-                  destination = Ipv4Address ("255.255.255.255");
-                }
-              else
-                {
-                  destination = iface.GetBroadcast ();
-                }
+              packet->AddHeader (TypeHeader (DVHOP_HELLO));
               Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
-              Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
+              Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, j->helloDestination);
+
+
+            }
+        }
+      if (m_isBeacon)
+        {
+          m_positionPushed = true;
+        }
+    }
+
+    void
+    RoutingProtocol::AdvertiseEntry (Ptr<Socket> socket, Ipv4Address destination, Ipv4Address beacon)
+    {
+      uint16_t hops = m_disTable.GetHopsTo (beacon);
+      if (m_clustered && hops >= m_clusterHops)
+        {
+          // Neighbors would be past the cluster scope of this beacon
+          return;
+        }
+      if (m_compactHello)
+        {
+          std::map<Ipv4Address, CachedPosition>::const_iterator cached = m_positionCache.find (beacon);
+          uint16_t version = cached != m_positionCache.end () ? cached->second.version : 0;
+          Ptr<Packet> packet = Create<Packet> ();
+          packet->AddHeader (CompactHelloHeader (beacon, m_seqNo++, hops, version));
+          packet->AddHeader (TypeHeader (DVHOP_COMPACT_HELLO));
+          Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
+          Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
+          return;
+        }
+      //Create a HELLO Packet for a known Beacon to this node
+      Position beaconPos = m_disTable.GetBeaconPosition (beacon);
+      FloodingHeader helloHeader(beaconPos.first,              //X Position
+                                 beaconPos.second,             //Y Position
+                                 m_seqNo++,                    //Sequence Numbr
+                                 hops,                         //Hop Count
+                                 beacon);                      //Beacon Address
+      if (m_hopSizeMode == HOP_SIZE_BEACON)
+        {
+          std::map<Ipv4Address, double>::const_iterator hopSize = m_hopSizes.find (beacon);
+          if (hopSize != m_hopSizes.end ())
+            {
+              helloHeader.SetHopSize (hopSize->second);
+            }
+        }
+      Ptr<Packet> packet = Create<Packet>();
+      packet->AddHeader (helloHeader);
+      packet->AddHeader (TypeHeader (DVHOP_HELLO));
+      Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
+      Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
+    }
 
+    void
+    RoutingProtocol::ScheduleTriggeredUpdate ()
+    {
+      if (m_ttimer.IsRunning ())
+        {
+          // The pending update will carry this change too
+          return;
+        }
+      // The first change after a quiet period goes out at once, later ones wait for the interval
+      Time next = m_lastTriggered + TriggeredUpdateInterval;
+      m_ttimer.Schedule (next > Simulator::Now () ? next - Simulator::Now () : Seconds (0));
+    }
 
+    void
+    RoutingProtocol::SendTriggeredUpdate ()
+    {
+      m_lastTriggered = Simulator::Now ();
+      std::set<Ipv4Address> changed;
+      changed.swap (m_changedEntries);
+      for (std::vector<InterfaceContext>::const_iterator j = m_interfaces.begin (); j != m_interfaces.end (); ++j)
+        {
+          if (!j->socket)
+            {
+              continue;
+            }
+          for (std::set<Ipv4Address>::const_iterator beacon = changed.begin (); beacon != changed.end (); ++beacon)
+            {
+              // Skip entries that expired or were evicted while waiting
+              if (m_disTable.GetHopsTo (*beacon) != 0)
+                {
+                  AdvertiseEntry (j->socket, j->helloDestination, *beacon);
+                }
             }
         }
     }
 
+    void
+    RoutingProtocol::Broadcast (const Header &header, MessageType type)
+    {
+      for (std::vector<InterfaceContext>::const_iterator j = m_interfaces.begin (); j != m_interfaces.end (); ++j)
+        {
+          if (!j->socket)
+            {
+              continue;
+            }
+          Ptr<Packet> packet = Create<Packet> ();
+          packet->AddHeader (header);
+          packet->AddHeader (TypeHeader (type));
+          Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
+          Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this, j->socket, packet, j->helloDestination);
+        }
+    }
 
     void
     RoutingProtocol::SendTo (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination)
     {
-      socket->SendTo (packet, 0, InetSocketAddress (destination, DVHOP_PORT));
+      int sent = socket->SendTo (packet, 0, InetSocketAddress (destination, DVHOP_PORT));
+      if (sent >= 0)
+        {
+          TypeHeader tHeader;
+          packet->PeekHeader (tHeader);
+          switch (tHeader.Get ())
+            {
+            case DVHOP_POSITION_REQUEST:
+            case DVHOP_POSITION:
+              m_counters.positionsSent++;
+              break;
+            default:
+              m_counters.hellosSent++;
+            }
+          m_counters.bytesSent += sent;
+        }
     }
 
     double RoutingProtocol::V_Norm(double x, double y) {
-      return pow(pow(x, 2) + pow(y, 2), 0.5);
+      return VNorm<double>(x, y);
     }
 
     std::pair<double, double> RoutingProtocol::Trilaterate(double x_1, 
         double y_1, double hops_1, double x_2, double y_2, double hops_2,
         double x_3, double y_3, double hops_3)
     {
-      double p12_d = V_Norm(x_2 - x_1, y_2 - y_1);
-
-      double ex_x = (x_2 - x_1) / p12_d;
-      double ex_y = (y_2 - y_1) / p12_d;
-
-      double a_x = x_3 - x_1;
-      double a_y = y_3 - y_1;
-
-      double i = ex_x * a_x + ex_y * a_y;
-
-      double b_x = x_3 - x_1 - i * ex_x;
-      double b_y = y_3 - y_1 - i * ex_y;
-
-      double ey_x = b_x / V_Norm(b_x, b_y);
-      double ey_y = b_y / V_Norm(b_x, b_y);
-
-      double j = ey_x * a_x + ey_y * a_y;
-
-      double x = (pow(hops_1, 2.0) - pow(hops_2, 2.0) + pow(p12_d, 2.0)) / (p12_d * 2.0);
-      double y = (pow(hops_1, 2.0) - pow(hops_3, 2.0) + pow(i, 2.0) + pow(j, 2.0)) / (j * 2.0) - i * x / j;
-      
-      return std::pair<double, double>(
-        x_1 + x * ex_x + y * ey_x,
-        y_1 + x * ex_y + y * ey_y
-      );
+      return dvhop::Trilaterate<double>(x_1, y_1, hops_1, x_2, y_2, hops_2, x_3, y_3, hops_3);
     }
 
     bool RoutingProtocol::HasIndex(std::vector<uint>& indices, uint search_index) {
@@ -537,12 +842,13 @@ namespace ns3 {
       return false;
     }
 
+    bool RoutingProtocol::SameCoordinate(double a, double b) {
+      return a == b || (std::isnan (a) && std::isnan (b));
+    }
+
     double RoutingProtocol::AvgHopSize(double b1_x, double b1_y, double b2_x,
                       double b2_y, double b3_x, double b3_y, double avg_nhops) {
-      double d12 = pow(pow(b1_x - b2_x, 2.0) + pow(b1_y - b2_y, 2.0), 0.5);
-      double d23 = pow(pow(b2_x - b3_x, 2.0) + pow(b2_y - b3_y, 2.0), 0.5);
-      double d31 = pow(pow(b3_x - b1_x, 2.0) + pow(b3_y - b1_y, 2.0), 0.5);
-      return (d12 + d23 + d31) / (3.0 * avg_nhops);
+      return dvhop::AvgHopSize<double>(b1_x, b1_y, b2_x, b2_y, b3_x, b3_y, avg_nhops);
     }
 
     /**
@@ -551,24 +857,220 @@ namespace ns3 {
     void
     RoutingProtocol::RecvDvhop (Ptr<Socket> socket)
     {
+      ScopedProfile profile (Profile (PROFILE_RECV_DVHOP));
       Address sourceAddress;
       Ptr<Packet> packet = socket->RecvFrom (sourceAddress); //Read a single packet from 'socket' and retrieve the 'sourceAddress'
 
-      //InetSocketAddress inetSourceAddr = InetSocketAddress::ConvertFrom (sourceAddress);
-      //Ipv4Address sender = inetSourceAddr.GetIpv4 ();
-      Ipv4Address receiver = m_socketAddresses[socket].GetLocal ();
+      InetSocketAddress inetSourceAddr = InetSocketAddress::ConvertFrom (sourceAddress);
+      Ipv4Address sender = inetSourceAddr.GetIpv4 ();
+      // Every DV-Hop socket is bound to the device of its interface
+      int32_t interface = GetInterfaceForDevice (socket->GetBoundNetDevice ());
+      NS_ASSERT (interface >= 0 && m_interfaces[interface].socket == socket);
+      Ipv4Address receiver = m_interfaces[interface].address.GetLocal ();
 
       // Reduce spammy log messages -J
       // NS_LOG_DEBUG ("sender:           " << sender);
       // NS_LOG_DEBUG ("receiver:         " << receiver);
 
+      TypeHeader tHeader;
+      packet->RemoveHeader (tHeader);
+      if (!tHeader.IsValid ())
+        {
+          NS_LOG_DEBUG ("DV-Hop message " << packet->GetUid () << " with unknown type received. Drop");
+          return;
+        }
+      switch (tHeader.Get ())
+        {
+        case DVHOP_HELLO:
+          {
+            RecvHello (packet, receiver, sender);
+            break;
+          }
+        case DVHOP_COMPACT_HELLO:
+          {
+            RecvCompactHello (packet, receiver, sender);
+            break;
+          }
+        case DVHOP_POSITION_REQUEST:
+          {
+            RecvPositionRequest (packet);
+            break;
+          }
+        case DVHOP_POSITION:
+          {
+            RecvPosition (packet, receiver);
+            break;
+          }
+        }
+    }
 
+    void
+    RoutingProtocol::RecvHello (Ptr<Packet> packet, Ipv4Address receiver, Ipv4Address sender)
+    {
       FloodingHeader fHeader;
       packet->RemoveHeader (fHeader);
+      m_counters.hellosReceived++;
+      Ipv4Address beacon = fHeader.GetBeaconAddress ();
+      uint16_t hops = fHeader.GetHopCount () + 1;
+      if (m_hopSizeMode == HOP_SIZE_BEACON && fHeader.HasHopSize ())
+        {
+          // Copies from longer paths are older, keep the one the table follows
+          uint16_t known = m_disTable.GetHopsTo (beacon);
+          if (known == 0 || hops <= known)
+            {
+              m_hopSizes[beacon] = fHeader.GetHopSize ();
+            }
+        }
+      ProcessHello (beacon, hops, fHeader.GetXPosition (), fHeader.GetYPosition (), receiver, sender);
+    }
+
+    void
+    RoutingProtocol::RecvCompactHello (Ptr<Packet> packet, Ipv4Address receiver, Ipv4Address sender)
+    {
+      CompactHelloHeader cHeader;
+      packet->RemoveHeader (cHeader);
+      m_counters.hellosReceived++;
+
+      Ipv4Address beacon = cHeader.GetBeaconAddress ();
+      uint16_t hops = cHeader.GetHopCount () + 1;
+      if (m_ipv4->GetInterfaceForAddress (beacon) >= 0)
+        {
+          return;
+        }
+      std::map<Ipv4Address, CachedPosition>::const_iterator cached = m_positionCache.find (beacon);
+      if (cached == m_positionCache.end () || cached->second.version != cHeader.GetVersion ())
+        {
+          RequestPosition (beacon);
+        }
+      if (cached == m_positionCache.end ())
+        {
+          // Applied once the position arrives
+          std::map<Ipv4Address, uint16_t>::iterator pending = m_pendingHops.find (beacon);
+          if (pending == m_pendingHops.end () || pending->second > hops)
+            {
+              m_pendingHops[beacon] = hops;
+            }
+          return;
+        }
+      // A stale position is still the best guess until the new one arrives
+      ProcessHello (beacon, hops, cached->second.position.first, cached->second.position.second, receiver, sender);
+    }
+
+    void
+    RoutingProtocol::RequestPosition (Ipv4Address beacon)
+    {
+      std::map<Ipv4Address, Time>::iterator last = m_positionRequested.find (beacon);
+      if (last != m_positionRequested.end () && Simulator::Now () - last->second < HelloInterval)
+        {
+          return;
+        }
+      m_positionRequested[beacon] = Simulator::Now ();
+      Broadcast (PositionRequestHeader (beacon), DVHOP_POSITION_REQUEST);
+    }
+
+    void
+    RoutingProtocol::RecvPositionRequest (Ptr<Packet> packet)
+    {
+      PositionRequestHeader rHeader;
+      packet->RemoveHeader (rHeader);
+      Ipv4Address beacon = rHeader.GetBeaconAddress ();
+
+      // One answer per beacon and HELLO interval, counting the answers of the other neighbors
+      std::map<Ipv4Address, Time>::iterator last = m_positionSent.find (beacon);
+      if (last != m_positionSent.end () && Simulator::Now () - last->second < HelloInterval)
+        {
+          return;
+        }
+
+      if (m_isBeacon && m_ipv4->GetInterfaceForAddress (beacon) >= 0)
+        {
+          m_positionSent[beacon] = Simulator::Now ();
+          Broadcast (PositionHeader (beacon, m_positionVersion, m_xPosition, m_yPosition), DVHOP_POSITION);
+          return;
+        }
+      std::map<Ipv4Address, CachedPosition>::const_iterator cached = m_positionCache.find (beacon);
+      if (cached != m_positionCache.end ())
+        {
+          m_positionSent[beacon] = Simulator::Now ();
+          Broadcast (PositionHeader (beacon, cached->second.version, cached->second.position.first,
+                                     cached->second.position.second), DVHOP_POSITION);
+        }
+    }
+
+    void
+    RoutingProtocol::RecvPosition (Ptr<Packet> packet, Ipv4Address receiver)
+    {
+      PositionHeader pHeader;
+      packet->RemoveHeader (pHeader);
+      Ipv4Address beacon = pHeader.GetBeaconAddress ();
+      if (m_ipv4->GetInterfaceForAddress (beacon) >= 0)
+        {
+          return;
+        }
+      m_positionSent[beacon] = Simulator::Now ();
+
+      Position position (pHeader.GetXPosition (), pHeader.GetYPosition ());
+      std::map<Ipv4Address, CachedPosition>::iterator cached = m_positionCache.find (beacon);
+      if (cached == m_positionCache.end ())
+        {
+          CachedPosition entry = {position, pHeader.GetVersion ()};
+          m_positionCache.insert (std::make_pair (beacon, entry));
+        }
+      else if ((int16_t) (pHeader.GetVersion () - cached->second.version) > 0)
+        {
+          cached->second.position = position;
+          cached->second.version = pHeader.GetVersion ();
+          m_disTable.UpdatePosition (beacon, position);
+        }
+
+      std::map<Ipv4Address, uint16_t>::iterator pending = m_pendingHops.find (beacon);
+      if (pending != m_pendingHops.end ())
+        {
+          uint16_t hops = pending->second;
+          m_pendingHops.erase (pending);
+          // The entry adopts a provider with the next compact HELLO
+          ProcessHello (beacon, hops, position.first, position.second, receiver, Ipv4Address::GetAny ());
+        }
+    }
+
+    void
+    RoutingProtocol::ProcessHello (Ipv4Address beacon, uint16_t hops, double x, double y, Ipv4Address receiver, Ipv4Address neighbor)
+    {
       // Reduce spammy log messages -J
-      // NS_LOG_DEBUG ("Update the entry for: " << fHeader.GetBeaconAddress ());
-      UpdateHopsTo (fHeader.GetBeaconAddress (), fHeader.GetHopCount () + 1, fHeader.GetXPosition (), fHeader.GetYPosition ());
-      m_disTable.TrimExpiredEntries();
+      // NS_LOG_DEBUG ("Update the entry for: " << beacon);
+      UpdateHopsTo (beacon, hops, x, y, neighbor);
+      if (m_provenance)
+        {
+          // Entries whose neighbor went silent move to an alternate instead of waiting to expire
+          std::vector<Ipv4Address> switched;
+          m_counters.switches += m_disTable.SwitchSilentProviders (m_providerTimeout, &switched);
+          for (std::vector<Ipv4Address>::const_iterator it = switched.begin (); it != switched.end (); ++it)
+            {
+              m_distanceTableTrace (*it, m_disTable.GetHopsTo (*it));
+              if (m_triggeredUpdates)
+                {
+                  m_changedEntries.insert (*it);
+                }
+            }
+          if (m_triggeredUpdates && !switched.empty ())
+            {
+              ScheduleTriggeredUpdate ();
+            }
+        }
+      {
+        ScopedProfile trimProfile (Profile (PROFILE_TRIM_EXPIRED));
+        std::vector<Ipv4Address> expired;
+        m_counters.expirations += m_disTable.TrimExpiredEntries(&expired);
+        for (std::vector<Ipv4Address>::const_iterator it = expired.begin (); it != expired.end (); ++it)
+          {
+            m_distanceTableTrace (*it, 0);
+            m_hopSizes.erase (*it);
+          }
+      }
+      if (m_clustered)
+        {
+          UpdateClusterHead ();
+        }
 
       // Beacons need not trilaterate
       if(IsBeacon()) { return; }
@@ -583,17 +1085,8 @@ namespace ns3 {
       }
 
       if(b_hops.size() < 3) { 
-        uint64_t sim_time = Simulator::Now().GetMilliSeconds();
-        std::cout << "@STATS@TIME@" << sim_time << "@NODE@" << receiver;
-        std::cout << "@HOP_TABLE_SIZE@" << b_addrs.size();
-        // X position
-        std::cout << "@POSITION_X@" << m_xPosition;
-        // Y position
-        std::cout << "@POSITION_Y@" << m_yPosition;
-        // X error
-        std::cout << "@ERROR_X@" << 0;
-        // Y error
-        std::cout << "@ERROR_Y@" << 0 << "@\n";
+        m_counters.localizationsSkipped++;
+        ReportPosition(receiver, b_addrs.size(), 0, 0);
         return;
       }
 
@@ -645,67 +1138,158 @@ namespace ns3 {
       double b3_posY = m_disTable.GetBeaconPosition(b3_addr).second;
 
 
-      double avg_nhops = ((double) b1_hops + (double) b2_hops + (double) b3_hops) / 3.0;
-      double avg_hopsize = AvgHopSize(b1_posX, b1_posY, b2_posX, b2_posY, b3_posX, b3_posY, avg_nhops);
+      // The nearest beacon's correction when there is one, else computed from the 3 beacons
+      double correction = m_hopSizeMode == HOP_SIZE_BEACON ? NearestBeaconHopSize (b_addrs, b_hops) : 0;
+      double avg_hopsize = correction;
+      if (correction <= 0)
+        {
+          double avg_nhops = ((double) b1_hops + (double) b2_hops + (double) b3_hops) / 3.0;
+          avg_hopsize = AvgHopSize(b1_posX, b1_posY, b2_posX, b2_posY, b3_posX, b3_posY, avg_nhops);
+        }
 
-      std::cout << "Beacon 1 position: " << b1_posX << "," << b1_posY << "\n";
-      std::cout << "Beacon 1 hops: " << b1_hops << "\n";
-      std::cout << "Beacon 2 position: " << b2_posX << "," << b2_posY << "\n";
-      std::cout << "Beacon 2 hops: " << b2_hops << "\n";
-      std::cout << "Beacon 3 position: " << b3_posX << "," << b3_posY << "\n";
-      std::cout << "Beacon 3 hops: " << b3_hops << "\n";
-      std::cout << "Average hop size: " << avg_hopsize << "\n";
+      NS_LOG_DEBUG ("Beacon 1 position: " << b1_posX << "," << b1_posY);
+      NS_LOG_DEBUG ("Beacon 1 hops: " << b1_hops);
+      NS_LOG_DEBUG ("Beacon 2 position: " << b2_posX << "," << b2_posY);
+      NS_LOG_DEBUG ("Beacon 2 hops: " << b2_hops);
+      NS_LOG_DEBUG ("Beacon 3 position: " << b3_posX << "," << b3_posY);
+      NS_LOG_DEBUG ("Beacon 3 hops: " << b3_hops);
+      NS_LOG_DEBUG ("Average hop size: " << avg_hopsize);
       
       // Trilaterate between closest beacons
-      std::pair<double, double> new_pos = Trilaterate(
-          b1_posX, b1_posY, ((double) b1_hops) * avg_hopsize,
-          b2_posX, b2_posY, ((double) b2_hops) * avg_hopsize,
-          b3_posX, b3_posY, ((double) b3_hops) * avg_hopsize
-      );
+      std::pair<double, double> new_pos;
+      {
+        ScopedProfile trilaterateProfile (Profile (PROFILE_TRILATERATE));
+        if (m_numericType == NUMERIC_DOUBLE)
+          {
+            new_pos = Trilaterate(
+                b1_posX, b1_posY, ((double) b1_hops) * avg_hopsize,
+                b2_posX, b2_posY, ((double) b2_hops) * avg_hopsize,
+                b3_posX, b3_posY, ((double) b3_hops) * avg_hopsize
+            );
+          }
+        else
+          {
+            // The same hop size and trilateration, run in the mote's arithmetic
+            const double x[3] = { b1_posX, b2_posX, b3_posX };
+            const double y[3] = { b1_posY, b2_posY, b3_posY };
+            const double hops[3] = { (double) b1_hops, (double) b2_hops, (double) b3_hops };
+            new_pos = LocalizeAs (m_numericType, x, y, hops, correction);
+          }
+      }
+      m_counters.localizationsRun++;
 
+      bool moved = !SameCoordinate (m_xPosition, new_pos.first) || !SameCoordinate (m_yPosition, new_pos.second);
       m_xPosition = new_pos.first;
       m_yPosition = new_pos.second;
+      if (moved)
+        {
+          m_positionEstimateTrace (m_xPosition, m_yPosition);
+        }
 
       double x_error = fabs(m_xPosition - m_presetX);
       double y_error = fabs(m_yPosition - m_presetY);
 
-      std::cout << "Trilaterated X: " << new_pos.first << "\n";
-      std::cout << "Trilaterated Y: " << new_pos.second << "\n";
+      NS_LOG_DEBUG ("Trilaterated X: " << new_pos.first);
+      NS_LOG_DEBUG ("Trilaterated Y: " << new_pos.second);
 
       // Statistics
-      uint64_t sim_time = Simulator::Now().GetMilliSeconds();
+      ReportPosition(receiver, b_addrs.size(), x_error, y_error);
+    }
+
+    void
+    RoutingProtocol::ReportPosition (Ipv4Address receiver, uint32_t tableSize, double errorX, double errorY)
+    {
+      if (m_deltaReports && m_reported
+          && tableSize == m_reportedTableSize
+          && ((SameCoordinate (m_xPosition, m_reportedX) && SameCoordinate (m_yPosition, m_reportedY))
+              || V_Norm (m_xPosition - m_reportedX, m_yPosition - m_reportedY) <= m_reportEpsilon)
+          && (m_reportKeyframe.IsZero () || Simulator::Now () - m_reportedAt < m_reportKeyframe))
+        {
+          // Readers hold the last record until the next one
+          return;
+        }
+      m_reported = true;
+      m_reportedX = m_xPosition;
+      m_reportedY = m_yPosition;
+      m_reportedTableSize = tableSize;
+      m_reportedAt = Simulator::Now ();
+
+      // Hop table size, position and error, formatted by the writer thread
+      StatsWriter::Get().WriteNode(Simulator::Now().GetMilliSeconds(), receiver.Get(), tableSize,
+                                   m_xPosition, m_yPosition, errorX, errorY);
+    }
+
+    void
+    RoutingProtocol::UpdateClusterHead ()
+    {
+      if (m_isBeacon)
+        {
+          m_clusterHead = Ipv4Address ();
+          return;
+        }
+      // Nearest beacon, the lowest address wins ties as GetKnownBeacons is sorted
+      Ipv4Address head;
+      uint16_t headHops = 0;
+      std::vector<Ipv4Address> knownBeacons = m_disTable.GetKnownBeacons ();
+      for (std::vector<Ipv4Address>::const_iterator addr = knownBeacons.begin (); addr != knownBeacons.end (); ++addr)
+        {
+          uint16_t hops = m_disTable.GetHopsTo (*addr);
+          if (headHops == 0 || hops < headHops)
+            {
+              head = *addr;
+              headHops = hops;
+            }
+        }
+      m_clusterHead = head;
+    }
 
-      // Hop table size
-      std::cout << "@STATS@TIME@" << sim_time << "@NODE@" << receiver;
-      std::cout << "@HOP_TABLE_SIZE@" << b_addrs.size();
-      // X position
-      std::cout << "@POSITION_X@" << m_xPosition;
-      // Y position
-      std::cout << "@POSITION_Y@" << m_yPosition;
-      // X error
-      std::cout << "@ERROR_X@" << x_error;
-      // Y error
-      std::cout << "@ERROR_Y@" << y_error << "@\n";
+    double
+    RoutingProtocol::ComputeHopSize () const
+    {
+      // Sum of the distances to the other beacons over the sum of the hops to them
+      double distance = 0;
+      uint32_t hops = 0;
+      std::vector<Ipv4Address> knownBeacons = m_disTable.GetKnownBeacons ();
+      for (std::vector<Ipv4Address>::const_iterator addr = knownBeacons.begin (); addr != knownBeacons.end (); ++addr)
+        {
+          Position position = m_disTable.GetBeaconPosition (*addr);
+          distance += V_Norm (position.first - m_xPosition, position.second - m_yPosition);
+          hops += m_disTable.GetHopsTo (*addr);
+        }
+      return hops > 0 ? distance / hops : 0;
     }
 
-    Ptr<Socket>
-    RoutingProtocol::FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr) const
+    double
+    RoutingProtocol::NearestBeaconHopSize (const std::vector<Ipv4Address>& beacons, const std::vector<uint>& hops) const
     {
-      NS_LOG_FUNCTION (this << addr);
-      for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
-           m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+      // Nearest beacon with a correction, the lowest address wins ties as beacons is sorted
+      double hopSize = 0;
+      uint nearest = 0;
+      for (size_t i = 0; i < beacons.size (); i++)
         {
-          Ptr<Socket> socket = j->first;
-          Ipv4InterfaceAddress iface = j->second;
-          if (iface == addr)
-            return socket;
+          if (nearest != 0 && hops[i] >= nearest)
+            {
+              continue;
+            }
+          std::map<Ipv4Address, double>::const_iterator correction = m_hopSizes.find (beacons[i]);
+          if (correction != m_hopSizes.end ())
+            {
+              hopSize = correction->second;
+              nearest = hops[i];
+            }
         }
-      Ptr<Socket> socket;
-      return socket;
+      return hopSize;
     }
 
     void
-    RoutingProtocol::UpdateHopsTo (Ipv4Address beacon, uint16_t newHops, double x, double y)
+    RoutingProtocol::SetSharedBeaconRegistry (bool shared)
+    {
+      m_sharedRegistry = shared;
+      m_disTable.SetRegistry (shared ? BeaconRegistry::GetShared () : Create<BeaconRegistry> ());
+    }
+
+    void
+    RoutingProtocol::UpdateHopsTo (Ipv4Address beacon, uint16_t newHops, double x, double y, Ipv4Address neighbor)
     {
       uint16_t oldHops = m_disTable.GetHopsTo (beacon);
       if (m_ipv4->GetInterfaceForAddress (beacon) >= 0){
@@ -713,11 +1297,47 @@ namespace ns3 {
           // NS_LOG_DEBUG ("Local Address, not updating in table");
           return;
         }
+      if (m_clustered && newHops > m_clusterHops)
+        {
+          // Outside the own and adjacent clusters
+          return;
+        }
 
       if( oldHops > newHops || oldHops == 0) { // Update only when a shortest path is found
-        m_disTable.AddBeacon (beacon, newHops, x, y);
+        Ipv4Address evicted = Ipv4Address::GetAny ();
+        if (!m_disTable.AddBeacon (beacon, newHops, x, y, &evicted, neighbor)) {
+          // The table is full of beacons the eviction policy prefers
+          m_counters.rejections++;
+          return;
+        }
+        if (oldHops == 0) {
+          m_counters.inserts++;
+        } else {
+          m_counters.improvements++;
+        }
+        if (evicted != Ipv4Address::GetAny ()) {
+          m_counters.evictions++;
+          m_distanceTableTrace (evicted, 0);
+        }
+        m_distanceTableTrace (beacon, newHops);
+        if (m_triggeredUpdates) {
+          m_changedEntries.insert (beacon);
+          ScheduleTriggeredUpdate ();
+        }
+      } else if (m_disTable.GetProvenance () && neighbor != Ipv4Address::GetAny ()) {
+        // Only the neighbor the entry follows keeps it current, also on a longer path
+        if (m_disTable.Refresh (beacon, newHops, neighbor)) {
+          m_distanceTableTrace (beacon, newHops);
+          if (m_triggeredUpdates) {
+            m_changedEntries.insert (beacon);
+            ScheduleTriggeredUpdate ();
+          }
+        } else {
+          m_counters.touches++;
+        }
       } else {
         // Keep unchanged entries current
+        m_counters.touches++;
         m_disTable.Touch(beacon);
       }
     }
@@ -12,15 +12,28 @@
 #include "ns3/timer.h"
 #include "ns3/packet.h"
 #include "ns3/ipv4-header.h"
+#include "ns3/traced-callback.h"
 
 #include "distance-table.h"
+#include "dvhop-packet.h"
+#include "protocol-counters.h"
+#include "localization-math.h"
 
 #include <map>
+#include <set>
+#include <vector>
 
 
 namespace ns3 {
   namespace dvhop{
 
+    /// Where a node's hop size, the distance it assumes per hop, comes from
+    enum HopSizeMode
+    {
+      HOP_SIZE_LOCAL,   //!< Each node computes it from the 3 beacons it localizes with
+      HOP_SIZE_BEACON   //!< Beacons compute it from the other beacons and flood it, nodes use the nearest beacon's
+    };
+
     class RoutingProtocol : public Ipv4RoutingProtocol{
     public:
       static const uint32_t DVHOP_PORT;
@@ -51,8 +64,8 @@ namespace ns3 {
       // Sets whether this node is a beacon
       void SetIsBeacon(bool isBeacon)    { m_isBeacon = isBeacon; }
 
-      // Sets this node's position
-      void SetPosition(double x, double y) { m_xPosition = x; m_yPosition = y; }
+      // Sets this node's position, a beacon advertises the change with a new position version
+      void SetPosition(double x, double y) { m_xPosition = x; m_yPosition = y; m_positionVersion++; m_positionPushed = false; }
 
       // Sets this node's preset position for error checking
       void SetPresetXY(double x, double y) { m_presetX = x; m_presetY = y; }
@@ -69,6 +82,47 @@ namespace ns3 {
       // Prints this node's distance table
       void  PrintDistances(Ptr<OutputStreamWrapper> stream, Ptr<Node> node) const;
 
+      // Gets this node's distance table
+      const DistanceTable& GetDistanceTable() const { return m_disTable; }
+
+      // Gets the cluster head of this node in clustered mode: the nearest known beacon, or
+      // Ipv4Address() for beacons and in flat mode
+      Ipv4Address GetClusterHead() const { return m_clusterHead; }
+
+      // Gets this node's activity counters
+      const ProtocolCounters& GetCounters() const { return m_counters; }
+
+      // Gets the time spent in a handler, only collected when the Profiling attribute is set
+      const HandlerProfile& GetProfile(ProfiledHandler handler) const { return m_profile[handler]; }
+
+      /**
+       * TracedCallback signature for position estimate changes
+       * \param [in] x The new estimated X coordinate
+       * \param [in] y The new estimated Y coordinate
+       */
+      typedef void (* PositionTracedCallback)(double x, double y);
+
+      /**
+       * TracedCallback signature for distance table changes
+       * \param [in] beacon The beacon whose entry changed
+       * \param [in] hops The new hop count, 0 when the entry expired
+       */
+      typedef void (* DistanceTableTracedCallback)(Ipv4Address beacon, uint16_t hops);
+
+      // Reference (double) versions of the templates in localization-math.h
+
+      // Vector norm for trilateration
+      static double V_Norm(double x, double y);
+
+      // Trilaterate a position from 3 beacons and the distances to them
+      static std::pair<double, double> Trilaterate(double x_1, double y_1,
+          double hops_1, double x_2, double y_2, double hops_2, double x_3,
+          double y_3, double hops_3);
+
+      // Gets the average hop size between 3 beacons
+      static double AvgHopSize(double b1_x, double b1_y, double b2_x,
+                      double b2_y, double b3_x, double b3_y, double avg_nhops);
+
     private:
       // Start protocol operation
       void        Start    ();
@@ -79,8 +133,29 @@ namespace ns3 {
       // Callback to process a received packet
       void        RecvDvhop(Ptr<Socket> socket);
 
-      // Finds the socket at the given address
-      Ptr<Socket> FindSocketWithInterfaceAddress (Ipv4InterfaceAddress iface) const;
+      // Processes a HELLO once RecvDvhop removed its TypeHeader
+      void        RecvHello(Ptr<Packet> packet, Ipv4Address receiver, Ipv4Address sender);
+
+      // Processes a compact HELLO, a position request or a position once RecvDvhop removed their TypeHeader
+      void        RecvCompactHello(Ptr<Packet> packet, Ipv4Address receiver, Ipv4Address sender);
+      void        RecvPositionRequest(Ptr<Packet> packet);
+      void        RecvPosition(Ptr<Packet> packet, Ipv4Address receiver);
+
+      // Updates the table with what a HELLO of either kind said, then localizes this node.
+      // The neighbor is the HELLO's sender, Ipv4Address::GetAny () if unknown
+      void        ProcessHello(Ipv4Address beacon, uint16_t hops, double x, double y, Ipv4Address receiver, Ipv4Address neighbor);
+
+      // Sends a message on every DV-Hop interface after a random jitter
+      void        Broadcast(const Header &header, MessageType type);
+
+      // Opens the DV-Hop socket of an interface and caches its context
+      void        OpenInterface  (uint32_t interface, Ipv4InterfaceAddress iface);
+
+      // Closes the DV-Hop socket of an interface and drops its context
+      void        CloseInterface (uint32_t interface);
+
+      // Gets the IPv4 interface of a device, -1 when DV-Hop does not run on it
+      int32_t     GetInterfaceForDevice (Ptr<const NetDevice> device) const;
 
       //In case there exists a route to the destination, the packet is forwarded
       bool        Forwarding(Ptr<const Packet> p, const Ipv4Header &header, UnicastForwardCallback ufcb, ErrorCallback errcb);
@@ -92,24 +167,51 @@ namespace ns3 {
       void   SendHello();
       void   HelloTimerExpire();
 
+      // Sends the HELLO of one distance table entry after a random jitter
+      void   AdvertiseEntry(Ptr<Socket> socket, Ipv4Address destination, Ipv4Address beacon);
+
+      // Triggered updates: entries added or shortened since the last HELLO are
+      // advertised at once, at most every TriggeredUpdateInterval, between the
+      // periodic full HELLOs
+      bool   m_triggeredUpdates;
+      Time   TriggeredUpdateInterval;
+      Timer  m_ttimer;
+      Time   m_lastTriggered;
+      std::set<Ipv4Address> m_changedEntries;
+      void   ScheduleTriggeredUpdate();
+      void   SendTriggeredUpdate();
+
+      // Clustered mode: beacons act as cluster heads and beacon entries only
+      // travel m_clusterHops hops, so members keep the beacons of their own
+      // and of the adjacent clusters
+      bool        m_clustered;
+      uint16_t    m_clusterHops;
+      Ipv4Address m_clusterHead;
+      void   UpdateClusterHead();
+
       //Table to store the hopCount to each beacon
       DistanceTable  m_disTable;
-      void UpdateHopsTo (Ipv4Address beacon, uint16_t hops, double x, double y);
 
-      // Vector norm for trilateration
-      double V_Norm(double x, double y);
+      // Bound of m_disTable and what it drops when full, applied when the protocol starts
+      uint32_t       m_tableCapacity;
+      EvictionPolicy m_evictionPolicy;
+
+      // Whether m_disTable keeps beacon positions in the simulation-wide BeaconRegistry
+      bool m_sharedRegistry;
+      void SetSharedBeaconRegistry (bool shared);
+      bool GetSharedBeaconRegistry () const { return m_sharedRegistry; }
+      void UpdateHopsTo (Ipv4Address beacon, uint16_t hops, double x, double y, Ipv4Address neighbor);
+
+      // Neighbor provenance: each entry is refreshed only by the neighbor it was learnt
+      // from and moves to its nearest alternate once that neighbor is silent for m_providerTimeout
+      bool m_provenance;
+      Time m_providerTimeout;
 
-      // Trilaterate this node's position from 3 beacons
-      std::pair<double, double> Trilaterate(double x_1, double y_1, 
-          double hops_1, double x_2, double y_2, double hops_2, double x_3, 
-          double y_3, double hops_3);
-      
       // Check if a vector contains an index
       bool HasIndex(std::vector<uint>& indices, uint search_index);
 
-      // Gets the average hop size between this node and 3 beacons
-      double AvgHopSize(double b1_x, double b1_y, double b2_x,
-                      double b2_y, double b3_x, double b3_y, double avg_nhops);
+      // Equal coordinates, where the NaN estimates of degenerate geometry equal each other
+      static bool SameCoordinate(double a, double b);
 
       // Boolean to identify if this node acts as a Beacon
       bool m_isBeacon;
@@ -125,14 +227,85 @@ namespace ns3 {
       //IPv4 Protocol
       Ptr<Ipv4>   m_ipv4;
 
-      // Raw socket per each IP interface, map socket -> iface address (IP + mask)
-      std::map< Ptr<Socket>, Ipv4InterfaceAddress > m_socketAddresses;
+      // Everything the packet path needs to know about one IP interface
+      struct InterfaceContext
+      {
+        Ptr<Socket>          socket;            // null when DV-Hop does not run on the interface
+        Ipv4InterfaceAddress address;           // IP + mask
+        Ipv4Address          helloDestination;  // all-hosts broadcast on /32 addresses, subnet-directed otherwise
+        Ptr<Ipv4Route>       subnetRoute;       // route to the subnet-directed broadcast
+        Ptr<Ipv4Route>       allHostsRoute;     // route to 255.255.255.255
+      };
+
+      // Context per IP interface, indexed by interface number
+      std::vector<InterfaceContext> m_interfaces;
+
+      // IP interface per device, indexed by NetDevice::GetIfIndex, -1 for devices DV-Hop does not use
+      std::vector<int32_t> m_deviceInterfaces;
+
+      // Number of interfaces with an open socket
+      uint32_t m_activeInterfaces;
+
+      // Compact HELLOs: beacon positions are cached by the receivers and only sent on request
+      // or when a beacon's position version changes
+      struct CachedPosition
+      {
+        Position position;
+        uint16_t version;
+      };
+      bool     m_compactHello;
+      uint16_t m_positionVersion;   // Version of this node's position, advertised by beacons
+      bool     m_positionPushed;    // Whether this beacon broadcast its current position version
+      std::map<Ipv4Address, CachedPosition> m_positionCache;
+      std::map<Ipv4Address, uint16_t>       m_pendingHops;        // Hops heard for beacons whose position is on its way
+      std::map<Ipv4Address, Time>           m_positionRequested;  // Last request sent per beacon
+      std::map<Ipv4Address, Time>           m_positionSent;       // Last position sent or overheard per beacon
+      void   RequestPosition(Ipv4Address beacon);
 
       // DV-hop sequence number
       uint32_t    m_seqNo;
 
+      // Arithmetic the localization runs in
+      NumericType m_numericType;
+
+      // Beacon hop size corrections: a beacon's own from its distance table, and
+      // the last one heard on the shortest path per beacon, flooded with the HELLOs
+      HopSizeMode m_hopSizeMode;
+      double      m_hopSize;
+      std::map<Ipv4Address, double> m_hopSizes;
+      double ComputeHopSize() const;
+      double NearestBeaconHopSize(const std::vector<Ipv4Address>& beacons, const std::vector<uint>& hops) const;
+
+      // Delta reporting: a stats record only when the estimate moved more than
+      // m_reportEpsilon, the beacon count changed or m_reportKeyframe passed
+      bool     m_deltaReports;
+      double   m_reportEpsilon;
+      Time     m_reportKeyframe;
+      bool     m_reported;
+      double   m_reportedX;
+      double   m_reportedY;
+      uint32_t m_reportedTableSize;
+      Time     m_reportedAt;
+      void   ReportPosition(Ipv4Address receiver, uint32_t tableSize, double errorX, double errorY);
+
       // Used to simulate jitter
       Ptr<UniformRandomVariable> m_URandom;
+
+      // Fired whenever trilateration moves this node's position estimate
+      TracedCallback<double, double> m_positionEstimateTrace;
+
+      // Fired whenever an entry of the distance table is added, shortened or expires
+      TracedCallback<Ipv4Address, uint16_t> m_distanceTableTrace;
+
+      // Activity counters
+      ProtocolCounters m_counters;
+
+      // Wall-clock time spent per handler
+      bool           m_profiling;
+      HandlerProfile m_profile[PROFILE_HANDLER_COUNT];
+
+      // Profile to charge a handler call to, null when profiling is off
+      HandlerProfile* Profile(ProfiledHandler handler) { return m_profiling ? &m_profile[handler] : 0; }
     };
   }
 
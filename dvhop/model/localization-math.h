@@ -0,0 +1,349 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef LOCALIZATION_MATH_H
+#define LOCALIZATION_MATH_H
+
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+    /// Scalar type the per-node localization runs in
+    enum NumericType
+    {
+      NUMERIC_DOUBLE,   //!< IEEE double, the reference
+      NUMERIC_FLOAT,    //!< IEEE single precision, as on motes with a single precision FPU
+      NUMERIC_Q16_16    //!< Signed 16.16 fixed point, integer operations only
+    };
+
+    /**
+     * @brief Signed 16.16 fixed point number for motes without an FPU.
+     *
+     * Products and quotients go through 64-bit integers; every result
+     * saturates at the range limits (about +-32768) instead of wrapping, and a
+     * division by zero saturates with the sign of the dividend.
+     */
+    class Q16_16
+    {
+    public:
+      static const int32_t ONE = 1 << 16;
+
+      Q16_16 () : m_raw (0) {}
+
+      static Q16_16 FromRaw (int32_t raw)   { Q16_16 q; q.m_raw = raw; return q; }
+      static Q16_16 FromDouble (double v)   { return FromRaw (Saturate ((int64_t) std::floor (v * ONE + 0.5))); }
+      static Q16_16 FromWide (int64_t raw)  { return FromRaw (Saturate (raw)); }
+      double        ToDouble () const       { return (double) m_raw / ONE; }
+      int32_t       GetRaw () const         { return m_raw; }
+
+      Q16_16 operator+ (Q16_16 o) const     { return FromRaw (Saturate ((int64_t) m_raw + o.m_raw)); }
+      Q16_16 operator- (Q16_16 o) const     { return FromRaw (Saturate ((int64_t) m_raw - o.m_raw)); }
+      Q16_16 operator- () const             { return FromRaw (Saturate (-(int64_t) m_raw)); }
+      Q16_16 operator* (Q16_16 o) const
+      {
+        // Round to nearest
+        return FromRaw (Saturate (((int64_t) m_raw * o.m_raw + (ONE >> 1)) >> 16));
+      }
+      Q16_16 operator/ (Q16_16 o) const
+      {
+        if (o.m_raw == 0)
+          {
+            return FromRaw (m_raw < 0 ? INT32_MIN : INT32_MAX);
+          }
+        return FromRaw (Saturate ((int64_t) m_raw * ONE / o.m_raw));
+      }
+
+      bool operator< (Q16_16 o) const       { return m_raw < o.m_raw; }
+      bool operator> (Q16_16 o) const       { return m_raw > o.m_raw; }
+      bool operator== (Q16_16 o) const      { return m_raw == o.m_raw; }
+
+    private:
+      static int32_t Saturate (int64_t v)
+      {
+        return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : (int32_t) v);
+      }
+
+      int32_t m_raw;
+    };
+
+    /**
+     * @brief Conversions and the square and square root kernels of a scalar type.
+     */
+    template <typename T>
+    struct NumericTraits;
+
+    template <>
+    struct NumericTraits<double>
+    {
+      static double FromDouble (double v)   { return v; }
+      static double ToDouble (double v)     { return v; }
+      static double Square (double v)       { return v * v; }
+      static double Sqrt (double v)         { return std::sqrt (v); }
+    };
+
+    template <>
+    struct NumericTraits<float>
+    {
+      static float  FromDouble (double v)   { return (float) v; }
+      static double ToDouble (float v)      { return v; }
+      static float  Square (float v)        { return v * v; }
+      static float  Sqrt (float v)          { return std::sqrt (v); }
+    };
+
+    template <>
+    struct NumericTraits<Q16_16>
+    {
+      static Q16_16 FromDouble (double v)   { return Q16_16::FromDouble (v); }
+      static double ToDouble (Q16_16 v)     { return v.ToDouble (); }
+      static Q16_16 Square (Q16_16 v)       { return v * v; }
+
+      // Digit by digit integer square root of raw << 16, no multiplications or divisions
+      static Q16_16 Sqrt (Q16_16 v)
+      {
+        if (v.GetRaw () <= 0)
+          {
+            return Q16_16 ();
+          }
+        uint64_t n = (uint64_t) v.GetRaw () << 16;
+        uint64_t root = 0;
+        uint64_t bit = (uint64_t) 1 << 62;
+        while (bit > n)
+          {
+            bit >>= 2;
+          }
+        while (bit != 0)
+          {
+            if (n >= root + bit)
+              {
+                n -= root + bit;
+                root = (root >> 1) + bit;
+              }
+            else
+              {
+                root >>= 1;
+              }
+            bit >>= 2;
+          }
+        return Q16_16::FromRaw ((int32_t) root);
+      }
+    };
+
+    /// Euclidean norm of (x, y)
+    template <typename T>
+    T VNorm (T x, T y)
+    {
+      return NumericTraits<T>::Sqrt (NumericTraits<T>::Square (x) + NumericTraits<T>::Square (y));
+    }
+
+    /// Mean distance between the 3 beacons over the mean hop count to them
+    template <typename T>
+    T AvgHopSize (T b1_x, T b1_y, T b2_x, T b2_y, T b3_x, T b3_y, T avg_nhops)
+    {
+      T d12 = VNorm (b1_x - b2_x, b1_y - b2_y);
+      T d23 = VNorm (b2_x - b3_x, b2_y - b3_y);
+      T d31 = VNorm (b3_x - b1_x, b3_y - b1_y);
+      return (d12 + d23 + d31) / (NumericTraits<T>::FromDouble (3.0) * avg_nhops);
+    }
+
+    /**
+     * Position at distances r_1, r_2 and r_3 from the 3 beacons. When degenerate
+     * is given, it tells whether the beacons were coincident or collinear, where
+     * one of the divisors is zero: a type without NaN, such as Q16.16, returns a
+     * saturated but finite position then.
+     */
+    template <typename T>
+    std::pair<T, T> Trilaterate (T x_1, T y_1, T r_1, T x_2, T y_2, T r_2, T x_3, T y_3, T r_3,
+                                 bool *degenerate = 0)
+    {
+      typedef NumericTraits<T> N;
+      T p12_d = VNorm (x_2 - x_1, y_2 - y_1);
+
+      T ex_x = (x_2 - x_1) / p12_d;
+      T ex_y = (y_2 - y_1) / p12_d;
+
+      T a_x = x_3 - x_1;
+      T a_y = y_3 - y_1;
+
+      T i = ex_x * a_x + ex_y * a_y;
+
+      T b_x = x_3 - x_1 - i * ex_x;
+      T b_y = y_3 - y_1 - i * ex_y;
+
+      T ey_x = b_x / VNorm (b_x, b_y);
+      T ey_y = b_y / VNorm (b_x, b_y);
+
+      T j = ey_x * a_x + ey_y * a_y;
+
+      if (degenerate)
+        {
+          *degenerate = p12_d == T () || VNorm (b_x, b_y) == T () || j == T ();
+        }
+
+      T two = N::FromDouble (2.0);
+      T x = (N::Square (r_1) - N::Square (r_2) + N::Square (p12_d)) / (p12_d * two);
+      T y = (N::Square (r_1) - N::Square (r_3) + N::Square (i) + N::Square (j)) / (j * two) - i * x / j;
+
+      return std::pair<T, T> (x_1 + x * ex_x + y * ey_x,
+                              y_1 + x * ex_y + y * ey_y);
+    }
+
+    /**
+     * @brief LocalizeAs One node's DV-Hop localization (AvgHopSize over the 3 beacons
+     * unless a hop size is given, then Trilaterate) computed in T from and to doubles
+     * @param x Beacon X coordinates
+     * @param y Beacon Y coordinates
+     * @param hops Hop counts to the beacons
+     * @param hopSize Hop size to use instead of AvgHopSize, e.g. a beacon's correction (0: AvgHopSize)
+     * @return The estimated position, NaN when the beacons are coincident or collinear
+     */
+    template <typename T>
+    std::pair<double, double> LocalizeAs (const double x[3], const double y[3], const double hops[3], double hopSize = 0)
+    {
+      typedef NumericTraits<T> N;
+      T bx[3], by[3];
+      for (int k = 0; k < 3; k++)
+        {
+          bx[k] = N::FromDouble (x[k]);
+          by[k] = N::FromDouble (y[k]);
+        }
+      T size;
+      if (hopSize > 0)
+        {
+          size = N::FromDouble (hopSize);
+        }
+      else
+        {
+          T avgHops = N::FromDouble ((hops[0] + hops[1] + hops[2]) / 3.0);
+          size = AvgHopSize (bx[0], by[0], bx[1], by[1], bx[2], by[2], avgHops);
+        }
+      bool degenerate;
+      std::pair<T, T> p = Trilaterate (bx[0], by[0], N::FromDouble (hops[0]) * size,
+                                       bx[1], by[1], N::FromDouble (hops[1]) * size,
+                                       bx[2], by[2], N::FromDouble (hops[2]) * size, &degenerate);
+      if (degenerate)
+        {
+          return std::pair<double, double> (NAN, NAN);
+        }
+      return std::pair<double, double> (N::ToDouble (p.first), N::ToDouble (p.second));
+    }
+
+    /// Nearest 48.16 fixed point number, the form a mote takes a coordinate, hop count or hop size in
+    inline int64_t ToQ48_16 (double v)
+    {
+      return (int64_t) std::floor (v * Q16_16::ONE + 0.5);
+    }
+
+    /// Whole units at least as large as the magnitude of a 48.16 number
+    inline int64_t CeilUnits (int64_t raw)
+    {
+      return ((raw < 0 ? -raw : raw) + Q16_16::ONE - 1) >> 16;
+    }
+
+    /// A 48.16 number divided by 2^shift, rounded to nearest
+    inline int64_t ShiftDown (int64_t raw, int shift)
+    {
+      return shift == 0 ? raw : (raw + ((int64_t) 1 << (shift - 1))) >> shift;
+    }
+
+    /**
+     * LocalizeAs in Q16.16, whose range is too narrow for squared distances. The
+     * beacons move to a frame centred on the first one and scaled down by a power
+     * of two until every coordinate and distance to a beacon is at most 32, so the
+     * sums of four squares in Trilaterate stay below 2^15.
+     *
+     * Past the conversion of the inputs to 48.16 fixed point, the frame choice
+     * uses integer operations only, like the rest: its bounds are whole meters,
+     * and the beacon distances of AvgHopSize are bounded by their L1 norms.
+     */
+    template <>
+    inline std::pair<double, double>
+    LocalizeAs<Q16_16> (const double x[3], const double y[3], const double hops[3], double hopSize)
+    {
+      const int64_t maxMagnitude = 32;
+      int64_t originX = ToQ48_16 (x[0]);
+      int64_t originY = ToQ48_16 (y[0]);
+      int64_t wx[3], wy[3], wh[3];
+      int64_t extent = 0, maxHops = 0;
+      for (int k = 0; k < 3; k++)
+        {
+          wx[k] = ToQ48_16 (x[k]) - originX;
+          wy[k] = ToQ48_16 (y[k]) - originY;
+          wh[k] = ToQ48_16 (hops[k]);
+          extent = std::max (extent, std::max (CeilUnits (wx[k]), CeilUnits (wy[k])));
+          maxHops = std::max (maxHops, CeilUnits (wh[k]));
+        }
+      int64_t sumHops = wh[0] + wh[1] + wh[2];
+
+      // Farthest distance to a beacon: hops times the hop size, or a bound of AvgHopSize,
+      // the beacon triangle's perimeter over the total hops
+      int64_t range = 0;
+      if (hopSize > 0)
+        {
+          range = maxHops * CeilUnits (ToQ48_16 (hopSize));
+        }
+      else if (sumHops >> 16 > 0)
+        {
+          int64_t perimeter = 0;
+          for (int k = 0; k < 3; k++)
+            {
+              int j = (k + 1) % 3;
+              int64_t dx = wx[k] - wx[j];
+              int64_t dy = wy[k] - wy[j];
+              perimeter += CeilUnits ((dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy));
+            }
+          int64_t totalHops = sumHops >> 16;
+          range = (maxHops * perimeter + totalHops - 1) / totalHops;
+        }
+      int shift = 0;
+      while (std::max (extent, range) > (maxMagnitude << shift))
+        {
+          shift++;
+        }
+
+      Q16_16 bx[3], by[3];
+      for (int k = 0; k < 3; k++)
+        {
+          bx[k] = Q16_16::FromWide (ShiftDown (wx[k], shift));
+          by[k] = Q16_16::FromWide (ShiftDown (wy[k], shift));
+        }
+      Q16_16 size;
+      if (hopSize > 0)
+        {
+          size = Q16_16::FromWide (ShiftDown (ToQ48_16 (hopSize), shift));
+        }
+      else
+        {
+          Q16_16 avgHops = Q16_16::FromWide ((sumHops + 1) / 3);
+          size = AvgHopSize (bx[0], by[0], bx[1], by[1], bx[2], by[2], avgHops);
+        }
+      bool degenerate;
+      std::pair<Q16_16, Q16_16> p = Trilaterate (bx[0], by[0], Q16_16::FromWide (wh[0]) * size,
+                                                 bx[1], by[1], Q16_16::FromWide (wh[1]) * size,
+                                                 bx[2], by[2], Q16_16::FromWide (wh[2]) * size, &degenerate);
+      if (degenerate)
+        {
+          return std::pair<double, double> (NAN, NAN);
+        }
+      int64_t scale = (int64_t) 1 << shift;
+      return std::pair<double, double> ((double) (originX + p.first.GetRaw () * scale) / Q16_16::ONE,
+                                        (double) (originY + p.second.GetRaw () * scale) / Q16_16::ONE);
+    }
+
+    /// LocalizeAs in the given numeric type
+    inline std::pair<double, double>
+    LocalizeAs (NumericType type, const double x[3], const double y[3], const double hops[3], double hopSize = 0)
+    {
+      switch (type)
+        {
+        case NUMERIC_FLOAT:  return LocalizeAs<float> (x, y, hops, hopSize);
+        case NUMERIC_Q16_16: return LocalizeAs<Q16_16> (x, y, hops, hopSize);
+        default:             return LocalizeAs<double> (x, y, hops, hopSize);
+        }
+    }
+  }
+}
+
+#endif // LOCALIZATION_MATH_H
@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef PROTOCOL_COUNTERS_H
+#define PROTOCOL_COUNTERS_H
+
+#include <stdint.h>
+#include <chrono>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+    /**
+     * @brief Per-node activity counters of the DV-Hop protocol
+     */
+    struct ProtocolCounters
+    {
+      uint64_t hellosSent;
+      uint64_t hellosReceived;
+      /// Position requests and positions sent, compact HELLO mode only
+      uint64_t positionsSent;
+      uint64_t bytesSent;
+      /// Beacons added to the distance table
+      uint64_t inserts;
+      /// Entries replaced by a shorter path
+      uint64_t improvements;
+      /// Entries refreshed without a change
+      uint64_t touches;
+      /// Entries removed by TrimExpiredEntries
+      uint64_t expirations;
+      /// Entries dropped by the eviction policy of a full table
+      uint64_t evictions;
+      /// New beacons the eviction policy of a full table turned away
+      uint64_t rejections;
+      /// Entries moved to an alternate neighbor when theirs went silent, neighbor provenance only
+      uint64_t switches;
+      /// HELLOs that led to a trilateration
+      uint64_t localizationsRun;
+      /// HELLOs received while fewer than 3 beacons were known
+      uint64_t localizationsSkipped;
+
+      ProtocolCounters ()
+        : hellosSent (0), hellosReceived (0), positionsSent (0), bytesSent (0), inserts (0), improvements (0),
+          touches (0), expirations (0), evictions (0), rejections (0), switches (0), localizationsRun (0), localizationsSkipped (0)
+      {
+      }
+
+      ProtocolCounters & operator+= (const ProtocolCounters &o)
+      {
+        hellosSent += o.hellosSent;
+        hellosReceived += o.hellosReceived;
+        positionsSent += o.positionsSent;
+        bytesSent += o.bytesSent;
+        inserts += o.inserts;
+        improvements += o.improvements;
+        touches += o.touches;
+        expirations += o.expirations;
+        evictions += o.evictions;
+        rejections += o.rejections;
+        switches += o.switches;
+        localizationsRun += o.localizationsRun;
+        localizationsSkipped += o.localizationsSkipped;
+        return *this;
+      }
+    };
+
+    /// Handlers timed when the Profiling attribute is set
+    enum ProfiledHandler
+    {
+      PROFILE_RECV_DVHOP,
+      PROFILE_SEND_HELLO,
+      PROFILE_TRIM_EXPIRED,
+      PROFILE_TRILATERATE,
+      PROFILE_HANDLER_COUNT
+    };
+
+    inline const char *
+    ProfiledHandlerName (ProfiledHandler handler)
+    {
+      switch (handler)
+        {
+        case PROFILE_RECV_DVHOP:   return "RecvDvhop";
+        case PROFILE_SEND_HELLO:   return "SendHello";
+        case PROFILE_TRIM_EXPIRED: return "TrimExpiredEntries";
+        case PROFILE_TRILATERATE:  return "Trilaterate";
+        default:                   return "Unknown";
+        }
+    }
+
+    /**
+     * @brief Call count and wall-clock time spent in one handler
+     */
+    struct HandlerProfile
+    {
+      uint64_t calls;
+      uint64_t nanoseconds;
+
+      HandlerProfile () : calls (0), nanoseconds (0) {}
+    };
+
+    /**
+     * @brief Adds the lifetime of the enclosing scope to a HandlerProfile.
+     * Does nothing, not even read the clock, when given a null profile
+     */
+    class ScopedProfile
+    {
+    public:
+      explicit ScopedProfile (HandlerProfile *profile) : m_profile (profile)
+      {
+        if (m_profile)
+          {
+            m_start = std::chrono::steady_clock::now ();
+          }
+      }
+
+      ~ScopedProfile ()
+      {
+        if (m_profile)
+          {
+            std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now () - m_start;
+            m_profile->calls++;
+            m_profile->nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds> (elapsed).count ();
+          }
+      }
+
+    private:
+      ScopedProfile (const ScopedProfile &);
+      ScopedProfile & operator= (const ScopedProfile &);
+
+      HandlerProfile *m_profile;
+      std::chrono::steady_clock::time_point m_start;
+    };
+  }
+}
+
+#endif // PROTOCOL_COUNTERS_H
@@ -0,0 +1,277 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "stats-writer.h"
+
+#include <chrono>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+    const size_t StatsWriter::DEFAULT_CAPACITY = 65536;
+
+    // Bytes formatted before a write is issued, and room left for one more line
+    static const size_t BATCH_BYTES = 1 << 20;
+    static const size_t MAX_LINE = 512;
+
+    // How long the writer thread sleeps when the ring is empty
+    static const std::chrono::microseconds IDLE_WAIT (200);
+
+    static const char *
+    StatsEventName (uint8_t event)
+    {
+      switch (event)
+        {
+        case STATS_EVENT_EXPIRED_ENTRY: return "EXPIRED_ENTRY";
+        case STATS_EVENT_DISABLED_NODE: return "DISABLED_NODE";
+        case STATS_EVENT_CONVERGED:     return "CONVERGED";
+        default:                        return "UNKNOWN";
+        }
+    }
+
+    FILE *
+    OpenGzip (const std::string &path)
+    {
+      // Single quotes keep everything literal but themselves, which close, escape and reopen
+      std::string quoted = "'";
+      for (std::string::const_iterator c = path.begin (); c != path.end (); ++c)
+        {
+          quoted += *c == '\'' ? std::string ("'\\''") : std::string (1, *c);
+        }
+      quoted += "'";
+      return popen (("gzip -c > " + quoted).c_str (), "w");
+    }
+
+    StatsWriter&
+    StatsWriter::Get ()
+    {
+      static StatsWriter writer;
+      return writer;
+    }
+
+    StatsWriter::StatsWriter ()
+      : m_mask (0),
+        m_policy (OVERFLOW_BLOCK),
+        m_head (0),
+        m_tail (0),
+        m_stop (false),
+        m_written (0),
+        m_dropped (0),
+        m_stalls (0),
+        m_file (0),
+        m_pipe (false),
+        m_open (false)
+    {
+    }
+
+    StatsWriter::~StatsWriter ()
+    {
+      Close ();
+    }
+
+    bool
+    StatsWriter::Open (const std::string &path, OverflowPolicy policy, size_t capacity)
+    {
+      Close ();
+
+      if (path.empty () || path == "-")
+        {
+          m_file = stdout;
+          m_pipe = false;
+        }
+      else if (path.size () > 3 && path.compare (path.size () - 3, 3, ".gz") == 0)
+        {
+          m_file = OpenGzip (path);
+          m_pipe = true;
+        }
+      else
+        {
+          m_file = fopen (path.c_str (), "w");
+          m_pipe = false;
+        }
+      if (m_file == 0)
+        {
+          return false;
+        }
+
+      size_t size = 2;
+      while (size < capacity)
+        {
+          size <<= 1;
+        }
+      m_ring.assign (size, StatsRecord ());
+      m_mask = size - 1;
+      m_policy = policy;
+      m_head.store (0);
+      m_tail.store (0);
+      m_stop.store (false);
+      m_written.store (0);
+      m_dropped.store (0);
+      m_stalls.store (0);
+      m_open = true;
+      m_thread = std::thread (&StatsWriter::Run, this);
+      return true;
+    }
+
+    void
+    StatsWriter::Close ()
+    {
+      if (!m_open)
+        {
+          return;
+        }
+      m_stop.store (true, std::memory_order_release);
+      m_thread.join ();
+      fflush (m_file);
+      if (m_pipe)
+        {
+          pclose (m_file);
+        }
+      else if (m_file != stdout)
+        {
+          fclose (m_file);
+        }
+      m_file = 0;
+      m_open = false;
+    }
+
+    void
+    StatsWriter::WriteNode (uint64_t timeMs, uint32_t node, uint32_t tableSize,
+                            double x, double y, double errorX, double errorY)
+    {
+      StatsRecord record;
+      record.timeMs = timeMs;
+      record.node = node;
+      record.tableSize = tableSize;
+      record.x = x;
+      record.y = y;
+      record.errorX = errorX;
+      record.errorY = errorY;
+      record.isEvent = 0;
+      record.event = 0;
+      Push (record);
+    }
+
+    void
+    StatsWriter::WriteEvent (uint64_t timeMs, StatsEvent event)
+    {
+      StatsRecord record = StatsRecord ();
+      record.timeMs = timeMs;
+      record.isEvent = 1;
+      record.event = event;
+      Push (record);
+    }
+
+    void
+    StatsWriter::Push (const StatsRecord &record)
+    {
+      if (!m_open)
+        {
+          Open ("");
+        }
+
+      size_t head = m_head.load (std::memory_order_relaxed);
+      bool stalled = false;
+      while (head - m_tail.load (std::memory_order_acquire) > m_mask)
+        {
+          if (m_policy == OVERFLOW_DROP)
+            {
+              m_dropped.fetch_add (1, std::memory_order_relaxed);
+              return;
+            }
+          if (!stalled)
+            {
+              m_stalls.fetch_add (1, std::memory_order_relaxed);
+              stalled = true;
+            }
+          std::this_thread::yield ();
+        }
+      m_ring[head & m_mask] = record;
+      m_head.store (head + 1, std::memory_order_release);
+    }
+
+    void
+    StatsWriter::Run ()
+    {
+      std::vector<char> buffer (BATCH_BYTES + MAX_LINE);
+      size_t used = 0;
+      bool unflushed = false;
+      for (;;)
+        {
+          size_t tail = m_tail.load (std::memory_order_relaxed);
+          size_t head = m_head.load (std::memory_order_acquire);
+          if (tail == head)
+            {
+              if (used > 0)
+                {
+                  fwrite (&buffer[0], 1, used, m_file);
+                  used = 0;
+                  unflushed = true;
+                }
+              if (m_stop.load (std::memory_order_acquire))
+                {
+                  // The producer is done, anything it pushed before Close is visible now
+                  if (m_head.load (std::memory_order_acquire) == tail)
+                    {
+                      break;
+                    }
+                  continue;
+                }
+              if (unflushed)
+                {
+                  fflush (m_file);
+                  unflushed = false;
+                }
+              std::this_thread::sleep_for (IDLE_WAIT);
+              continue;
+            }
+
+          while (tail != head)
+            {
+              used += Format (m_ring[tail & m_mask], &buffer[used]);
+              tail++;
+              if (used >= BATCH_BYTES)
+                {
+                  break;
+                }
+            }
+          uint64_t formatted = tail - m_tail.load (std::memory_order_relaxed);
+          m_tail.store (tail, std::memory_order_release);
+          m_written.fetch_add (formatted, std::memory_order_relaxed);
+
+          if (used >= BATCH_BYTES)
+            {
+              fwrite (&buffer[0], 1, used, m_file);
+              used = 0;
+              unflushed = true;
+            }
+        }
+    }
+
+    size_t
+    StatsWriter::Format (const StatsRecord &r, char *out) const
+    {
+      int n;
+      if (r.isEvent)
+        {
+          n = snprintf (out, MAX_LINE, "@STATS@TIME@%llu@EVENT@%s@\n",
+                        (unsigned long long) r.timeMs, StatsEventName (r.event));
+        }
+      else
+        {
+          // %g matches the default std::ostream formatting the statistics were printed with
+          n = snprintf (out, MAX_LINE,
+                        "@STATS@TIME@%llu@NODE@%u.%u.%u.%u@HOP_TABLE_SIZE@%u"
+                        "@POSITION_X@%g@POSITION_Y@%g@ERROR_X@%g@ERROR_Y@%g@\n",
+                        (unsigned long long) r.timeMs,
+                        r.node >> 24, (r.node >> 16) & 0xff, (r.node >> 8) & 0xff, r.node & 0xff,
+                        r.tableSize, r.x, r.y, r.errorX, r.errorY);
+        }
+      if (n < 0)
+        {
+          return 0;
+        }
+      return (size_t) n < MAX_LINE ? (size_t) n : MAX_LINE - 1;
+    }
+  }
+}
@@ -0,0 +1,132 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef STATS_WRITER_H
+#define STATS_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+    /// Event codes of @STATS@TIME@<ms>@EVENT@<code>@ lines
+    enum StatsEvent
+    {
+      STATS_EVENT_EXPIRED_ENTRY,
+      STATS_EVENT_DISABLED_NODE,
+      STATS_EVENT_CONVERGED
+    };
+
+    /**
+     * @brief One statistics line, kept unformatted until it reaches the writer thread
+     */
+    struct StatsRecord
+    {
+      uint64_t timeMs;
+      uint32_t node;        // IPv4 address in host order, node records only
+      uint32_t tableSize;
+      double   x;
+      double   y;
+      double   errorX;
+      double   errorY;
+      uint8_t  isEvent;
+      uint8_t  event;       // StatsEvent, event records only
+    };
+
+    /**
+     * @brief The StatsWriter class moves the @STATS output off the simulator thread.
+     *
+     * The simulator thread stores raw records in a lock-free single-producer,
+     * single-consumer ring; a background thread formats them into the text
+     * format read by stats_to_csv and writes it in large batches. Output goes
+     * to stdout or to a file, through gzip when the file name ends in ".gz".
+     * When the ring is full the producer either waits for room (counted as a
+     * stall) or drops the record (counted as a drop).
+     *
+     * All methods except the counter getters must be called from the simulator thread.
+     */
+    class StatsWriter
+    {
+    public:
+      enum OverflowPolicy
+      {
+        OVERFLOW_BLOCK,
+        OVERFLOW_DROP
+      };
+
+      /**
+       * @brief Get The process-wide writer, opened on stdout with default settings on first use
+       */
+      static StatsWriter& Get ();
+
+      /**
+       * @brief Open Sets the destination and ring size, flushing and closing the current one.
+       * The written, dropped and stall counters restart at 0
+       * @param path Output file, empty or "-" for stdout, gzip-compressed if it ends in ".gz"
+       * @param policy What to do when the ring is full
+       * @param capacity Ring size in records, rounded up to a power of two
+       * @return false if the destination could not be opened
+       */
+      bool Open (const std::string &path, OverflowPolicy policy = OVERFLOW_BLOCK, size_t capacity = DEFAULT_CAPACITY);
+
+      /**
+       * @brief Close Writes every queued record, stops the writer thread and closes the destination
+       */
+      void Close ();
+
+      /// @STATS@TIME@..@NODE@..@HOP_TABLE_SIZE@..@POSITION_X@..@POSITION_Y@..@ERROR_X@..@ERROR_Y@..@
+      void WriteNode (uint64_t timeMs, uint32_t node, uint32_t tableSize,
+                      double x, double y, double errorX, double errorY);
+
+      /// @STATS@TIME@..@EVENT@..@
+      void WriteEvent (uint64_t timeMs, StatsEvent event);
+
+      uint64_t GetWritten () const  { return m_written.load (std::memory_order_relaxed); }
+      uint64_t GetDropped () const  { return m_dropped.load (std::memory_order_relaxed); }
+      uint64_t GetStalls () const   { return m_stalls.load (std::memory_order_relaxed); }
+
+      static const size_t DEFAULT_CAPACITY;
+
+    private:
+      StatsWriter ();
+      ~StatsWriter ();
+      StatsWriter (const StatsWriter &);
+      StatsWriter & operator= (const StatsWriter &);
+
+      void Push (const StatsRecord &record);
+      void Run ();
+      size_t Format (const StatsRecord &record, char *out) const;
+
+      std::vector<StatsRecord> m_ring;
+      size_t                   m_mask;
+      OverflowPolicy           m_policy;
+
+      // Producer and consumer indices on separate cache lines
+      alignas(64) std::atomic<size_t> m_head;
+      alignas(64) std::atomic<size_t> m_tail;
+      alignas(64) std::atomic<bool>   m_stop;
+
+      std::atomic<uint64_t> m_written;
+      std::atomic<uint64_t> m_dropped;
+      std::atomic<uint64_t> m_stalls;
+
+      FILE        *m_file;
+      bool         m_pipe;
+      bool         m_open;
+      std::thread  m_thread;
+    };
+
+    /**
+     * @brief OpenGzip Starts gzip compressing into a file, whatever characters its name holds
+     * @param path Compressed output file
+     * @return The write end of a pipe to gzip, to close with pclose, or 0 on failure
+     */
+    FILE *OpenGzip (const std::string &path);
+  }
+}
+
+#endif // STATS_WRITER_H
@@ -0,0 +1,269 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "timing-wheel-scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+#include <algorithm>
+#include <cstring>
+
+NS_LOG_COMPONENT_DEFINE ("TimingWheelScheduler");
+
+namespace ns3 {
+
+  NS_OBJECT_ENSURE_REGISTERED (TimingWheelScheduler);
+
+  namespace {
+    // Turns std heap functions into a min-heap on (timestamp, uid)
+    struct Later
+    {
+      bool operator() (const Scheduler::Event &a, const Scheduler::Event &b) const
+      {
+        return b.key < a.key;
+      }
+    };
+  }
+
+  TypeId
+  TimingWheelScheduler::GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::TimingWheelScheduler")
+        .SetParent<Scheduler> ()
+        .AddConstructor<TimingWheelScheduler> ()
+        .AddAttribute ("SlotWidth",
+                       "Width of a wheel slot, rounded down to a power of two of the time resolution.",
+                       TimeValue (MicroSeconds (16)),
+                       MakeTimeAccessor (&TimingWheelScheduler::SetSlotWidth,
+                                         &TimingWheelScheduler::GetSlotWidth),
+                       MakeTimeChecker ());
+    return tid;
+  }
+
+  TimingWheelScheduler::TimingWheelScheduler ()
+    : m_shift (0),
+      m_cursor (0),
+      m_count (0)
+  {
+    NS_LOG_FUNCTION (this);
+    memset (m_occupied, 0, sizeof (m_occupied));
+  }
+
+  TimingWheelScheduler::~TimingWheelScheduler ()
+  {
+    NS_LOG_FUNCTION (this);
+  }
+
+  void
+  TimingWheelScheduler::SetSlotWidth (Time width)
+  {
+    NS_ASSERT_MSG (m_count == 0, "The slot width can only change while the scheduler is empty");
+    int64_t ticks = width.GetTimeStep ();
+    uint32_t shift = 0;
+    while (shift < 62 && (int64_t (2) << shift) <= ticks)
+      {
+        shift++;
+      }
+    m_shift = shift;
+    m_cursor = 0;
+  }
+
+  Time
+  TimingWheelScheduler::GetSlotWidth (void) const
+  {
+    return TimeStep (uint64_t (1) << m_shift);
+  }
+
+  int32_t
+  TimingWheelScheduler::LevelOf (uint64_t slot) const
+  {
+    if (slot <= m_cursor)
+      {
+        return -1;
+      }
+    uint64_t diff = slot ^ m_cursor;
+    uint32_t highest = 63 - __builtin_clzll (diff);
+    uint32_t level = highest / SLOT_BITS;
+    return level < LEVELS ? level : LEVELS;
+  }
+
+  void
+  TimingWheelScheduler::Place (const Scheduler::Event &ev)
+  {
+    uint64_t slot = SlotOf (ev);
+    int32_t level = LevelOf (slot);
+    if (level < 0)
+      {
+        m_ready.push_back (ev);
+        std::push_heap (m_ready.begin (), m_ready.end (), Later ());
+      }
+    else if (level == (int32_t) LEVELS)
+      {
+        m_overflow.push_back (ev);
+        std::push_heap (m_overflow.begin (), m_overflow.end (), Later ());
+      }
+    else
+      {
+        uint32_t index = (slot >> (level * SLOT_BITS)) & (SLOTS - 1);
+        m_wheel[level][index].push_back (ev);
+        m_occupied[level][index / 64] |= uint64_t (1) << (index % 64);
+      }
+  }
+
+  int32_t
+  TimingWheelScheduler::NextOccupied (uint32_t level, uint32_t from) const
+  {
+    for (uint32_t word = from / 64; word < WORDS; word++)
+      {
+        uint64_t bits = m_occupied[level][word];
+        if (word == from / 64)
+          {
+            bits &= ~uint64_t (0) << (from % 64);
+          }
+        if (bits)
+          {
+            return word * 64 + __builtin_ctzll (bits);
+          }
+      }
+    return -1;
+  }
+
+  void
+  TimingWheelScheduler::Refill (void)
+  {
+    NS_ASSERT (m_count > 0);
+    while (m_ready.empty ())
+      {
+        bool moved = false;
+        for (uint32_t level = 0; level < LEVELS && !moved; level++)
+          {
+            uint32_t shift = level * SLOT_BITS;
+            uint32_t current = (m_cursor >> shift) & (SLOTS - 1);
+            int32_t next = NextOccupied (level, current + 1);
+            if (next < 0)
+              {
+                continue;
+              }
+
+            // Move the cursor to the start of that slot and empty it
+            uint64_t above = (m_cursor >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+            m_cursor = above | (uint64_t (next) << shift);
+            m_occupied[level][next / 64] &= ~(uint64_t (1) << (next % 64));
+            if (level == 0)
+              {
+                m_ready.swap (m_wheel[0][next]);
+                std::make_heap (m_ready.begin (), m_ready.end (), Later ());
+              }
+            else
+              {
+                m_cascade.swap (m_wheel[level][next]);
+                for (Bucket::const_iterator it = m_cascade.begin (); it != m_cascade.end (); ++it)
+                  {
+                    Place (*it);
+                  }
+                m_cascade.clear ();
+              }
+            moved = true;
+          }
+
+        if (!moved)
+          {
+            // Every wheel is empty: jump to the earliest overflow event and pull in what now fits
+            NS_ASSERT (!m_overflow.empty ());
+            m_cursor = SlotOf (m_overflow.front ());
+            while (!m_overflow.empty () && LevelOf (SlotOf (m_overflow.front ())) < (int32_t) LEVELS)
+              {
+                std::pop_heap (m_overflow.begin (), m_overflow.end (), Later ());
+                Scheduler::Event ev = m_overflow.back ();
+                m_overflow.pop_back ();
+                Place (ev);
+              }
+          }
+      }
+  }
+
+  void
+  TimingWheelScheduler::Insert (const Scheduler::Event &ev)
+  {
+    NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+    Place (ev);
+    m_count++;
+  }
+
+  bool
+  TimingWheelScheduler::IsEmpty (void) const
+  {
+    return m_count == 0;
+  }
+
+  Scheduler::Event
+  TimingWheelScheduler::PeekNext (void) const
+  {
+    NS_LOG_FUNCTION (this);
+    NS_ASSERT (!IsEmpty ());
+    // Moving the cursor does not change the set of events, only where they are kept
+    const_cast<TimingWheelScheduler *> (this)->Refill ();
+    return m_ready.front ();
+  }
+
+  Scheduler::Event
+  TimingWheelScheduler::RemoveNext (void)
+  {
+    NS_LOG_FUNCTION (this);
+    NS_ASSERT (!IsEmpty ());
+    if (m_ready.empty ())
+      {
+        Refill ();
+      }
+    std::pop_heap (m_ready.begin (), m_ready.end (), Later ());
+    Scheduler::Event ev = m_ready.back ();
+    m_ready.pop_back ();
+    m_count--;
+    return ev;
+  }
+
+  void
+  TimingWheelScheduler::Remove (const Scheduler::Event &ev)
+  {
+    NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+    uint64_t slot = SlotOf (ev);
+    int32_t level = LevelOf (slot);
+    Bucket *bucket;
+    uint32_t index = 0;
+    if (level < 0)
+      {
+        bucket = &m_ready;
+      }
+    else if (level == (int32_t) LEVELS)
+      {
+        bucket = &m_overflow;
+      }
+    else
+      {
+        index = (slot >> (level * SLOT_BITS)) & (SLOTS - 1);
+        bucket = &m_wheel[level][index];
+      }
+
+    for (Bucket::iterator it = bucket->begin (); it != bucket->end (); ++it)
+      {
+        if (it->key.m_uid == ev.key.m_uid)
+          {
+            NS_ASSERT (it->impl == ev.impl);
+            *it = bucket->back ();
+            bucket->pop_back ();
+            if (level < 0 || level == (int32_t) LEVELS)
+              {
+                std::make_heap (bucket->begin (), bucket->end (), Later ());
+              }
+            else if (bucket->empty ())
+              {
+                m_occupied[level][index / 64] &= ~(uint64_t (1) << (index % 64));
+              }
+            m_count--;
+            return;
+          }
+      }
+    NS_ASSERT_MSG (false, "Event " << ev.key.m_uid << " is not scheduled");
+  }
+
+}
@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef TIMING_WHEEL_SCHEDULER_H
+#define TIMING_WHEEL_SCHEDULER_H
+
+#include "ns3/scheduler.h"
+#include "ns3/nstime.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief A hierarchical timing wheel event scheduler.
+   *
+   * Time is cut in slots of SlotWidth (rounded down to a power of two of the
+   * simulator resolution). Four wheels of 256 slots cover 2^32 slots ahead of
+   * the cursor; later events wait in an overflow heap. Inserting costs a
+   * push_back into a slot vector, and each event is moved down a wheel at
+   * most three times before it reaches the slot the cursor is in, where a
+   * small binary heap orders it exactly by (timestamp, uid).
+   *
+   * Slot vectors keep their capacity, so in steady state, e.g. periodic
+   * HELLO timers and jittered sends a few ms ahead, no memory is allocated per event.
+   */
+  class TimingWheelScheduler : public Scheduler
+  {
+  public:
+    static TypeId GetTypeId (void);
+
+    TimingWheelScheduler ();
+    virtual ~TimingWheelScheduler ();
+
+    // Inherited
+    virtual void Insert (const Scheduler::Event &ev);
+    virtual bool IsEmpty (void) const;
+    virtual Scheduler::Event PeekNext (void) const;
+    virtual Scheduler::Event RemoveNext (void);
+    virtual void Remove (const Scheduler::Event &ev);
+
+  private:
+    static const uint32_t LEVELS = 4;
+    static const uint32_t SLOT_BITS = 8;
+    static const uint32_t SLOTS = 1 << SLOT_BITS;
+    static const uint32_t WORDS = SLOTS / 64;
+
+    typedef std::vector<Scheduler::Event> Bucket;
+
+    void     SetSlotWidth (Time width);
+    Time     GetSlotWidth (void) const;
+
+    uint64_t SlotOf (const Scheduler::Event &ev) const { return ev.key.m_ts >> m_shift; }
+
+    // Wheel holding a slot relative to the cursor, -1 for the ready heap, LEVELS for the overflow heap
+    int32_t  LevelOf (uint64_t slot) const;
+
+    void     Place (const Scheduler::Event &ev);
+
+    // Advances the cursor until the ready heap holds the next events
+    void     Refill (void);
+
+    // First occupied slot of a wheel at or after from, -1 if none
+    int32_t  NextOccupied (uint32_t level, uint32_t from) const;
+
+    uint32_t m_shift;
+    uint64_t m_cursor;
+    uint32_t m_count;
+
+    Bucket   m_ready;      // Min-heap of the events in slots up to the cursor
+    Bucket   m_overflow;   // Min-heap of the events past the last wheel
+    Bucket   m_cascade;    // Scratch space to redistribute a slot
+    Bucket   m_wheel[LEVELS][SLOTS];
+    uint64_t m_occupied[LEVELS][WORDS];
+  };
+
+}
+
+#endif /* TIMING_WHEEL_SCHEDULER_H */
@@ -0,0 +1,329 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/dvhop.h"
+#include "ns3/dvhop-helper.h"
+#include "ns3/stats-writer.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+
+#include "ns3/test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ Golden-workload regression benchmark
+
+ Each case runs one fixed-seed scenario through the full stack (grid like
+ dvhop-example, YANS WiFi, DV-Hop) and then:
+  - compares the final hop tables and position estimates of every node with
+    the stored snapshot regression-<scenario>.golden; hop counts must match
+    exactly and positions within GOLDEN_POSITION_TOLERANCE,
+  - compares the wall time of Simulator::Run with the baseline
+    regression-<scenario>.baseline and fails past the allowed slowdown
+    (DVHOP_REGRESSION_SLOWDOWN, 1.5 by default). Baselines depend on the
+    machine and are not committed; without one only events/s is reported.
+
+ The snapshot and baseline of the current run are written next to the other
+ test output; run with --update-data to store them as the new reference:
+   ./waf --run "test-runner --suite=dvhop-regression --fullness=EXTENSIVE --update-data"
+ */
+
+static const double GOLDEN_POSITION_TOLERANCE = 1e-3;  // m
+
+struct RegressionScenario
+{
+  const char *name;
+  uint32_t size;
+  uint32_t beacons;
+  double step;
+  double time;
+  uint32_t damage;
+};
+
+// Runs one scenario and checks it against its golden snapshot and baseline
+class RegressionTestCase : public TestCase
+{
+public:
+  RegressionTestCase (const RegressionScenario &scenario);
+
+private:
+  virtual void DoRun (void);
+
+  void     Build (NodeContainer &nodes);
+  void     DisableNode (Ptr<Node> node, uint32_t index);
+  uint32_t Random (uint32_t max);
+  void     WriteSnapshot (NodeContainer &nodes, const std::string &path);
+  void     CheckSnapshot (const std::string &path, const std::string &goldenPath);
+  void     CheckBaseline (uint64_t events, double wall, const std::string &path, const std::string &baselinePath);
+
+  RegressionScenario m_scenario;
+  uint64_t m_rng;
+};
+
+RegressionTestCase::RegressionTestCase (const RegressionScenario &scenario)
+  : TestCase (std::string ("Golden workload ") + scenario.name),
+    m_scenario (scenario),
+    m_rng (12345)
+{
+  SetDataDir (NS_TEST_SOURCEDIR);
+}
+
+uint32_t
+RegressionTestCase::Random (uint32_t max)
+{
+  // Position offsets and damage schedule, independent of std::rand
+  m_rng = m_rng * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (uint32_t) ((m_rng >> 33) % max);
+}
+
+void
+RegressionTestCase::DisableNode (Ptr<Node> node, uint32_t index)
+{
+  // Out of radio range, as dvhop-example does
+  node->GetObject<ConstantPositionMobilityModel> ()->SetPosition (Vector (100000.0 * (index + 1), 100000.0 * (index + 1), 0));
+}
+
+void
+RegressionTestCase::Build (NodeContainer &nodes)
+{
+  const RegressionScenario &s = m_scenario;
+  nodes.Create (s.size);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
+                                 "MinX", DoubleValue (s.step),
+                                 "MinY", DoubleValue (s.step),
+                                 "DeltaX", DoubleValue (s.step),
+                                 "DeltaY", DoubleValue (s.step),
+                                 "GridWidth", UintegerValue ((uint32_t) std::sqrt ((double) s.size)),
+                                 "LayoutType", StringValue ("RowFirst"));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  WifiMacHelper wifiMac;
+  wifiMac.SetType ("ns3::AdhocWifiMac");
+  YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default ();
+  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
+  wifiPhy.SetChannel (wifiChannel.Create ());
+  WifiHelper wifi;
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("OfdmRate6Mbps"), "RtsCtsThreshold", UintegerValue (0));
+  NetDeviceContainer devices = wifi.Install (wifiPhy, wifiMac, nodes);
+
+  DVHopHelper dvhop;
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (dvhop);
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  address.Assign (devices);
+
+  // Fixed streams, so the result does not depend on what ran before in this process
+  int64_t stream = 0;
+  stream += wifi.AssignStreams (devices, stream);
+  stream += stack.AssignStreams (nodes, stream);
+  dvhop.AssignStreams (nodes, stream);
+
+  uint32_t stepThrough = s.size / s.beacons;
+  for (uint32_t i = 0; i < s.size; i++)
+    {
+      Ptr<dvhop::RoutingProtocol> rp = DynamicCast<dvhop::RoutingProtocol> (nodes.Get (i)->GetObject<Ipv4> ()->GetRoutingProtocol ());
+      Vector p = nodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+      double x = p.x + Random (1000) / 100.0;
+      double y = p.y + Random (1000) / 100.0;
+      rp->SetPosition (x, y);
+      rp->SetPresetXY (x, y);
+      rp->SetIsBeacon (i % stepThrough == 0 && i / stepThrough < s.beacons);
+    }
+
+  uint32_t timeMs = (uint32_t) (s.time * 1000);
+  for (uint32_t i = 0; i < s.damage; i++)
+    {
+      uint32_t index = Random (s.size - 1);
+      Simulator::Schedule (MilliSeconds (Random (timeMs)), &RegressionTestCase::DisableNode, this, nodes.Get (index), index);
+    }
+}
+
+void
+RegressionTestCase::WriteSnapshot (NodeContainer &nodes, const std::string &path)
+{
+  // H <node> <beacon> <hops>, beacons in address order, then P <node> <x> <y>
+  std::ofstream os (path.c_str ());
+  os << "# " << m_scenario.name << " size " << m_scenario.size << " beacons " << m_scenario.beacons
+     << " step " << m_scenario.step << " time " << m_scenario.time << " damage " << m_scenario.damage << "\n";
+  os << std::setprecision (10);
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<dvhop::RoutingProtocol> rp = DynamicCast<dvhop::RoutingProtocol> (nodes.Get (i)->GetObject<Ipv4> ()->GetRoutingProtocol ());
+      const dvhop::DistanceTable &table = rp->GetDistanceTable ();
+      std::vector<Ipv4Address> known = table.GetKnownBeacons ();
+      std::sort (known.begin (), known.end ());
+      for (size_t b = 0; b < known.size (); b++)
+        {
+          os << "H " << i << " " << known[b] << " " << table.GetHopsTo (known[b]) << "\n";
+        }
+      os << "P " << i << " " << rp->GetXPosition () << " " << rp->GetYPosition () << "\n";
+    }
+}
+
+void
+RegressionTestCase::CheckSnapshot (const std::string &path, const std::string &goldenPath)
+{
+  std::ifstream golden (goldenPath.c_str ());
+  NS_TEST_ASSERT_MSG_EQ (golden.is_open (), true, "No golden snapshot " << goldenPath << ", store one with --update-data");
+  std::ifstream current (path.c_str ());
+  NS_TEST_ASSERT_MSG_EQ (current.is_open (), true, "Snapshot " << path << " was not written");
+
+  std::string expected, actual;
+  uint32_t line = 0;
+  uint32_t mismatches = 0;
+  std::string first;
+  while (true)
+    {
+      bool moreExpected = (bool) std::getline (golden, expected);
+      bool moreActual = (bool) std::getline (current, actual);
+      if (!moreExpected && !moreActual)
+        {
+          break;
+        }
+      line++;
+      bool same;
+      if (!moreExpected || !moreActual)
+        {
+          same = false;
+        }
+      else if (expected.compare (0, 2, "P ") == 0 && actual.compare (0, 2, "P ") == 0)
+        {
+          // Positions within tolerance, the node must be the same
+          std::istringstream e (expected.substr (2)), a (actual.substr (2));
+          uint32_t eNode, aNode;
+          double eX, eY, aX, aY;
+          e >> eNode >> eX >> eY;
+          a >> aNode >> aX >> aY;
+          same = eNode == aNode
+            && std::fabs (eX - aX) <= GOLDEN_POSITION_TOLERANCE
+            && std::fabs (eY - aY) <= GOLDEN_POSITION_TOLERANCE;
+        }
+      else
+        {
+          same = expected == actual;
+        }
+      if (!same)
+        {
+          if (mismatches == 0)
+            {
+              first = "line " + std::to_string (line) + ": expected \"" + expected + "\", got \"" + actual + "\"";
+            }
+          mismatches++;
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (mismatches, 0u, m_scenario.name << " differs from " << goldenPath << " on " << mismatches << " lines, first at " << first);
+}
+
+void
+RegressionTestCase::CheckBaseline (uint64_t events, double wall, const std::string &path, const std::string &baselinePath)
+{
+  {
+    std::ofstream os (path.c_str ());
+    os << "# events wall_s\n" << events << " " << std::setprecision (6) << wall << "\n";
+  }
+
+  double maxSlowdown = 1.5;
+  const char *env = std::getenv ("DVHOP_REGRESSION_SLOWDOWN");
+  if (env)
+    {
+      maxSlowdown = std::atof (env);
+    }
+
+  std::ifstream baseline (baselinePath.c_str ());
+  if (!baseline.is_open ())
+    {
+      // Nothing to compare with on this machine yet
+      std::cout << std::fixed << std::setprecision (3)
+                << m_scenario.name << "\tevents " << events << "\twall " << wall << " s"
+                << "\tevents/s " << std::setprecision (0) << events / wall
+                << "\t(no baseline, slowdown not checked; store one with --update-data)\n";
+      std::cout.unsetf (std::ios::floatfield);
+      return;
+    }
+  std::string comment;
+  std::getline (baseline, comment);
+  uint64_t baseEvents = 0;
+  double baseWall = 0;
+  baseline >> baseEvents >> baseWall;
+  NS_TEST_ASSERT_MSG_GT (baseWall, 0, "Malformed baseline " << baselinePath);
+
+  std::cout << std::fixed << std::setprecision (3)
+            << m_scenario.name << "\tevents " << events << " (baseline " << baseEvents << ")"
+            << "\twall " << wall << " s (baseline " << baseWall << " s)"
+            << "\tevents/s " << std::setprecision (0) << events / wall << " (baseline " << baseEvents / baseWall << ")\n";
+  std::cout.unsetf (std::ios::floatfield);
+
+  NS_TEST_EXPECT_MSG_LT (wall, baseWall * maxSlowdown,
+                         m_scenario.name << " took " << wall << " s, more than " << maxSlowdown << " x the baseline " << baseWall << " s");
+}
+
+void
+RegressionTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+  m_rng = 12345;
+
+  // The per-node @STATS lines are part of the workload but not of the result
+  dvhop::StatsWriter::Get ().Open ("/dev/null");
+
+  NodeContainer nodes;
+  Build (nodes);
+
+  Simulator::Stop (Seconds (m_scenario.time));
+  uint64_t eventsBefore = Simulator::GetEventCount ();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  Simulator::Run ();
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now () - start;
+  uint64_t events = Simulator::GetEventCount () - eventsBefore;
+
+  dvhop::StatsWriter::Get ().Close ();
+
+  std::string name = std::string ("regression-") + m_scenario.name;
+  WriteSnapshot (nodes, CreateTempDirFilename (name + ".golden"));
+  Simulator::Destroy ();
+
+  CheckSnapshot (CreateTempDirFilename (name + ".golden"), CreateDataDirFilename (name + ".golden"));
+  CheckBaseline (events, wall.count (), CreateTempDirFilename (name + ".baseline"), CreateDataDirFilename (name + ".baseline"));
+}
+
+// Fixed-seed reference scenarios, see the comment at the top of this file
+class DvhopRegressionTestSuite : public TestSuite
+{
+public:
+  DvhopRegressionTestSuite ();
+};
+
+DvhopRegressionTestSuite::DvhopRegressionTestSuite ()
+  : TestSuite ("dvhop-regression", PERFORMANCE)
+{
+  static const RegressionScenario small = { "grid100", 100, 12, 50, 10, 0 };
+  static const RegressionScenario smallDamaged = { "grid100-damage", 100, 12, 50, 10, 25 };
+  static const RegressionScenario large = { "grid1600", 1600, 48, 50, 10, 0 };
+  static const RegressionScenario largeDamaged = { "grid1600-damage", 1600, 48, 50, 10, 400 };
+  AddTestCase (new RegressionTestCase (small), TestCase::QUICK);
+  AddTestCase (new RegressionTestCase (smallDamaged), TestCase::QUICK);
+  AddTestCase (new RegressionTestCase (large), TestCase::EXTENSIVE);
+  AddTestCase (new RegressionTestCase (largeDamaged), TestCase::EXTENSIVE);
+}
+
+static DvhopRegressionTestSuite dvhopRegressionTestSuite;
@@ -2,10 +2,22 @@
 
 // Include a header file from your module to test.
 #include "ns3/dvhop.h"
+#include "ns3/dvhop-packet.h"
+#include "ns3/packet.h"
+#include "ns3/batch-localization.h"
+#include "ns3/localization-math.h"
+#include "ns3/timing-wheel-scheduler.h"
+#include "ns3/map-scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/simulator.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
 
+#include <vector>
+#include <map>
+#include <cmath>
+
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
@@ -46,6 +58,507 @@ DvhopTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Checks every batch localization kernel against RoutingProtocol::Trilaterate
+class BatchLocalizationTestCase : public TestCase
+{
+public:
+  BatchLocalizationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BatchLocalizationTestCase::BatchLocalizationTestCase ()
+  : TestCase ("Batch localization kernels match the scalar Trilaterate")
+{
+}
+
+void
+BatchLocalizationTestCase::DoRun (void)
+{
+  const size_t count = 1027; // Not a multiple of any vector width, so the tail is exercised
+  std::vector<double> in[9];
+  for (int a = 0; a < 9; a++)
+    {
+      in[a].resize (count);
+    }
+  uint32_t seed = 12345;
+  for (size_t k = 0; k < count; k++)
+    {
+      for (int a = 0; a < 9; a++)
+        {
+          seed = seed * 1103515245u + 12345u;
+          bool isHops = (a % 3 == 2);
+          in[a][k] = isHops ? (double) (1 + (seed >> 16) % 10) : (double) ((seed >> 8) % 50000) / 100.0;
+        }
+    }
+  // Coincident beacons 1 and 2, and three collinear beacons
+  in[3][0] = in[0][0];
+  in[4][0] = in[1][0];
+  in[6][1] = 2 * in[3][1] - in[0][1];
+  in[7][1] = 2 * in[4][1] - in[1][1];
+
+  dvhop::BeaconTriples triples = { &in[0][0], &in[1][0], &in[2][0],
+                                   &in[3][0], &in[4][0], &in[5][0],
+                                   &in[6][0], &in[7][0], &in[8][0], 0 };
+
+  dvhop::BatchKernel kernels[] = { dvhop::BATCH_KERNEL_SCALAR, dvhop::BATCH_KERNEL_AVX2, dvhop::BATCH_KERNEL_AVX512 };
+  for (size_t n = 0; n < sizeof (kernels) / sizeof (kernels[0]); n++)
+    {
+      if (!dvhop::BatchKernelSupported (kernels[n]))
+        {
+          continue;
+        }
+      std::vector<double> x (count), y (count);
+      std::vector<uint8_t> valid (count);
+      dvhop::BatchPositions out = { &x[0], &y[0], &valid[0] };
+      NS_TEST_ASSERT_MSG_EQ (dvhop::BatchLocalize (triples, count, out, kernels[n]), kernels[n], "Kernel was not used");
+
+      NS_TEST_ASSERT_MSG_EQ (valid[0], 0, "Coincident beacons not flagged");
+      NS_TEST_ASSERT_MSG_EQ (valid[1], 0, "Collinear beacons not flagged");
+      NS_TEST_ASSERT_MSG_EQ_TOL (x[0], (in[0][0] + in[3][0] + in[6][0]) / 3.0, 1e-9, "Degenerate node not placed at the centroid");
+
+      for (size_t k = 2; k < count; k++)
+        {
+          double avgHops = (in[2][k] + in[5][k] + in[8][k]) / 3.0;
+          double hopSize = dvhop::RoutingProtocol::AvgHopSize (in[0][k], in[1][k], in[3][k], in[4][k], in[6][k], in[7][k], avgHops);
+          std::pair<double, double> expected = dvhop::RoutingProtocol::Trilaterate (
+              in[0][k], in[1][k], in[2][k] * hopSize,
+              in[3][k], in[4][k], in[5][k] * hopSize,
+              in[6][k], in[7][k], in[8][k] * hopSize);
+          if (!valid[k])
+            {
+              continue;
+            }
+          double tolerance = 1e-9 * (1.0 + std::fabs (expected.first) + std::fabs (expected.second));
+          NS_TEST_ASSERT_MSG_EQ_TOL (x[k], expected.first, tolerance, "X differs from Trilaterate for node " << k);
+          NS_TEST_ASSERT_MSG_EQ_TOL (y[k], expected.second, tolerance, "Y differs from Trilaterate for node " << k);
+        }
+    }
+}
+
+// Checks that the compact DistanceTable behaves like the per-node map it replaced
+class DistanceTableTestCase : public TestCase
+{
+public:
+  DistanceTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DistanceTableTestCase::DistanceTableTestCase ()
+  : TestCase ("DistanceTable entries with local and shared beacon registries")
+{
+}
+
+void
+DistanceTableTestCase::DoRun (void)
+{
+  Ptr<dvhop::BeaconRegistry> shared = Create<dvhop::BeaconRegistry> ();
+  dvhop::DistanceTable local;
+  dvhop::DistanceTable first;
+  dvhop::DistanceTable second;
+  first.SetRegistry (shared);
+  second.SetRegistry (shared);
+
+  const char *beacons[] = { "10.0.0.50", "10.0.0.3", "10.0.0.20", "10.0.0.7" };
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      Ipv4Address beacon (beacons[i]);
+      local.AddBeacon (beacon, i + 1, 10.0 * i, 20.0 * i);
+      first.AddBeacon (beacon, i + 1, 10.0 * i, 20.0 * i);
+      second.AddBeacon (beacon, 1, -1.0, -1.0);
+    }
+
+  // Known beacons come back in address order, like the std::map they used to live in
+  std::vector<Ipv4Address> known = local.GetKnownBeacons ();
+  NS_TEST_ASSERT_MSG_EQ (known.size (), 4, "Wrong number of beacons");
+  NS_TEST_ASSERT_MSG_EQ (known[0], Ipv4Address ("10.0.0.3"), "Beacons out of order");
+  NS_TEST_ASSERT_MSG_EQ (known[1], Ipv4Address ("10.0.0.7"), "Beacons out of order");
+  NS_TEST_ASSERT_MSG_EQ (known[2], Ipv4Address ("10.0.0.20"), "Beacons out of order");
+  NS_TEST_ASSERT_MSG_EQ (known[3], Ipv4Address ("10.0.0.50"), "Beacons out of order");
+
+  NS_TEST_ASSERT_MSG_EQ (local.GetHopsTo (Ipv4Address ("10.0.0.20")), 3, "Wrong hop count");
+  NS_TEST_ASSERT_MSG_EQ (local.GetHopsTo (Ipv4Address ("10.0.0.4")), 0, "Unknown beacon has hops");
+  NS_TEST_ASSERT_MSG_EQ_TOL (local.GetBeaconPosition (Ipv4Address ("10.0.0.20")).second, 40.0, 1e-12, "Wrong position");
+
+  // Updating an entry keeps its position
+  local.AddBeacon (Ipv4Address ("10.0.0.20"), 1, 99.0, 99.0);
+  NS_TEST_ASSERT_MSG_EQ (local.GetHopsTo (Ipv4Address ("10.0.0.20")), 1, "Hop count not updated");
+  NS_TEST_ASSERT_MSG_EQ_TOL (local.GetBeaconPosition (Ipv4Address ("10.0.0.20")).first, 20.0, 1e-12, "Position changed");
+
+  // Tables sharing a registry store each beacon once but keep their own hops
+  NS_TEST_ASSERT_MSG_EQ (shared->GetSize (), 4, "Beacons registered more than once");
+  NS_TEST_ASSERT_MSG_EQ (second.GetHopsTo (Ipv4Address ("10.0.0.50")), 1, "Hops leaked between tables");
+  NS_TEST_ASSERT_MSG_EQ (first.GetHopsTo (Ipv4Address ("10.0.0.50")), 1, "Hops leaked between tables");
+  NS_TEST_ASSERT_MSG_EQ (first.GetHopsTo (Ipv4Address ("10.0.0.7")), 4, "Hops leaked between tables");
+  NS_TEST_ASSERT_MSG_EQ_TOL (second.GetBeaconPosition (Ipv4Address ("10.0.0.7")).first, 30.0, 1e-12, "Position not shared");
+}
+
+// Fills bounded tables past their capacity under each eviction policy
+class DistanceTableCapacityTestCase : public TestCase
+{
+public:
+  DistanceTableCapacityTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DistanceTableCapacityTestCase::DistanceTableCapacityTestCase ()
+  : TestCase ("Bounded DistanceTable eviction policies")
+{
+}
+
+void
+DistanceTableCapacityTestCase::DoRun (void)
+{
+  // Keeps the three nearest beacons, turning away ties
+  dvhop::DistanceTable nearest;
+  nearest.SetCapacity (3, dvhop::EVICT_HIGHEST_HOPS);
+  uint16_t hops[] = { 5, 2, 7, 3, 7, 1 };
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      nearest.AddBeacon (Ipv4Address (0x0a000010 + i), hops[i], i, i);
+    }
+  NS_TEST_ASSERT_MSG_EQ (nearest.GetSize (), 3, "Capacity exceeded");
+  NS_TEST_ASSERT_MSG_EQ (nearest.GetHopsTo (Ipv4Address ("10.0.0.17")), 2, "Nearest beacon dropped");
+  NS_TEST_ASSERT_MSG_EQ (nearest.GetHopsTo (Ipv4Address ("10.0.0.19")), 3, "Nearest beacon dropped");
+  NS_TEST_ASSERT_MSG_EQ (nearest.GetHopsTo (Ipv4Address ("10.0.0.21")), 1, "Nearest beacon dropped");
+  Ipv4Address evicted;
+  NS_TEST_ASSERT_MSG_EQ (nearest.AddBeacon (Ipv4Address ("10.0.0.30"), 3, 0, 0, &evicted), false, "Tie replaced a kept beacon");
+
+  // Keeps the beacons spread out: the one next to a new, nearer beacon goes
+  dvhop::DistanceTable spread;
+  spread.SetCapacity (3, dvhop::EVICT_GEOMETRIC);
+  spread.AddBeacon (Ipv4Address ("10.0.0.1"), 2, 0, 0);
+  spread.AddBeacon (Ipv4Address ("10.0.0.2"), 2, 100, 0);
+  spread.AddBeacon (Ipv4Address ("10.0.0.3"), 2, 0, 100);
+  NS_TEST_ASSERT_MSG_EQ (spread.AddBeacon (Ipv4Address ("10.0.0.4"), 1, 1, 1, &evicted), true, "Nearer beacon turned away");
+  NS_TEST_ASSERT_MSG_EQ (evicted, Ipv4Address ("10.0.0.1"), "Wrong beacon evicted");
+  NS_TEST_ASSERT_MSG_EQ (spread.AddBeacon (Ipv4Address ("10.0.0.5"), 3, 99, 1), false, "Farther clustered beacon accepted");
+
+  // A private registry forgets what the table drops
+  dvhop::DistanceTable oldest;
+  oldest.SetCapacity (4, dvhop::EVICT_OLDEST);
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      oldest.AddBeacon (Ipv4Address (0x0a000100 + i), 1, i, i);
+    }
+  NS_TEST_ASSERT_MSG_EQ (oldest.GetSize (), 4, "Capacity exceeded");
+  NS_TEST_ASSERT_MSG_EQ_TOL (oldest.GetBeaconPosition (Ipv4Address (0x0a000100 + 98)).first, 98.0, 1e-12, "Wrong position");
+}
+
+// Follows the neighbor a beacon was learnt from and its alternates as they fall silent
+class DistanceTableProvenanceTestCase : public TestCase
+{
+public:
+  DistanceTableProvenanceTestCase ();
+
+private:
+  virtual void DoRun (void);
+  static void AdvanceTo (Time t);
+};
+
+DistanceTableProvenanceTestCase::DistanceTableProvenanceTestCase ()
+  : TestCase ("DistanceTable providers, alternates and switching away from silent neighbors")
+{
+}
+
+void
+DistanceTableProvenanceTestCase::AdvanceTo (Time t)
+{
+  Simulator::Stop (t - Simulator::Now ());
+  Simulator::Run ();
+}
+
+void
+DistanceTableProvenanceTestCase::DoRun (void)
+{
+  Ipv4Address beacon ("10.0.0.1");
+  Ipv4Address first ("10.0.0.11");
+  Ipv4Address second ("10.0.0.12");
+  Ipv4Address third ("10.0.0.13");
+  Time timeout = MilliSeconds (600);
+
+  // Without provenance the neighbor is not kept
+  dvhop::DistanceTable plain;
+  plain.AddBeacon (beacon, 3, 0, 0, 0, first);
+  NS_TEST_ASSERT_MSG_EQ (plain.GetProvider (beacon), Ipv4Address::GetAny (), "Provider kept without provenance");
+
+  dvhop::DistanceTable table;
+  table.SetProvenance (true);
+  table.AddBeacon (beacon, 3, 0, 0, 0, first);
+  NS_TEST_ASSERT_MSG_EQ (table.GetProvider (beacon), first, "Provider not recorded");
+
+  // Other neighbors become alternates only when nearer than the entry ever was, and never refresh it
+  AdvanceTo (MilliSeconds (400));
+  NS_TEST_ASSERT_MSG_EQ (table.Refresh (beacon, 3, second), false, "Alternate changed the entry");
+  NS_TEST_ASSERT_MSG_EQ (table.Refresh (beacon, 4, third), false, "Alternate changed the entry");
+  NS_TEST_ASSERT_MSG_EQ (table.LastUpdatedAt (beacon), Seconds (0), "Alternate refreshed the entry");
+  NS_TEST_ASSERT_MSG_EQ (table.SwitchSilentProviders (timeout), 0u, "Switched away from a live provider");
+
+  // The silent provider is replaced by the feasible alternate, the farther neighbor is not used
+  AdvanceTo (MilliSeconds (700));
+  table.Refresh (beacon, 4, third);
+  std::vector<Ipv4Address> switched;
+  NS_TEST_ASSERT_MSG_EQ (table.SwitchSilentProviders (timeout, &switched), 1u, "Silent provider kept");
+  NS_TEST_ASSERT_MSG_EQ (switched.size (), 1, "Wrong switched beacons");
+  NS_TEST_ASSERT_MSG_EQ (table.GetProvider (beacon), second, "Wrong alternate chosen");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (beacon), 3, "Wrong hops after the switch");
+  NS_TEST_ASSERT_MSG_EQ (table.LastUpdatedAt (beacon), MilliSeconds (400), "Switch did not take the alternate's time");
+
+  // A longer path from the provider is followed, but refreshes the entry only once heard again
+  NS_TEST_ASSERT_MSG_EQ (table.Refresh (beacon, 5, second), true, "Longer path of the provider ignored");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (beacon), 5, "Longer path of the provider ignored");
+  NS_TEST_ASSERT_MSG_EQ (table.LastUpdatedAt (beacon), MilliSeconds (400), "Longer path refreshed the entry");
+  AdvanceTo (MilliSeconds (800));
+  NS_TEST_ASSERT_MSG_EQ (table.Refresh (beacon, 5, second), false, "Unchanged path changed the entry");
+  NS_TEST_ASSERT_MSG_EQ (table.LastUpdatedAt (beacon), MilliSeconds (800), "Provider did not refresh the entry");
+
+  // A shorter path from anyone takes over
+  table.AddBeacon (beacon, 2, 0, 0, 0, third);
+  NS_TEST_ASSERT_MSG_EQ (table.GetProvider (beacon), third, "Shorter path did not take over");
+
+  // Entries added without a provider adopt the first neighbor with the same hops
+  Ipv4Address other ("10.0.0.2");
+  table.AddBeacon (other, 2, 50, 50);
+  NS_TEST_ASSERT_MSG_EQ (table.GetProvider (other), Ipv4Address::GetAny (), "Provider invented");
+  table.Refresh (other, 3, first);
+  NS_TEST_ASSERT_MSG_EQ (table.GetProvider (other), Ipv4Address::GetAny (), "Farther neighbor adopted");
+  table.Refresh (other, 2, first);
+  NS_TEST_ASSERT_MSG_EQ (table.GetProvider (other), first, "Provider not adopted");
+
+  Simulator::Destroy ();
+}
+
+// Round-trips the typed DV-Hop messages through a packet
+class MessageHeaderTestCase : public TestCase
+{
+public:
+  MessageHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MessageHeaderTestCase::MessageHeaderTestCase ()
+  : TestCase ("HELLO, compact HELLO and position serialization")
+{
+}
+
+void
+MessageHeaderTestCase::DoRun (void)
+{
+  Ptr<Packet> hello = Create<Packet> ();
+  hello->AddHeader (dvhop::FloodingHeader (12.5, -3.25, 7, 2, Ipv4Address ("10.0.0.9")));
+  hello->AddHeader (dvhop::TypeHeader (dvhop::DVHOP_HELLO));
+  NS_TEST_ASSERT_MSG_EQ (hello->GetSize (), 25, "HELLOs are one type byte and a 24 byte FloodingHeader");
+
+  dvhop::TypeHeader type;
+  hello->RemoveHeader (type);
+  NS_TEST_ASSERT_MSG_EQ (type.IsValid (), true, "HELLO type not recognized");
+  NS_TEST_ASSERT_MSG_EQ (type.Get (), dvhop::DVHOP_HELLO, "Wrong message type");
+  dvhop::FloodingHeader flooding;
+  hello->RemoveHeader (flooding);
+  NS_TEST_ASSERT_MSG_EQ (flooding.GetBeaconAddress (), Ipv4Address ("10.0.0.9"), "Wrong beacon");
+  NS_TEST_ASSERT_MSG_EQ (flooding.GetHopCount (), 2, "Wrong hop count");
+  NS_TEST_ASSERT_MSG_EQ (flooding.HasHopSize (), false, "Hop size correction without one being set");
+
+  dvhop::FloodingHeader corrected (12.5, -3.25, 7, 2, Ipv4Address ("10.0.0.9"));
+  corrected.SetHopSize (47.5);
+  Ptr<Packet> correctedHello = Create<Packet> ();
+  correctedHello->AddHeader (corrected);
+  NS_TEST_ASSERT_MSG_EQ (correctedHello->GetSize (), 32, "A hop size correction adds 8 bytes");
+  correctedHello->RemoveHeader (flooding);
+  NS_TEST_ASSERT_MSG_EQ (flooding.GetHopCount (), 2, "Correction flag leaked into the hop count");
+  NS_TEST_ASSERT_MSG_EQ (flooding.HasHopSize (), true, "Hop size correction lost");
+  NS_TEST_ASSERT_MSG_EQ_TOL (flooding.GetHopSize (), 47.5, 1e-12, "Wrong hop size correction");
+
+  Ptr<Packet> compact = Create<Packet> ();
+  compact->AddHeader (dvhop::CompactHelloHeader (Ipv4Address ("10.0.0.9"), 513, 4, 2));
+  compact->AddHeader (dvhop::TypeHeader (dvhop::DVHOP_COMPACT_HELLO));
+  NS_TEST_ASSERT_MSG_EQ (compact->GetSize (), 11, "Compact HELLOs are 11 bytes");
+  compact->RemoveHeader (type);
+  NS_TEST_ASSERT_MSG_EQ (type.Get (), dvhop::DVHOP_COMPACT_HELLO, "Wrong message type");
+  dvhop::CompactHelloHeader compactHeader;
+  compact->RemoveHeader (compactHeader);
+  NS_TEST_ASSERT_MSG_EQ (compactHeader.GetBeaconAddress (), Ipv4Address ("10.0.0.9"), "Wrong beacon");
+  NS_TEST_ASSERT_MSG_EQ (compactHeader.GetSequenceNumber (), 513, "Wrong sequence number");
+  NS_TEST_ASSERT_MSG_EQ (compactHeader.GetHopCount (), 4, "Wrong hop count");
+  NS_TEST_ASSERT_MSG_EQ (compactHeader.GetVersion (), 2, "Wrong position version");
+
+  Ptr<Packet> position = Create<Packet> ();
+  position->AddHeader (dvhop::PositionHeader (Ipv4Address ("10.0.0.9"), 2, 12.5, -3.25));
+  NS_TEST_ASSERT_MSG_EQ (position->GetSize (), 22, "Wrong position size");
+  dvhop::PositionHeader positionHeader;
+  position->RemoveHeader (positionHeader);
+  NS_TEST_ASSERT_MSG_EQ (positionHeader.GetVersion (), 2, "Wrong position version");
+  NS_TEST_ASSERT_MSG_EQ_TOL (positionHeader.GetXPosition (), 12.5, 1e-12, "Wrong X");
+  NS_TEST_ASSERT_MSG_EQ_TOL (positionHeader.GetYPosition (), -3.25, 1e-12, "Wrong Y");
+
+  uint8_t byte = 42;
+  Ptr<Packet> bogus = Create<Packet> (&byte, 1);
+  bogus->RemoveHeader (type);
+  NS_TEST_ASSERT_MSG_EQ (type.IsValid (), false, "Unknown type accepted");
+}
+
+// Feeds the same random inserts and removals to TimingWheelScheduler and MapScheduler
+class TimingWheelSchedulerTestCase : public TestCase
+{
+public:
+  TimingWheelSchedulerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+namespace {
+  class NoopEvent : public EventImpl
+  {
+  protected:
+    virtual void Notify (void) {}
+  };
+}
+
+TimingWheelSchedulerTestCase::TimingWheelSchedulerTestCase ()
+  : TestCase ("TimingWheelScheduler returns events in MapScheduler order")
+{
+}
+
+void
+TimingWheelSchedulerTestCase::DoRun (void)
+{
+  Ptr<Scheduler> wheel = CreateObject<TimingWheelScheduler> ();
+  Ptr<Scheduler> map = CreateObject<MapScheduler> ();
+  Ptr<EventImpl> impl = Create<NoopEvent> ();
+  std::map<uint32_t, Scheduler::Event> live;
+
+  uint64_t rng = 12345;
+  uint64_t now = 0;
+  uint32_t uid = 0;
+  for (uint32_t i = 0; i < 200000; i++)
+    {
+      rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+      uint32_t r = rng >> 33;
+      if (r % 10 < 5 || live.empty ())
+        {
+          // Receptions a few us ahead, jittered sends up to 10 ms, HELLO timers and far future events
+          static const uint64_t horizons[] = { 50000, 10000000, 500000000, 1ULL << 45 };
+          Scheduler::Event ev;
+          ev.impl = PeekPointer (impl);
+          ev.key.m_ts = now + (rng >> 7) % horizons[(r / 10) % 4];
+          ev.key.m_uid = uid++;
+          ev.key.m_context = 0;
+          wheel->Insert (ev);
+          map->Insert (ev);
+          live[ev.key.m_uid] = ev;
+        }
+      else if (r % 10 < 9)
+        {
+          Scheduler::Event expected = map->RemoveNext ();
+          NS_TEST_ASSERT_MSG_EQ (wheel->PeekNext ().key.m_uid, expected.key.m_uid, "PeekNext out of order");
+          Scheduler::Event ev = wheel->RemoveNext ();
+          NS_TEST_ASSERT_MSG_EQ (ev.key.m_uid, expected.key.m_uid, "RemoveNext out of order");
+          live.erase (ev.key.m_uid);
+          now = ev.key.m_ts;
+        }
+      else
+        {
+          // Cancel a random event that is still scheduled
+          std::map<uint32_t, Scheduler::Event>::iterator it = live.lower_bound ((rng >> 11) % uid);
+          if (it == live.end ())
+            {
+              it = live.begin ();
+            }
+          wheel->Remove (it->second);
+          map->Remove (it->second);
+          live.erase (it);
+        }
+    }
+  while (!map->IsEmpty ())
+    {
+      NS_TEST_ASSERT_MSG_EQ (wheel->RemoveNext ().key.m_uid, map->RemoveNext ().key.m_uid, "Drain out of order");
+    }
+  NS_TEST_ASSERT_MSG_EQ (wheel->IsEmpty (), true, "Events left in the wheel");
+}
+
+// Runs the localization templates in float and Q16.16 against the double reference
+class LocalizationMathTestCase : public TestCase
+{
+public:
+  LocalizationMathTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LocalizationMathTestCase::LocalizationMathTestCase ()
+  : TestCase ("Localization math in float and Q16.16 stays close to double")
+{
+}
+
+void
+LocalizationMathTestCase::DoRun (void)
+{
+  using dvhop::Q16_16;
+  typedef dvhop::NumericTraits<Q16_16> Fixed;
+
+  NS_TEST_ASSERT_MSG_EQ_TOL (Fixed::Sqrt (Q16_16::FromDouble (2.0)).ToDouble (), std::sqrt (2.0), 1e-4, "Q16.16 square root");
+  NS_TEST_ASSERT_MSG_EQ (Fixed::Sqrt (Q16_16::FromDouble (100.0)).ToDouble (), 10.0, "Q16.16 square root of a square");
+  NS_TEST_ASSERT_MSG_EQ ((Q16_16::FromDouble (300.0) * Q16_16::FromDouble (300.0)).GetRaw (), INT32_MAX, "Q16.16 products saturate");
+  NS_TEST_ASSERT_MSG_EQ ((Q16_16::FromDouble (-1.0) / Q16_16 ()).GetRaw (), INT32_MIN, "Q16.16 division by zero saturates");
+
+  // The double template is the reference implementation itself
+  std::pair<double, double> reference = dvhop::RoutingProtocol::Trilaterate (50, 50, 210, 550, 100, 330, 100, 450, 270);
+  std::pair<double, double> templated = dvhop::Trilaterate<double> (50, 50, 210, 550, 100, 330, 100, 450, 270);
+  NS_TEST_ASSERT_MSG_EQ (templated.first, reference.first, "Trilaterate<double> differs from RoutingProtocol::Trilaterate");
+  NS_TEST_ASSERT_MSG_EQ (templated.second, reference.second, "Trilaterate<double> differs from RoutingProtocol::Trilaterate");
+
+  // A 500 m and a 5 km deployment, both far outside the Q16.16 range once squared
+  const double x[2][3] = { { 50, 550, 100 }, { 100, 4900, 2500 } };
+  const double y[2][3] = { { 50, 100, 450 }, { 150, 300, 4800 } };
+  const double hops[2][3] = { { 4, 6, 5 }, { 40, 70, 55 } };
+  for (int c = 0; c < 2; c++)
+    {
+      std::pair<double, double> exact = dvhop::LocalizeAs<double> (x[c], y[c], hops[c]);
+      std::pair<double, double> single = dvhop::LocalizeAs<float> (x[c], y[c], hops[c]);
+      std::pair<double, double> fixed = dvhop::LocalizeAs<Q16_16> (x[c], y[c], hops[c]);
+      NS_TEST_ASSERT_MSG_EQ_TOL (single.first, exact.first, 0.01, "float X, case " << c);
+      NS_TEST_ASSERT_MSG_EQ_TOL (single.second, exact.second, 0.01, "float Y, case " << c);
+      NS_TEST_ASSERT_MSG_EQ_TOL (fixed.first, exact.first, 0.5, "Q16.16 X, case " << c);
+      NS_TEST_ASSERT_MSG_EQ_TOL (fixed.second, exact.second, 0.5, "Q16.16 Y, case " << c);
+
+      // A given hop size, as flooded by the beacons, replaces AvgHopSize
+      double hopSize = 1.1 * dvhop::AvgHopSize<double> (x[c][0], y[c][0], x[c][1], y[c][1], x[c][2], y[c][2],
+                                                         (hops[c][0] + hops[c][1] + hops[c][2]) / 3.0);
+      std::pair<double, double> given = dvhop::Trilaterate<double> (x[c][0], y[c][0], hops[c][0] * hopSize,
+                                                                    x[c][1], y[c][1], hops[c][1] * hopSize,
+                                                                    x[c][2], y[c][2], hops[c][2] * hopSize);
+      std::pair<double, double> corrected = dvhop::LocalizeAs<double> (x[c], y[c], hops[c], hopSize);
+      fixed = dvhop::LocalizeAs<Q16_16> (x[c], y[c], hops[c], hopSize);
+      NS_TEST_ASSERT_MSG_EQ (corrected.first, given.first, "Given hop size not used, case " << c);
+      NS_TEST_ASSERT_MSG_EQ (corrected.second, given.second, "Given hop size not used, case " << c);
+      NS_TEST_ASSERT_MSG_EQ_TOL (fixed.first, given.first, 0.5, "Q16.16 X with a given hop size, case " << c);
+      NS_TEST_ASSERT_MSG_EQ_TOL (fixed.second, given.second, 0.5, "Q16.16 Y with a given hop size, case " << c);
+    }
+
+  // Collinear and coincident beacons have no position, whatever the arithmetic
+  const double flatX[2][3] = { { 0, 100, 200 }, { 300, 300, 300 } };
+  const double flatY[2][3] = { { 0, 0, 0 }, { 400, 400, 400 } };
+  const double flatHops[3] = { 1, 2, 3 };
+  for (int c = 0; c < 2; c++)
+    {
+      for (int type = dvhop::NUMERIC_DOUBLE; type <= dvhop::NUMERIC_Q16_16; type++)
+        {
+          std::pair<double, double> p = dvhop::LocalizeAs ((dvhop::NumericType) type, flatX[c], flatY[c], flatHops);
+          NS_TEST_ASSERT_MSG_EQ (std::isnan (p.first) && std::isnan (p.second), true,
+                                 "Degenerate beacons localized, case " << c << ", numeric type " << type);
+        }
+    }
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +574,13 @@ DvhopTestSuite::DvhopTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new DvhopTestCase1, TestCase::QUICK);
+  AddTestCase (new BatchLocalizationTestCase, TestCase::QUICK);
+  AddTestCase (new DistanceTableTestCase, TestCase::QUICK);
+  AddTestCase (new DistanceTableCapacityTestCase, TestCase::QUICK);
+  AddTestCase (new DistanceTableProvenanceTestCase, TestCase::QUICK);
+  AddTestCase (new MessageHeaderTestCase, TestCase::QUICK);
+  AddTestCase (new TimingWheelSchedulerTestCase, TestCase::QUICK);
+  AddTestCase (new LocalizationMathTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
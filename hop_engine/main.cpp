@@ -0,0 +1,639 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include "batch-localization.h"
+
+using namespace std;
+using namespace ns3::dvhop;
+
+static const uint16_t UNREACHABLE = 0xffff;
+
+// Node positions, radio links (CSR adjacency) and which nodes are beacons
+struct Graph {
+    vector<double> x;
+    vector<double> y;
+    vector<uint32_t> offset;
+    vector<uint32_t> adj;
+    vector<uint32_t> beacons;       // node ids, ascending like the beacons' addresses
+    vector<int32_t> beacon_index;   // node id -> index in beacons, -1 for other nodes
+
+    uint32_t size() const { return (uint32_t) x.size(); }
+};
+
+// Links every pair of nodes closer than range, bucketing nodes in range-sized cells
+void connect(Graph& g, double range) {
+    map<pair<int64_t, int64_t>, vector<uint32_t>> cells;
+    auto cell = [&](uint32_t v) { return make_pair((int64_t) floor(g.x[v] / range), (int64_t) floor(g.y[v] / range)); };
+    for(uint32_t v = 0; v < g.size(); v++) { cells[cell(v)].push_back(v); }
+
+    g.offset.assign(1, 0);
+    g.adj.clear();
+    for(uint32_t v = 0; v < g.size(); v++) {
+        pair<int64_t, int64_t> c = cell(v);
+        for(int64_t dx = -1; dx <= 1; dx++) {
+            for(int64_t dy = -1; dy <= 1; dy++) {
+                auto it = cells.find(make_pair(c.first + dx, c.second + dy));
+                if(it == cells.end()) { continue; }
+                for(uint32_t w : it->second) {
+                    if(w != v && hypot(g.x[v] - g.x[w], g.y[v] - g.y[w]) <= range) { g.adj.push_back(w); }
+                }
+            }
+        }
+        g.offset.push_back((uint32_t) g.adj.size());
+    }
+
+    g.beacon_index.assign(g.size(), -1);
+    sort(g.beacons.begin(), g.beacons.end());
+    for(size_t k = 0; k < g.beacons.size(); k++) { g.beacon_index[g.beacons[k]] = (int32_t) k; }
+}
+
+// What one query did
+struct QueryStats {
+    size_t changed_hops = 0;    // (node, beacon) hop counts that changed
+    size_t relocalized = 0;     // nodes whose position was recomputed
+};
+
+/**
+ * Hop counts from every beacon to every node, kept up to date as nodes fail
+ * and come back instead of re-running a BFS per beacon after each change.
+ *
+ * Removal: the nodes whose shortest path tree parent was lost are found level
+ * by level (a node keeps its hop count if any live neighbor one hop closer
+ * still does), then only that subtree is re-settled from its boundary.
+ * Addition: hop counts can only decrease, so a BFS relaxes outward from the
+ * added nodes and stops where nothing improves.
+ *
+ * Only the nodes whose hop counts changed are localized again, the way the
+ * simulation does it (3 nearest beacons, BatchLocalize).
+ */
+class HopEngine {
+public:
+    explicit HopEngine(const Graph& graph)
+        : g(graph), n(graph.size()), b((uint32_t) graph.beacons.size()),
+          alive(n, 1), alive_count(n), dist((size_t) n * b, UNREACHABLE),
+          est_x(n, 0), est_y(n, 0), error(n, NAN),
+          error_sum(0), localized(0), journal_full(false),
+          mark(n, 0), epoch(0), touched_mark(n, 0), touched_epoch(0), bucket_top(0) {
+        for(uint32_t k = 0; k < b; k++) { bfs(k, &dist[(size_t) k * n]); }
+        vector<uint32_t> all(n);
+        for(uint32_t v = 0; v < n; v++) { all[v] = v; }
+        relocalize(all);
+        clearJournal();
+    }
+
+    // Back to the state of base (same graph): only what changed since the last reset is copied back
+    void reset(const HopEngine& base) {
+        if(journal_full) {
+            alive = base.alive;
+            dist = base.dist;
+            est_x = base.est_x;
+            est_y = base.est_y;
+            error = base.error;
+        } else {
+            for(size_t i : dist_journal) { dist[i] = base.dist[i]; }
+            for(uint32_t v : node_journal) {
+                alive[v] = base.alive[v];
+                est_x[v] = base.est_x[v];
+                est_y[v] = base.est_y[v];
+                error[v] = base.error[v];
+            }
+        }
+        alive_count = base.alive_count;
+        error_sum = base.error_sum;
+        localized = base.localized;
+        clearJournal();
+    }
+
+    QueryStats fail(const vector<uint32_t>& nodes) {
+        QueryStats stats;
+        beginTouched();
+        vector<uint32_t> removed;
+        for(uint32_t v : nodes) {
+            if(alive[v]) {
+                alive[v] = 0;
+                alive_count--;
+                journalNode(v);
+                removed.push_back(v);
+                touch(v);
+            }
+        }
+        if(removed.empty()) { return stats; }
+        for(uint32_t k = 0; k < b; k++) { stats.changed_hops += repairAfterRemoval(k, removed); }
+        stats.relocalized = relocalize(touched);
+        return stats;
+    }
+
+    QueryStats add(const vector<uint32_t>& nodes) {
+        QueryStats stats;
+        beginTouched();
+        vector<uint32_t> added;
+        for(uint32_t v : nodes) {
+            if(!alive[v]) {
+                alive[v] = 1;
+                alive_count++;
+                journalNode(v);
+                added.push_back(v);
+                touch(v);
+            }
+        }
+        if(added.empty()) { return stats; }
+        for(uint32_t k = 0; k < b; k++) { stats.changed_hops += relaxAfterAddition(k, added); }
+        stats.relocalized = relocalize(touched);
+        return stats;
+    }
+
+    // Compares every hop count with a BFS from scratch, returns the number of mismatches
+    size_t check() {
+        vector<uint16_t> fresh(n);
+        size_t mismatches = 0;
+        for(uint32_t k = 0; k < b; k++) {
+            bfs(k, fresh.data());
+            for(uint32_t v = 0; v < n; v++) { mismatches += fresh[v] != dist[(size_t) k * n + v]; }
+        }
+        return mismatches;
+    }
+
+    size_t aliveCount() const { return alive_count; }
+    size_t localizedCount() const { return localized; }
+    double meanError() const { return localized ? error_sum / localized : 0; }
+
+private:
+    void bfs(uint32_t k, uint16_t* d) {
+        fill(d, d + n, UNREACHABLE);
+        uint32_t source = g.beacons[k];
+        if(!alive[source]) { return; }
+        vector<uint32_t> queue(1, source);
+        d[source] = 0;
+        for(size_t head = 0; head < queue.size(); head++) {
+            uint32_t u = queue[head];
+            for(uint32_t e = g.offset[u]; e < g.offset[u + 1]; e++) {
+                uint32_t w = g.adj[e];
+                if(alive[w] && d[w] == UNREACHABLE) {
+                    d[w] = (uint16_t) (d[u] + 1);
+                    queue.push_back(w);
+                }
+            }
+        }
+    }
+
+    void clearJournal() {
+        dist_journal.clear();
+        node_journal.clear();
+        journal_full = false;
+    }
+
+    // Past n entries a full copy is cheaper than replaying the journal
+    void journalHops(size_t index) {
+        if(journal_full) { return; }
+        dist_journal.push_back(index);
+        journal_full = dist_journal.size() > n;
+    }
+
+    void journalNode(uint32_t v) {
+        if(journal_full) { return; }
+        node_journal.push_back(v);
+        journal_full = node_journal.size() > n;
+    }
+
+    void beginTouched() {
+        touched.clear();
+        touched_epoch++;
+    }
+
+    void touch(uint32_t v) {
+        if(touched_mark[v] != touched_epoch) {
+            touched_mark[v] = touched_epoch;
+            touched.push_back(v);
+        }
+    }
+
+    void bucketPush(uint16_t level, uint32_t v) {
+        if(level >= buckets.size()) { buckets.resize(level + 1); }
+        buckets[level].push_back(v);
+        bucket_top = max(bucket_top, level);
+    }
+
+    size_t repairAfterRemoval(uint32_t k, const vector<uint32_t>& removed) {
+        uint16_t* d = &dist[(size_t) k * n];
+        size_t changed = 0;
+
+        // Losing the beacon loses the whole column
+        if(!alive[g.beacons[k]]) {
+            for(uint32_t v = 0; v < n; v++) {
+                if(d[v] != UNREACHABLE) {
+                    d[v] = UNREACHABLE;
+                    journalHops((size_t) k * n + v);
+                    touch(v);
+                    changed++;
+                }
+            }
+            return changed;
+        }
+
+        // Find the affected subtree, in increasing hop order so that the support
+        // of a node (its live, unaffected neighbors one hop closer) is final when it is checked
+        epoch++;
+        affected.clear();
+        old_hops.clear();
+        uint16_t low = UNREACHABLE;
+        for(uint32_t r : removed) {
+            if(d[r] == UNREACHABLE) { continue; }
+            mark[r] = epoch;
+            old_hops.push_back(d[r]);
+            affected.push_back(r);
+            low = min(low, (uint16_t) (d[r] + 1));
+            for(uint32_t e = g.offset[r]; e < g.offset[r + 1]; e++) {
+                uint32_t w = g.adj[e];
+                if(alive[w] && d[w] == d[r] + 1) { bucketPush(d[w], w); }
+            }
+        }
+        for(size_t level = low; level <= bucket_top; level++) {
+            for(size_t i = 0; i < buckets[level].size(); i++) {
+                uint32_t u = buckets[level][i];
+                if(mark[u] == epoch) { continue; }
+                bool supported = false;
+                for(uint32_t e = g.offset[u]; e < g.offset[u + 1] && !supported; e++) {
+                    uint32_t w = g.adj[e];
+                    supported = alive[w] && mark[w] != epoch && d[w] + 1 == d[u];
+                }
+                if(supported) { continue; }
+                mark[u] = epoch;
+                old_hops.push_back(d[u]);
+                affected.push_back(u);
+                for(uint32_t e = g.offset[u]; e < g.offset[u + 1]; e++) {
+                    uint32_t w = g.adj[e];
+                    if(alive[w] && d[w] == d[u] + 1) { bucketPush(d[w], w); }
+                }
+            }
+            buckets[level].clear();
+        }
+        bucket_top = 0;
+
+        // Re-settle the subtree from its boundary (Dial's algorithm, unit weights)
+        for(uint32_t u : affected) { d[u] = UNREACHABLE; }
+        uint16_t first = UNREACHABLE;
+        for(uint32_t u : affected) {
+            if(!alive[u]) { continue; }
+            for(uint32_t e = g.offset[u]; e < g.offset[u + 1]; e++) {
+                uint32_t w = g.adj[e];
+                if(alive[w] && mark[w] != epoch && d[w] != UNREACHABLE && d[w] + 1 < d[u]) { d[u] = (uint16_t) (d[w] + 1); }
+            }
+            if(d[u] != UNREACHABLE) {
+                bucketPush(d[u], u);
+                first = min(first, d[u]);
+            }
+        }
+        settle(d, first, true);
+
+        for(size_t i = 0; i < affected.size(); i++) {
+            if(d[affected[i]] != old_hops[i]) {
+                journalHops((size_t) k * n + affected[i]);
+                touch(affected[i]);
+                changed++;
+            }
+        }
+        return changed;
+    }
+
+    size_t relaxAfterAddition(uint32_t k, const vector<uint32_t>& added) {
+        uint16_t* d = &dist[(size_t) k * n];
+        size_t changed = 0;
+        uint16_t first = UNREACHABLE;
+        epoch++;
+        affected.clear();
+        for(uint32_t a : added) {
+            uint16_t best = UNREACHABLE;
+            if(g.beacons[k] == a) {
+                best = 0;
+            } else {
+                for(uint32_t e = g.offset[a]; e < g.offset[a + 1]; e++) {
+                    uint32_t w = g.adj[e];
+                    if(alive[w] && d[w] != UNREACHABLE && d[w] + 1 < best) { best = (uint16_t) (d[w] + 1); }
+                }
+            }
+            if(best < d[a]) {
+                d[a] = best;
+                bucketPush(best, a);
+                first = min(first, best);
+            }
+        }
+        settle(d, first, false);
+        for(uint32_t u : affected) {
+            journalHops((size_t) k * n + u);
+            touch(u);
+            changed++;
+        }
+        return changed;
+    }
+
+    // Propagates the hop counts queued in buckets; when only_marked is set relaxation
+    // stays inside the current epoch's affected set, otherwise improved nodes are recorded in it
+    void settle(uint16_t* d, uint16_t first, bool only_marked) {
+        for(size_t level = first; level <= bucket_top; level++) {
+            for(size_t i = 0; i < buckets[level].size(); i++) {
+                uint32_t u = buckets[level][i];
+                if(d[u] != level) { continue; }
+                if(!only_marked && mark[u] != epoch) {
+                    mark[u] = epoch;
+                    affected.push_back(u);
+                }
+                for(uint32_t e = g.offset[u]; e < g.offset[u + 1]; e++) {
+                    uint32_t w = g.adj[e];
+                    if(!alive[w] || (only_marked && mark[w] != epoch) || d[w] <= level + 1) { continue; }
+                    d[w] = (uint16_t) (level + 1);
+                    bucketPush(d[w], w);
+                }
+            }
+            buckets[level].clear();
+        }
+        bucket_top = 0;
+    }
+
+    // Localizes the given nodes again and updates the error totals
+    size_t relocalize(const vector<uint32_t>& nodes) {
+        for(vector<double>& column : soa) { column.clear(); }
+        slots.clear();
+        for(uint32_t v : nodes) {
+            journalNode(v);
+            if(!isnan(error[v])) {
+                error_sum -= error[v];
+                localized--;
+                error[v] = NAN;
+            }
+            if(!alive[v] || g.beacon_index[v] >= 0) { continue; }
+
+            // The three lowest-hop beacons, ties broken like RoutingProtocol::RecvDvhop (higher address first)
+            uint32_t chosen[3];
+            uint16_t chosen_hops[3];
+            uint32_t found = 0;
+            for(uint32_t k = 0; k < b; k++) {
+                uint16_t h = dist[(size_t) k * n + v];
+                if(h == UNREACHABLE) { continue; }
+                uint32_t at = 0;
+                while(at < found && chosen_hops[at] < h) { at++; }
+                if(at == 3) { continue; }
+                for(uint32_t c = min(found, 2u); c > at; c--) {
+                    chosen[c] = chosen[c - 1];
+                    chosen_hops[c] = chosen_hops[c - 1];
+                }
+                chosen[at] = k;
+                chosen_hops[at] = h;
+                found = min(found + 1, 3u);
+            }
+            if(found < 3) { continue; }
+            for(int c = 0; c < 3; c++) {
+                uint32_t beacon = g.beacons[chosen[c]];
+                soa[c * 3].push_back(g.x[beacon]);
+                soa[c * 3 + 1].push_back(g.y[beacon]);
+                soa[c * 3 + 2].push_back(dist[(size_t) chosen[c] * n + v]);
+            }
+            slots.push_back(v);
+        }
+        if(slots.empty()) { return 0; }
+
+        BeaconTriples in = { soa[0].data(), soa[1].data(), soa[2].data(), soa[3].data(), soa[4].data(),
+                             soa[5].data(), soa[6].data(), soa[7].data(), soa[8].data(), nullptr };
+        vector<double> x(slots.size()), y(slots.size());
+        vector<uint8_t> valid(slots.size());
+        BatchPositions pos = { x.data(), y.data(), valid.data() };
+        BatchLocalize(in, slots.size(), pos);
+        for(size_t i = 0; i < slots.size(); i++) {
+            uint32_t v = slots[i];
+            // Degenerate geometry gets the centroid fallback here but NaN in the simulation
+            if(!valid[i]) { x[i] = y[i] = NAN; }
+            est_x[v] = x[i];
+            est_y[v] = y[i];
+            if(!isfinite(x[i]) || !isfinite(y[i])) { continue; }
+            error[v] = hypot(x[i] - g.x[v], y[i] - g.y[v]);
+            error_sum += error[v];
+            localized++;
+        }
+        return slots.size();
+    }
+
+    const Graph& g;
+    uint32_t n;
+    uint32_t b;
+
+    vector<uint8_t> alive;
+    size_t alive_count;
+    vector<uint16_t> dist;          // beacon-major: dist[k * n + v]
+    vector<double> est_x;
+    vector<double> est_y;
+    vector<double> error;           // NaN when the node is not localized
+    double error_sum;
+    size_t localized;
+
+    // Entries changed since the last reset
+    vector<size_t> dist_journal;
+    vector<uint32_t> node_journal;
+    bool journal_full;
+
+    // Scratch space
+    vector<uint32_t> mark;
+    uint32_t epoch;
+    vector<uint32_t> touched_mark;
+    uint32_t touched_epoch;
+    vector<uint32_t> touched;
+    vector<uint32_t> affected;
+    vector<uint16_t> old_hops;
+    vector<vector<uint32_t>> buckets;
+    uint16_t bucket_top;            // highest non-empty bucket
+    vector<double> soa[9];
+    vector<uint32_t> slots;
+};
+
+//------------------------------------------------------------------------------
+
+struct Query {
+    size_t line;
+    string op;
+    vector<uint32_t> nodes;
+};
+
+// Queries from one "reset" to the next, replayed from the initial state
+struct Sequence {
+    vector<Query> queries;
+    vector<string> output;
+    size_t mismatches = 0;
+};
+
+void usage() {
+    cerr << "usage: hop_engine [options] [queries]\n";
+    cerr << "  queries: one per line, read from stdin when no file is given\n";
+    cerr << "    fail n [n ...]   disable nodes (node ids as in dvhop.positions)\n";
+    cerr << "    add n [n ...]    bring nodes back\n";
+    cerr << "    reset            start a new damage sequence from the undamaged network\n";
+    cerr << "  -t file      positions, one \"node x y [isBeacon]\" per line (as written by the example)\n";
+    cerr << "  -n nodes     grid size when no positions are given (default 100)\n";
+    cerr << "  -w n         grid width in nodes (default sqrt(nodes))\n";
+    cerr << "  -s m         grid step in meters (default 50)\n";
+    cerr << "  -b beacons   beacons when none are marked, every nodes/beacons-th node (default 12)\n";
+    cerr << "  -r m         radio range in meters (default 110)\n";
+    cerr << "  --check      compare every hop count with a full recomputation after each query\n";
+    cerr << "  -j n         worker threads, one damage sequence at a time each (default: all cores)\n";
+}
+
+int main(int argc, char** argv) {
+    string positions_file;
+    string query_file;
+    uint32_t size = 100;
+    uint32_t width = 0;
+    double step = 50;
+    uint32_t beacons = 12;
+    double range = 110;
+    bool check = false;
+    unsigned threads = 0;
+    for(int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool has_value = i + 1 < argc;
+        if(arg == "-t" && has_value) { positions_file = argv[++i]; }
+        else if(arg == "-n" && has_value) { size = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-w" && has_value) { width = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-s" && has_value) { step = atof(argv[++i]); }
+        else if(arg == "-b" && has_value) { beacons = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-r" && has_value) { range = atof(argv[++i]); }
+        else if(arg == "-j" && has_value) { threads = (unsigned) atoi(argv[++i]); }
+        else if(arg == "--check") { check = true; }
+        else if(arg == "-h" || arg == "--help") { usage(); return 0; }
+        else if(query_file.empty() && arg[0] != '-') { query_file = arg; }
+        else { usage(); return 1; }
+    }
+
+    Graph g;
+    if(!positions_file.empty()) {
+        ifstream in(positions_file);
+        map<uint32_t, pair<double, double>> positions;
+        string line;
+        while(getline(in, line)) {
+            uint32_t node;
+            double x, y;
+            int beacon = 0;
+            if(sscanf(line.c_str(), "%u %lf %lf %d", &node, &x, &y, &beacon) < 3) { continue; }
+            positions[node] = make_pair(x, y);
+            if(beacon) { g.beacons.push_back(node); }
+        }
+        if(positions.empty() || positions.rbegin()->first + 1 != positions.size()) {
+            cerr << "expected nodes 0 to n-1 in " << positions_file << "\n";
+            return 1;
+        }
+        for(auto const& p : positions) {
+            g.x.push_back(p.second.first);
+            g.y.push_back(p.second.second);
+        }
+    } else {
+        if(width == 0) { width = (uint32_t) sqrt(size); }
+        // Same layout as the example's GridPositionAllocator
+        for(uint32_t v = 0; v < size; v++) {
+            g.x.push_back(step * (1 + v % max(width, 1u)));
+            g.y.push_back(step * (1 + v / max(width, 1u)));
+        }
+    }
+    if(g.size() == 0 || range <= 0) {
+        usage();
+        return 1;
+    }
+    if(g.beacons.empty()) {
+        // Same choice as DVHopExample::CreateBeacons
+        beacons = max(1u, min(beacons, g.size() - 1));
+        uint32_t stride = g.size() / beacons;
+        for(uint32_t k = 0; k < beacons; k++) { g.beacons.push_back(k * stride); }
+    }
+    connect(g, range);
+
+    vector<Sequence> sequences(1);
+    {
+        ifstream file;
+        if(!query_file.empty()) {
+            file.open(query_file);
+            if(!file) {
+                cerr << "cannot open " << query_file << "\n";
+                return 1;
+            }
+        }
+        istream& in = query_file.empty() ? cin : file;
+        string line;
+        size_t line_no = 0;
+        while(getline(in, line)) {
+            line_no++;
+            istringstream is(line);
+            Query q;
+            q.line = line_no;
+            if(!(is >> q.op) || q.op[0] == '#') { continue; }
+            if(q.op == "reset") {
+                if(!sequences.back().queries.empty()) { sequences.push_back(Sequence()); }
+                continue;
+            }
+            if(q.op != "fail" && q.op != "add") {
+                cerr << "line " << line_no << ": unknown query " << q.op << "\n";
+                return 1;
+            }
+            int64_t node;
+            while(is >> node) {
+                if(node < 0 || node >= (int64_t) g.size()) {
+                    cerr << "line " << line_no << ": no node " << node << "\n";
+                    return 1;
+                }
+                q.nodes.push_back((uint32_t) node);
+            }
+            sequences.back().queries.push_back(q);
+        }
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    HopEngine base(g);
+    if(threads == 0) { threads = thread::hardware_concurrency(); }
+    if(threads == 0) { threads = 1; }
+
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for(unsigned t = 0; t < threads && t < sequences.size(); t++) {
+        workers.emplace_back([&]() {
+            HopEngine engine(base);
+            size_t s;
+            while((s = next++) < sequences.size()) {
+                Sequence& seq = sequences[s];
+                engine.reset(base);
+                for(const Query& q : seq.queries) {
+                    QueryStats stats = q.op == "fail" ? engine.fail(q.nodes) : engine.add(q.nodes);
+                    if(check) { seq.mismatches += engine.check(); }
+                    ostringstream os;
+                    os << s << "," << q.line << "," << q.op << "," << q.nodes.size() << ",";
+                    os << stats.changed_hops << "," << stats.relocalized << ",";
+                    os << engine.aliveCount() << "," << engine.localizedCount() << "," << engine.meanError() << "\n";
+                    seq.output.push_back(os.str());
+                }
+            }
+        });
+    }
+    for(thread& w : workers) { w.join(); }
+    chrono::duration<double> wall = chrono::steady_clock::now() - start;
+
+    cout << "SEQUENCE,LINE,OP,NODES,CHANGED_HOPS,RELOCALIZED,ALIVE,LOCALIZED,MEAN_ERROR\n";
+    size_t queries = 0;
+    size_t mismatches = 0;
+    for(const Sequence& seq : sequences) {
+        for(const string& line : seq.output) { cout << line; }
+        queries += seq.queries.size();
+        mismatches += seq.mismatches;
+    }
+    cerr << g.size() << " nodes, " << g.beacons.size() << " beacons, " << sequences.size() << " sequences, ";
+    cerr << queries << " queries in " << fixed << setprecision(3) << wall.count() << " s\n";
+    if(check && mismatches) {
+        cerr << mismatches << " hop counts differ from a full recomputation\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <atomic>
+
+#include "pcapng.h"
+
+using namespace std;
+
+// Counters for one node during one time bucket
+struct NodeBucket {
+    uint64_t hellos_sent = 0;
+    uint64_t bytes_on_air = 0;
+    uint64_t copies_captured = 0;
+    set<uint32_t> beacons;
+};
+
+// Results for a whole capture file
+struct CaptureStats {
+    string path;
+    string error;
+    uint64_t frames = 0;
+    uint64_t hellos = 0;
+    uint64_t transmissions = 0;
+    uint64_t tx_bytes = 0;
+    uint64_t last_ts_us = 0;
+    // bucket -> node -> counters
+    map<uint64_t, map<uint32_t, NodeBucket>> buckets;
+    // bucket -> hop count -> transmissions advertising it
+    map<uint64_t, map<uint16_t, uint64_t>> hop_histogram;
+};
+
+// Accounts every HELLO of a capture into per-node, per-bucket counters
+void analyzeCapture(CaptureStats& stats, uint64_t bucket_us) {
+    TransmissionFilter filter;
+    CaptureInfo info;
+    stats.error = readCapture(stats.path, info, [&](const DvhopHello& hello) {
+        stats.hellos++;
+        uint64_t bucket = hello.ts_us / bucket_us;
+        NodeBucket& nb = stats.buckets[bucket][hello.src_ip];
+        nb.copies_captured++;
+        if(!filter.isNewTransmission(hello)) { return; }
+
+        stats.transmissions++;
+        stats.tx_bytes += hello.frame_len;
+        nb.hellos_sent++;
+        nb.bytes_on_air += hello.frame_len;
+        nb.beacons.insert(hello.beacon);
+        stats.hop_histogram[bucket][hello.hops]++;
+    });
+    stats.frames = info.frames;
+    stats.last_ts_us = info.last_ts_us;
+}
+
+void printStats(const CaptureStats& stats, uint64_t bucket_us) {
+    cout << "# FILE," << stats.path << "\n";
+    if(!stats.error.empty()) {
+        cout << "# ERROR," << stats.error << "\n";
+    }
+    double duration_s = stats.last_ts_us / 1e6;
+    cout << "# SUMMARY,FRAMES," << stats.frames << ",HELLOS_CAPTURED," << stats.hellos;
+    cout << ",TRANSMISSIONS," << stats.transmissions << ",BYTES_ON_AIR," << stats.tx_bytes;
+    cout << ",DURATION_S," << duration_s;
+    cout << ",AIRTIME_BYTES_PER_S," << (duration_s > 0 ? stats.tx_bytes / duration_s : 0.0) << "\n";
+
+    double bucket_s = bucket_us / 1e6;
+    cout << "BUCKET_MS,NODE,HELLOS_SENT,HELLO_RATE_HZ,BYTES_ON_AIR,BEACONS_COVERED,COPIES_CAPTURED\n";
+    for(auto const& b : stats.buckets) {
+        for(auto const& n : b.second) {
+            const NodeBucket& nb = n.second;
+            cout << b.first * bucket_us / 1000 << "," << ipToString(n.first) << ",";
+            cout << nb.hellos_sent << "," << nb.hellos_sent / bucket_s << ",";
+            cout << nb.bytes_on_air << "," << nb.beacons.size() << "," << nb.copies_captured << "\n";
+        }
+    }
+
+    // How many nodes advertised each beacon within a bucket
+    cout << "BUCKET_MS,BEACON,NODES_ADVERTISING\n";
+    for(auto const& b : stats.buckets) {
+        map<uint32_t, uint64_t> coverage;
+        for(auto const& n : b.second) {
+            for(uint32_t beacon : n.second.beacons) { coverage[beacon]++; }
+        }
+        for(auto const& cov : coverage) {
+            cout << b.first * bucket_us / 1000 << "," << ipToString(cov.first) << "," << cov.second << "\n";
+        }
+    }
+
+    cout << "BUCKET_MS,HOPS,TRANSMISSIONS\n";
+    for(auto const& b : stats.hop_histogram) {
+        for(auto const& h : b.second) {
+            cout << b.first * bucket_us / 1000 << "," << h.first << "," << h.second << "\n";
+        }
+    }
+}
+
+void usage() {
+    cerr << "usage: pcap_analyzer [-b bucket_ms] [-j threads] capture.pcap [capture.pcap ...]\n";
+}
+
+int main(int argc, char** argv) {
+    uint64_t bucket_ms = 1000;
+    unsigned threads = thread::hardware_concurrency();
+    vector<string> paths;
+    for(int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if(arg == "-b" && i + 1 < argc) {
+            bucket_ms = stoull(argv[++i]);
+        } else if(arg == "-j" && i + 1 < argc) {
+            threads = (unsigned) stoul(argv[++i]);
+        } else if(arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if(paths.empty() || bucket_ms == 0) {
+        usage();
+        return 1;
+    }
+    if(threads == 0) { threads = 1; }
+
+    // One capture per worker, results are printed in argument order
+    vector<CaptureStats> results(paths.size());
+    for(size_t i = 0; i < paths.size(); i++) { results[i].path = paths[i]; }
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for(unsigned t = 0; t < threads && t < paths.size(); t++) {
+        workers.emplace_back([&]() {
+            size_t i;
+            while((i = next++) < results.size()) {
+                analyzeCapture(results[i], bucket_ms * 1000);
+            }
+        });
+    }
+    for(thread& w : workers) { w.join(); }
+
+    for(const CaptureStats& stats : results) {
+        printStats(stats, bucket_ms * 1000);
+    }
+    return 0;
+}
@@ -0,0 +1,283 @@
+#ifndef PCAPNG_H
+#define PCAPNG_H
+
+// Memory-mapped pcapng reader decoding DV-Hop HELLOs, shared by the capture utilities
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// pcapng block types
+const uint32_t BLOCK_SHB = 0x0A0D0D0A;
+const uint32_t BLOCK_IDB = 0x00000001;
+const uint32_t BLOCK_EPB = 0x00000006;
+const uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+
+// Link types written by ns-3 wifi pcap helpers
+const uint16_t LINKTYPE_IEEE802_11 = 105;
+const uint16_t LINKTYPE_IEEE802_11_RADIOTAP = 127;
+
+// UDP port used by dvhop::RoutingProtocol
+const uint16_t DVHOP_PORT = 1234;
+
+// Serialized size of a dvhop::FloodingHeader
+const uint32_t FLOODING_HEADER_SIZE = 24;
+
+// dvhop::TypeHeader byte in front of every message; older captures have bare FloodingHeaders
+const uint8_t DVHOP_TYPE_HELLO = 1;
+const uint8_t DVHOP_TYPE_COMPACT_HELLO = 3;
+
+// Serialized size of a dvhop::CompactHelloHeader
+const uint32_t COMPACT_HELLO_HEADER_SIZE = 10;
+
+// Two copies of the same HELLO seen within this window are one transmission
+// captured by several devices (mergecap keeps the sender's and every receiver's copy)
+const uint64_t DUPLICATE_WINDOW_US = 50000;
+
+struct PcapInterface {
+    uint16_t link_type;
+    uint64_t ts_units_per_sec;
+};
+
+// One FloodingHeader found in a captured frame
+struct DvhopHello {
+    uint64_t ts_us;
+    uint32_t src_ip;
+    uint32_t frame_len;
+    uint16_t seq;
+    uint16_t hops;
+    uint32_t beacon;
+    double x;       // NaN for compact HELLOs
+    double y;
+};
+
+// Totals of a capture walk
+struct CaptureInfo {
+    uint64_t frames = 0;
+    uint64_t last_ts_us = 0;
+};
+
+// Reader over a memory-mapped capture honoring the section's byte order
+struct Cursor {
+    const uint8_t* base;
+    size_t size;
+    bool swap;
+
+    uint16_t u16(size_t off) const {
+        uint16_t v;
+        memcpy(&v, base + off, sizeof(v));
+        return swap ? __builtin_bswap16(v) : v;
+    }
+
+    uint32_t u32(size_t off) const {
+        uint32_t v;
+        memcpy(&v, base + off, sizeof(v));
+        return swap ? __builtin_bswap32(v) : v;
+    }
+};
+
+inline uint16_t be16(const uint8_t* p) { return (uint16_t) ((p[0] << 8) | p[1]); }
+inline uint16_t le16(const uint8_t* p) { return (uint16_t) (p[0] | (p[1] << 8)); }
+inline uint32_t be32(const uint8_t* p) { return ((uint32_t) be16(p) << 16) | be16(p + 2); }
+inline uint64_t be64(const uint8_t* p) { return ((uint64_t) be32(p) << 32) | be32(p + 4); }
+
+inline double beDouble(const uint8_t* p) {
+    uint64_t bits = be64(p);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline std::string ipToString(uint32_t ip) {
+    std::ostringstream os;
+    os << (ip >> 24) << "." << ((ip >> 16) & 0xff) << "." << ((ip >> 8) & 0xff) << "." << (ip & 0xff);
+    return os.str();
+}
+
+// Reads the if_tsresol option of an IDB; defaults to microseconds
+inline uint64_t parseTsResolution(const Cursor& c, size_t opt, size_t end) {
+    while(opt + 4 <= end) {
+        uint16_t code = c.u16(opt);
+        uint16_t len = c.u16(opt + 2);
+        if(code == 0) { break; }
+        if(code == 9 && len >= 1) {
+            uint8_t res = c.base[opt + 4];
+            uint64_t units = 1;
+            if(res & 0x80) {
+                for(int i = 0; i < (res & 0x7f); i++) { units *= 2; }
+            } else {
+                for(int i = 0; i < res; i++) { units *= 10; }
+            }
+            return units;
+        }
+        opt += 4 + ((len + 3) & ~3u);
+    }
+    return 1000000;
+}
+
+// Decodes one captured frame down to the FloodingHeader, false if it is not a HELLO
+inline bool decodeHello(const PcapInterface& iface, const uint8_t* frame, uint32_t caplen, DvhopHello& hello) {
+    const uint8_t* p = frame;
+    const uint8_t* end = frame + caplen;
+
+    if(iface.link_type == LINKTYPE_IEEE802_11_RADIOTAP) {
+        if(end - p < 4) { return false; }
+        uint16_t it_len = le16(p + 2);
+        p += it_len;
+    } else if(iface.link_type != LINKTYPE_IEEE802_11) {
+        return false;
+    }
+
+    // 802.11 MAC header: only data frames carry HELLOs
+    if(end - p < 24) { return false; }
+    uint8_t fc0 = p[0];
+    uint8_t fc1 = p[1];
+    if(((fc0 >> 2) & 0x3) != 2) { return false; }
+    size_t mac_len = 24;
+    if((fc1 & 0x3) == 0x3) { mac_len += 6; }
+    if(fc0 & 0x80) { mac_len += 2; }
+    p += mac_len;
+
+    // LLC/SNAP carrying IPv4
+    if(end - p < 8) { return false; }
+    if(p[0] != 0xaa || p[1] != 0xaa || be16(p + 6) != 0x0800) { return false; }
+    p += 8;
+
+    // IPv4
+    if(end - p < 20 || (p[0] >> 4) != 4) { return false; }
+    size_t ihl = (p[0] & 0xf) * 4;
+    if(p[9] != 17 || end - p < (long) ihl) { return false; }
+    hello.src_ip = be32(p + 12);
+    p += ihl;
+
+    // UDP
+    if(end - p < 8) { return false; }
+    if(be16(p + 2) != DVHOP_PORT) { return false; }
+    uint16_t udp_len = be16(p + 4);
+    p += 8;
+    if(udp_len < 8 + 1) { return false; }
+    if(udp_len != 8 + FLOODING_HEADER_SIZE) {
+        // Typed message: only HELLOs are decoded, position messages are skipped
+        if(end - p < 1) { return false; }
+        uint8_t type = p[0];
+        p += 1;
+        if(type == DVHOP_TYPE_COMPACT_HELLO) {
+            // CompactHelloHeader: beacon, seq, hops, position version (network order), no position
+            if(end - p < COMPACT_HELLO_HEADER_SIZE) { return false; }
+            hello.beacon = be32(p);
+            hello.seq = be16(p + 4);
+            hello.hops = be16(p + 6);
+            hello.x = std::numeric_limits<double>::quiet_NaN();
+            hello.y = std::numeric_limits<double>::quiet_NaN();
+            return true;
+        }
+        if(type != DVHOP_TYPE_HELLO) { return false; }
+    }
+    if(end - p < FLOODING_HEADER_SIZE) { return false; }
+
+    // FloodingHeader: X, Y (network order), seq, hops (Buffer::WriteU16, little endian), beacon,
+    // then the hop size correction when bit 15 of the hops is set
+    hello.x = beDouble(p);
+    hello.y = beDouble(p + 8);
+    hello.seq = le16(p + 16);
+    hello.hops = le16(p + 18) & 0x7fff;
+    hello.beacon = be32(p + 20);
+    return true;
+}
+
+// Tells apart a new transmission from another device's copy of one already seen
+class TransmissionFilter {
+public:
+    bool isNewTransmission(const DvhopHello& hello) {
+        uint64_t key = ((uint64_t) hello.src_ip << 32) | ((uint64_t) hello.seq << 16) | (hello.beacon & 0xffff);
+        auto it = last_seen.find(key);
+        if(it != last_seen.end() && hello.ts_us - it->second < DUPLICATE_WINDOW_US) {
+            return false;
+        }
+        last_seen[key] = hello.ts_us;
+        return true;
+    }
+
+private:
+    std::unordered_map<uint64_t, uint64_t> last_seen;
+};
+
+// Walks every block of a memory-mapped pcapng file, returns an error message or an empty string
+inline std::string readCapture(const std::string& path, CaptureInfo& info,
+                               const std::function<void(const DvhopHello&)>& onHello) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) { return "cannot open"; }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < 12) {
+        close(fd);
+        return "empty or unreadable";
+    }
+    size_t size = (size_t) st.st_size;
+    void* map_addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map_addr == MAP_FAILED) { return "mmap failed"; }
+    madvise(map_addr, size, MADV_SEQUENTIAL);
+
+    Cursor c = { (const uint8_t*) map_addr, size, false };
+    std::vector<PcapInterface> interfaces;
+    std::string error;
+
+    size_t off = 0;
+    while(off + 12 <= size) {
+        uint32_t raw_type;
+        memcpy(&raw_type, c.base + off, sizeof(raw_type));
+        if(raw_type == BLOCK_SHB) {
+            uint32_t magic;
+            memcpy(&magic, c.base + off + 8, sizeof(magic));
+            c.swap = (magic != BYTE_ORDER_MAGIC);
+            interfaces.clear();
+        }
+        uint32_t type = c.u32(off);
+        uint32_t len = c.u32(off + 4);
+        if(len < 12 || off + len > size) {
+            error = "truncated block";
+            break;
+        }
+
+        if(type == BLOCK_IDB) {
+            PcapInterface iface;
+            iface.link_type = c.u16(off + 8);
+            iface.ts_units_per_sec = parseTsResolution(c, off + 16, off + len - 4);
+            interfaces.push_back(iface);
+        } else if(type == BLOCK_EPB && len >= 32) {
+            uint32_t if_id = c.u32(off + 8);
+            uint64_t ts = ((uint64_t) c.u32(off + 12) << 32) | c.u32(off + 16);
+            uint32_t caplen = c.u32(off + 20);
+            uint32_t origlen = c.u32(off + 24);
+            if(if_id < interfaces.size() && 28 + (size_t) caplen <= len) {
+                const PcapInterface& iface = interfaces[if_id];
+                DvhopHello hello;
+                hello.ts_us = ts;
+                if(iface.ts_units_per_sec != 1000000) {
+                    hello.ts_us = (uint64_t) ((long double) ts * 1000000.0L / iface.ts_units_per_sec);
+                }
+                hello.frame_len = origlen;
+                info.frames++;
+                if(hello.ts_us > info.last_ts_us) { info.last_ts_us = hello.ts_us; }
+                if(decodeHello(iface, c.base + off + 28, caplen, hello)) {
+                    onHello(hello);
+                }
+            }
+        }
+        off += len;
+    }
+
+    munmap(map_addr, size);
+    return error;
+}
+
+#endif // PCAPNG_H
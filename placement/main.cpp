@@ -0,0 +1,419 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include "batch-localization.h"
+
+using namespace std;
+using namespace ns3::dvhop;
+
+static const uint16_t UNREACHABLE = 0xffff;
+
+// A deployment: node positions and the hop count between every pair of nodes
+struct Deployment {
+    vector<double> x;
+    vector<double> y;
+    vector<uint32_t> offset;
+    vector<uint32_t> adj;
+    vector<uint16_t> hops;      // hops[a * n + b]
+    double diagonal = 0;        // error charged to a node that cannot be localized
+
+    uint32_t size() const { return (uint32_t) x.size(); }
+    uint16_t hopsBetween(uint32_t a, uint32_t b) const { return hops[(size_t) a * size() + b]; }
+};
+
+// Beacon node ids, kept sorted like the beacons' addresses
+typedef vector<uint32_t> Placement;
+
+struct Score {
+    double mean = 0;
+    double p95 = 0;
+    size_t localized = 0;
+};
+
+enum Objective { OBJECTIVE_MEAN, OBJECTIVE_P95 };
+
+double objectiveOf(const Score& s, Objective objective) { return objective == OBJECTIVE_MEAN ? s.mean : s.p95; }
+
+void parallel(unsigned threads, size_t jobs, const function<void(size_t, unsigned)>& work) {
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for(unsigned t = 0; t < threads && t < jobs; t++) {
+        workers.emplace_back([&, t]() {
+            size_t i;
+            while((i = next++) < jobs) { work(i, t); }
+        });
+    }
+    for(thread& w : workers) { w.join(); }
+}
+
+// Links nodes closer than range, then runs a BFS from every node
+void connect(Deployment& d, double range, unsigned threads) {
+    uint32_t n = d.size();
+    map<pair<int64_t, int64_t>, vector<uint32_t>> cells;
+    auto cell = [&](uint32_t v) { return make_pair((int64_t) floor(d.x[v] / range), (int64_t) floor(d.y[v] / range)); };
+    for(uint32_t v = 0; v < n; v++) { cells[cell(v)].push_back(v); }
+    d.offset.assign(1, 0);
+    for(uint32_t v = 0; v < n; v++) {
+        pair<int64_t, int64_t> c = cell(v);
+        for(int64_t dx = -1; dx <= 1; dx++) {
+            for(int64_t dy = -1; dy <= 1; dy++) {
+                auto it = cells.find(make_pair(c.first + dx, c.second + dy));
+                if(it == cells.end()) { continue; }
+                for(uint32_t w : it->second) {
+                    if(w != v && hypot(d.x[v] - d.x[w], d.y[v] - d.y[w]) <= range) { d.adj.push_back(w); }
+                }
+            }
+        }
+        d.offset.push_back((uint32_t) d.adj.size());
+    }
+
+    d.hops.assign((size_t) n * n, UNREACHABLE);
+    parallel(threads, n, [&](size_t source, unsigned) {
+        uint16_t* h = &d.hops[source * n];
+        vector<uint32_t> queue(1, (uint32_t) source);
+        h[source] = 0;
+        for(size_t head = 0; head < queue.size(); head++) {
+            uint32_t u = queue[head];
+            for(uint32_t e = d.offset[u]; e < d.offset[u + 1]; e++) {
+                uint32_t w = d.adj[e];
+                if(h[w] == UNREACHABLE) {
+                    h[w] = (uint16_t) (h[u] + 1);
+                    queue.push_back(w);
+                }
+            }
+        }
+    });
+
+    double lx = *min_element(d.x.begin(), d.x.end()), hx = *max_element(d.x.begin(), d.x.end());
+    double ly = *min_element(d.y.begin(), d.y.end()), hy = *max_element(d.y.begin(), d.y.end());
+    d.diagonal = hypot(hx - lx, hy - ly);
+}
+
+/**
+ * Localizes every other node the way the simulation does (3 nearest beacons,
+ * hop size from those three, Trilaterate) and scores the errors. Nodes that
+ * reach fewer than 3 beacons count with the deployment's diagonal as error.
+ * Reuses its buffers, so keep one per thread.
+ */
+class Evaluator {
+public:
+    explicit Evaluator(const Deployment& deployment) : d(deployment) {}
+
+    Score evaluate(const Placement& beacons) {
+        uint32_t n = d.size();
+        for(vector<double>& column : soa) { column.clear(); }
+        slots.clear();
+        errors.clear();
+        is_beacon.assign(n, 0);
+        for(uint32_t b : beacons) { is_beacon[b] = 1; }
+
+        size_t unlocalized = 0;
+        for(uint32_t v = 0; v < n; v++) {
+            if(is_beacon[v]) { continue; }
+            // Ties go to the higher address, like RoutingProtocol::RecvDvhop
+            uint32_t chosen[3];
+            uint16_t chosen_hops[3];
+            uint32_t found = 0;
+            for(uint32_t b : beacons) {
+                uint16_t h = d.hopsBetween(b, v);
+                if(h == UNREACHABLE) { continue; }
+                uint32_t at = 0;
+                while(at < found && chosen_hops[at] < h) { at++; }
+                if(at == 3) { continue; }
+                for(uint32_t c = min(found, 2u); c > at; c--) {
+                    chosen[c] = chosen[c - 1];
+                    chosen_hops[c] = chosen_hops[c - 1];
+                }
+                chosen[at] = b;
+                chosen_hops[at] = h;
+                found = min(found + 1, 3u);
+            }
+            if(found < 3) {
+                unlocalized++;
+                continue;
+            }
+            for(int c = 0; c < 3; c++) {
+                soa[c * 3].push_back(d.x[chosen[c]]);
+                soa[c * 3 + 1].push_back(d.y[chosen[c]]);
+                soa[c * 3 + 2].push_back(chosen_hops[c]);
+            }
+            slots.push_back(v);
+        }
+
+        Score score;
+        if(!slots.empty()) {
+            BeaconTriples in = { soa[0].data(), soa[1].data(), soa[2].data(), soa[3].data(), soa[4].data(),
+                                 soa[5].data(), soa[6].data(), soa[7].data(), soa[8].data(), nullptr };
+            px.resize(slots.size());
+            py.resize(slots.size());
+            valid.resize(slots.size());
+            BatchPositions pos = { px.data(), py.data(), valid.data() };
+            BatchLocalize(in, slots.size(), pos);
+            for(size_t i = 0; i < slots.size(); i++) {
+                // Degenerate geometry gets the centroid fallback here but NaN in the simulation
+                if(!valid[i] || !isfinite(px[i]) || !isfinite(py[i])) {
+                    unlocalized++;
+                    continue;
+                }
+                errors.push_back(hypot(px[i] - d.x[slots[i]], py[i] - d.y[slots[i]]));
+            }
+        }
+        score.localized = errors.size();
+        errors.insert(errors.end(), unlocalized, d.diagonal);
+        if(errors.empty()) { return score; }
+        for(double e : errors) { score.mean += e; }
+        score.mean /= errors.size();
+        size_t rank = min(errors.size() - 1, (size_t) ceil(0.95 * errors.size()) - 1);
+        nth_element(errors.begin(), errors.begin() + rank, errors.end());
+        score.p95 = errors[rank];
+        return score;
+    }
+
+private:
+    const Deployment& d;
+    vector<double> soa[9];
+    vector<uint32_t> slots;
+    vector<double> px;
+    vector<double> py;
+    vector<uint8_t> valid;
+    vector<double> errors;
+    vector<uint8_t> is_beacon;
+};
+
+struct SearchResult {
+    Placement best;
+    Score score;
+    uint64_t evaluations = 0;
+};
+
+Placement swapped(const Placement& p, size_t slot, uint32_t node) {
+    Placement q = p;
+    q[slot] = node;
+    sort(q.begin(), q.end());
+    return q;
+}
+
+// Best-improvement local search: every round tries moving each beacon to each other node
+// (in parallel) and keeps the best move, until no move helps
+SearchResult greedy(const Deployment& d, const Placement& start, Objective objective, unsigned threads, uint32_t rounds) {
+    vector<Evaluator> evaluators(threads, Evaluator(d));
+    SearchResult result;
+    result.best = start;
+    result.score = evaluators[0].evaluate(start);
+    result.evaluations = 1;
+    uint32_t n = d.size();
+    for(uint32_t round = 0; round < rounds; round++) {
+        vector<uint8_t> is_beacon(n, 0);
+        for(uint32_t b : result.best) { is_beacon[b] = 1; }
+        vector<pair<double, Placement>> best_of(threads, make_pair(objectiveOf(result.score, objective), Placement()));
+        size_t moves = result.best.size() * n;
+        parallel(threads, moves, [&](size_t move, unsigned t) {
+            uint32_t node = (uint32_t) (move % n);
+            if(is_beacon[node]) { return; }
+            Placement candidate = swapped(result.best, move / n, node);
+            double value = objectiveOf(evaluators[t].evaluate(candidate), objective);
+            if(value < best_of[t].first) { best_of[t] = make_pair(value, candidate); }
+        });
+        result.evaluations += moves - result.best.size() * result.best.size();
+
+        auto winner = min_element(best_of.begin(), best_of.end());
+        if(winner->second.empty()) { break; }
+        result.best = winner->second;
+        result.score = evaluators[0].evaluate(result.best);
+        cerr << "round " << round + 1 << ": " << objectiveOf(result.score, objective) << "\n";
+    }
+    return result;
+}
+
+// One annealing chain per thread (different seeds), moving a random beacon to a random node;
+// the temperature falls geometrically from 5% of the starting objective to 0.005%
+SearchResult anneal(const Deployment& d, const Placement& start, Objective objective, unsigned threads,
+                    uint32_t iterations, uint64_t seed) {
+    vector<SearchResult> chains(threads);
+    parallel(threads, threads, [&](size_t chain, unsigned) {
+        Evaluator evaluator(d);
+        mt19937_64 rng(seed + chain);
+        SearchResult& r = chains[chain];
+        Placement current = start;
+        double current_value = objectiveOf(evaluator.evaluate(current), objective);
+        r.best = current;
+        double best_value = current_value;
+        double t0 = max(current_value * 0.05, 1e-9);
+        double cooling = pow(1e-3, 1.0 / max(iterations, 1u));
+        double temperature = t0;
+        vector<uint8_t> is_beacon(d.size(), 0);
+        for(uint32_t b : current) { is_beacon[b] = 1; }
+        for(uint32_t i = 0; i < iterations; i++, temperature *= cooling) {
+            size_t slot = rng() % current.size();
+            uint32_t node = (uint32_t) (rng() % d.size());
+            if(is_beacon[node]) { continue; }
+            Placement candidate = swapped(current, slot, node);
+            double value = objectiveOf(evaluator.evaluate(candidate), objective);
+            r.evaluations++;
+            double u = (double) (rng() >> 11) / (double) (1ULL << 53);
+            if(value <= current_value || u < exp((current_value - value) / temperature)) {
+                is_beacon[current[slot]] = 0;
+                is_beacon[node] = 1;
+                current = candidate;
+                current_value = value;
+                if(value < best_value) {
+                    best_value = value;
+                    r.best = current;
+                }
+            }
+        }
+        r.score = evaluator.evaluate(r.best);
+    });
+
+    size_t best = 0;
+    uint64_t evaluations = 0;
+    for(size_t c = 0; c < chains.size(); c++) {
+        if(objectiveOf(chains[c].score, objective) < objectiveOf(chains[best].score, objective)) { best = c; }
+        evaluations += chains[c].evaluations;
+    }
+    SearchResult result = chains[best];
+    result.evaluations = evaluations;
+    return result;
+}
+
+void usage() {
+    cerr << "usage: placement [options]\n";
+    cerr << "  -t file      deployment, one \"node x y [isBeacon]\" per line (as in dvhop.positions)\n";
+    cerr << "  -n nodes     grid size when no deployment is given (default 100)\n";
+    cerr << "  -w n         grid width in nodes (default sqrt(nodes))\n";
+    cerr << "  -s m         grid step in meters (default 50)\n";
+    cerr << "  -r m         radio range in meters (default 110)\n";
+    cerr << "  -b beacons   beacon budget (default: the deployment's beacons, or 12)\n";
+    cerr << "  -m method    greedy or anneal (default greedy)\n";
+    cerr << "  -O objective mean or p95 localization error (default mean)\n";
+    cerr << "  -i n         greedy rounds or annealing iterations per thread (default 50 / 20000)\n";
+    cerr << "  --seed n     annealing seed (default 1)\n";
+    cerr << "  -o file      topology written for the example's topology option (default dvhop.topology)\n";
+    cerr << "  -j n         worker threads (default: all cores)\n";
+}
+
+int main(int argc, char** argv) {
+    string positions_file;
+    string output_file = "dvhop.topology";
+    string method = "greedy";
+    string objective_name = "mean";
+    uint32_t size = 100;
+    uint32_t width = 0;
+    double step = 50;
+    double range = 110;
+    uint32_t budget = 0;
+    uint32_t iterations = 0;
+    uint64_t seed = 1;
+    unsigned threads = 0;
+    for(int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool has_value = i + 1 < argc;
+        if(arg == "-t" && has_value) { positions_file = argv[++i]; }
+        else if(arg == "-n" && has_value) { size = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-w" && has_value) { width = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-s" && has_value) { step = atof(argv[++i]); }
+        else if(arg == "-r" && has_value) { range = atof(argv[++i]); }
+        else if(arg == "-b" && has_value) { budget = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-m" && has_value) { method = argv[++i]; }
+        else if(arg == "-O" && has_value) { objective_name = argv[++i]; }
+        else if(arg == "-i" && has_value) { iterations = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "--seed" && has_value) { seed = strtoull(argv[++i], nullptr, 10); }
+        else if(arg == "-o" && has_value) { output_file = argv[++i]; }
+        else if(arg == "-j" && has_value) { threads = (unsigned) atoi(argv[++i]); }
+        else if(arg == "-h" || arg == "--help") { usage(); return 0; }
+        else { usage(); return 1; }
+    }
+    if((method != "greedy" && method != "anneal") || (objective_name != "mean" && objective_name != "p95") || range <= 0) {
+        usage();
+        return 1;
+    }
+    Objective objective = objective_name == "mean" ? OBJECTIVE_MEAN : OBJECTIVE_P95;
+    if(iterations == 0) { iterations = method == "greedy" ? 50 : 20000; }
+    if(threads == 0) { threads = thread::hardware_concurrency(); }
+    if(threads == 0) { threads = 1; }
+
+    Deployment d;
+    Placement start;
+    if(!positions_file.empty()) {
+        ifstream in(positions_file);
+        map<uint32_t, pair<double, double>> positions;
+        string line;
+        while(getline(in, line)) {
+            uint32_t node;
+            double x, y;
+            int beacon = 0;
+            if(sscanf(line.c_str(), "%u %lf %lf %d", &node, &x, &y, &beacon) < 3) { continue; }
+            positions[node] = make_pair(x, y);
+            if(beacon) { start.push_back(node); }
+        }
+        if(positions.empty() || positions.rbegin()->first + 1 != positions.size()) {
+            cerr << "expected nodes 0 to n-1 in " << positions_file << "\n";
+            return 1;
+        }
+        for(auto const& p : positions) {
+            d.x.push_back(p.second.first);
+            d.y.push_back(p.second.second);
+        }
+    } else {
+        if(width == 0) { width = (uint32_t) sqrt(size); }
+        // Same layout as the example's GridPositionAllocator
+        for(uint32_t v = 0; v < size; v++) {
+            d.x.push_back(step * (1 + v % max(width, 1u)));
+            d.y.push_back(step * (1 + v / max(width, 1u)));
+        }
+    }
+    if(d.size() < 4) {
+        cerr << "need at least 4 nodes\n";
+        return 1;
+    }
+    if(budget == 0) { budget = start.empty() ? 12 : (uint32_t) start.size(); }
+    budget = max(3u, min(budget, d.size() - 1));
+    if(start.size() != budget) {
+        // Same choice as DVHopExample::CreateBeacons
+        start.clear();
+        uint32_t stride = d.size() / budget;
+        for(uint32_t k = 0; k < budget; k++) { start.push_back(k * stride); }
+    }
+    sort(start.begin(), start.end());
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    connect(d, range, threads);
+    Score initial = Evaluator(d).evaluate(start);
+    SearchResult result = method == "greedy" ? greedy(d, start, objective, threads, iterations)
+                                             : anneal(d, start, objective, threads, iterations, seed);
+    chrono::duration<double> wall = chrono::steady_clock::now() - begin;
+
+    ofstream out(output_file);
+    if(!out) {
+        cerr << "cannot write " << output_file << "\n";
+        return 1;
+    }
+    vector<uint8_t> is_beacon(d.size(), 0);
+    for(uint32_t b : result.best) { is_beacon[b] = 1; }
+    for(uint32_t v = 0; v < d.size(); v++) { out << v << " " << d.x[v] << " " << d.y[v] << " " << (int) is_beacon[v] << "\n"; }
+
+    cout << "PLACEMENT,MEAN_ERROR,P95_ERROR,LOCALIZED,BEACONS\n";
+    auto report = [&](const string& name, const Placement& p, const Score& s) {
+        cout << name << "," << s.mean << "," << s.p95 << "," << s.localized << ",";
+        for(size_t k = 0; k < p.size(); k++) { cout << (k ? " " : "") << p[k]; }
+        cout << "\n";
+    };
+    report("initial", start, initial);
+    report(method, result.best, result.score);
+    cerr << d.size() << " nodes, " << budget << " beacons, " << result.evaluations << " placements evaluated in ";
+    cerr << fixed << setprecision(3) << wall.count() << " s, written to " << output_file << "\n";
+    return 0;
+}
@@ -0,0 +1,554 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+
+#include "pcapng.h"
+#include "batch-localization.h"
+
+using namespace std;
+using namespace ns3::dvhop;
+
+// One entry of a node's hop table
+struct Observation {
+    uint32_t beacon;
+    uint16_t hops;
+    double x;
+    double y;
+};
+
+// The hop tables of every node at one point in time
+struct Frame {
+    uint64_t time_ms = 0;
+    map<uint32_t, vector<Observation>> tables;
+};
+
+// A recorded hop table history
+struct Recording {
+    string source;
+    string error;
+    vector<Frame> frames;
+    map<uint32_t, bool> beacons;
+};
+
+// Node id -> true position, from a "node x y" file (as written by the example) or the grid
+struct Truth {
+    map<uint32_t, pair<double, double>> positions;
+    uint32_t width = 10;
+    double step = 50;
+
+    bool lookup(uint32_t node, double& x, double& y) const {
+        if(!positions.empty()) {
+            auto it = positions.find(node);
+            if(it == positions.end()) { return false; }
+            x = it->second.first;
+            y = it->second.second;
+            return true;
+        }
+        x = step * (1 + node % width);
+        y = step * (1 + node / width);
+        return true;
+    }
+};
+
+struct Estimate {
+    bool valid = false;
+    double x = 0;
+    double y = 0;
+};
+
+// A localization method: fills one estimate per node of the frame (in table order)
+struct Strategy {
+    string name;
+    function<void(const Frame&, vector<Estimate>&)> run;
+};
+
+// 10.0.0.k is node k - 1, as assigned by Ipv4AddressHelper in the example
+uint32_t nodeFromIp(uint32_t ip) { return (ip & 0xffffff) - 1; }
+
+uint32_t parseIp(const string& s) {
+    uint32_t ip = 0;
+    istringstream is(s);
+    string part;
+    while(getline(is, part, '.')) { ip = (ip << 8) | (uint32_t) atoi(part.c_str()); }
+    return ip;
+}
+
+//------------------------------------------------------------------------------
+// Loaders
+
+// Text written by DVHopHelper::PrintDistanceTableAllAt: a new frame starts when a node repeats
+void loadDistances(Recording& rec) {
+    ifstream in(rec.source);
+    if(!in) { rec.error = "cannot open"; return; }
+    rec.frames.push_back(Frame());
+    vector<Observation>* table = nullptr;
+    string line;
+    while(getline(in, line)) {
+        size_t node_at = line.find("Node ");
+        if(line.compare(0, 5, "-----") == 0 && node_at != string::npos) {
+            uint32_t node = (uint32_t) atoi(line.c_str() + node_at + 5);
+            if(rec.frames.back().tables.count(node)) { rec.frames.push_back(Frame()); }
+            table = &rec.frames.back().tables[node];
+            continue;
+        }
+        if(!table || line.find("entries") != string::npos) { continue; }
+
+        // beacon \t hops \t (x,y) \t time
+        istringstream is(line);
+        string addr, hops, pos, time;
+        if(!getline(is, addr, '\t') || !getline(is, hops, '\t') || !getline(is, pos, '\t')) { continue; }
+        getline(is, time, '\t');
+        Observation o;
+        o.beacon = nodeFromIp(parseIp(addr));
+        o.hops = (uint16_t) atoi(hops.c_str());
+        if(sscanf(pos.c_str(), "(%lf,%lf)", &o.x, &o.y) != 2) { continue; }
+        table->push_back(o);
+        rec.beacons[o.beacon] = true;
+        uint64_t updated_ms = (uint64_t) (atof(time.c_str()) / 1e6);
+        rec.frames.back().time_ms = max(rec.frames.back().time_ms, updated_ms);
+    }
+    if(rec.frames.back().tables.empty()) { rec.frames.pop_back(); }
+}
+
+// Binary stream written by DVHopHelper::SnapshotDistanceTablesAt
+void loadSnapshots(Recording& rec) {
+    ifstream in(rec.source, ios::binary);
+    if(!in) { rec.error = "cannot open"; return; }
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const uint8_t* p = (const uint8_t*) data.data();
+    size_t size = data.size();
+    size_t off = 0;
+    auto need = [&](size_t n) { return off + n <= size; };
+    auto u8 = [&]() { return p[off++]; };
+    auto u16 = [&]() { uint16_t v = (uint16_t) (p[off] | (p[off + 1] << 8)); off += 2; return v; };
+    auto u32 = [&]() { uint32_t v = u16(); return v | ((uint32_t) u16() << 16); };
+    auto u64 = [&]() { uint64_t v = u32(); return v | ((uint64_t) u32() << 32); };
+    auto f64 = [&]() { uint64_t bits = u64(); double v; memcpy(&v, &bits, sizeof(v)); return v; };
+
+    if(!need(6) || memcmp(p, "DVHS", 4) != 0) { rec.error = "not a snapshot stream"; return; }
+    off = 6;
+
+    // Cumulative state, deltas are applied on top of it
+    map<uint32_t, map<uint32_t, uint16_t>> hops;
+    map<uint32_t, pair<double, double>> positions;
+    while(need(13)) {
+        u8();
+        uint64_t time_ns = u64();
+        uint32_t records = u32();
+        for(uint32_t r = 0; r < records; r++) {
+            if(!need(7)) { rec.error = "truncated snapshot"; return; }
+            uint32_t node = u32();
+            uint8_t flags = u8();
+            if(flags & 1) {
+                if(!need(16)) { rec.error = "truncated snapshot"; return; }
+                double x = f64();
+                positions[node] = make_pair(x, f64());
+            }
+            rec.beacons[node] = (flags & 2) != 0;
+            if(!need(2)) { rec.error = "truncated snapshot"; return; }
+            uint16_t entries = u16();
+            if(!need(entries * 6u)) { rec.error = "truncated snapshot"; return; }
+            for(uint16_t e = 0; e < entries; e++) {
+                uint32_t beacon = nodeFromIp(u32());
+                uint16_t h = u16();
+                if(h == 0) { hops[node].erase(beacon); } else { hops[node][beacon] = h; }
+            }
+        }
+
+        // Beacon positions are the beacons' own (never trilaterated) positions
+        Frame frame;
+        frame.time_ms = time_ns / 1000000;
+        for(auto const& n : hops) {
+            vector<Observation>& table = frame.tables[n.first];
+            for(auto const& e : n.second) {
+                Observation o;
+                o.beacon = e.first;
+                o.hops = e.second;
+                o.x = positions[e.first].first;
+                o.y = positions[e.first].second;
+                table.push_back(o);
+            }
+        }
+        rec.frames.push_back(frame);
+    }
+    for(auto it = rec.beacons.begin(); it != rec.beacons.end();) {
+        if(!it->second) { it = rec.beacons.erase(it); } else { ++it; }
+    }
+}
+
+// A node's table is what it advertised in its HELLOs during the last window
+void loadCapture(Recording& rec, uint64_t interval_ms, uint64_t window_ms, const Truth& truth) {
+    TransmissionFilter filter;
+    CaptureInfo info;
+    // node -> beacon -> (last advertised at, observation)
+    map<uint32_t, map<uint32_t, pair<uint64_t, Observation>>> advertised;
+    uint64_t next_frame_us = interval_ms * 1000;
+
+    auto emit = [&](uint64_t at_us) {
+        Frame frame;
+        frame.time_ms = at_us / 1000;
+        for(auto const& n : advertised) {
+            for(auto const& b : n.second) {
+                if(b.second.first + window_ms * 1000 >= at_us) {
+                    frame.tables[n.first].push_back(b.second.second);
+                }
+            }
+        }
+        rec.frames.push_back(frame);
+    };
+
+    rec.error = readCapture(rec.source, info, [&](const DvhopHello& hello) {
+        if(!filter.isNewTransmission(hello)) { return; }
+        while(hello.ts_us >= next_frame_us) {
+            emit(next_frame_us);
+            next_frame_us += interval_ms * 1000;
+        }
+        uint32_t node = nodeFromIp(hello.src_ip);
+        uint32_t beacon = nodeFromIp(hello.beacon);
+        if(hello.hops == 0) {
+            rec.beacons[beacon] = true;
+            return;
+        }
+        Observation o = { beacon, hello.hops, hello.x, hello.y };
+        // Compact HELLOs leave positions out; beacons do not move, so they are where they were placed
+        if(!isfinite(o.x) && !truth.lookup(beacon, o.x, o.y)) { return; }
+        advertised[node][beacon] = make_pair(hello.ts_us, o);
+    });
+    emit(next_frame_us);
+    // Beacons advertise their own entry but never localize
+    for(Frame& frame : rec.frames) {
+        for(auto const& b : rec.beacons) { frame.tables.erase(b.first); }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Strategies
+
+// The three lowest-hop entries, ties broken like RoutingProtocol::RecvDvhop
+vector<size_t> closestThree(const vector<Observation>& table) {
+    vector<size_t> chosen;
+    for(int n = 0; n < 3; n++) {
+        size_t min_index = 0;
+        uint32_t min_hops = UINT32_MAX;
+        for(size_t k = 0; k < table.size(); k++) {
+            if(table[k].hops <= min_hops && find(chosen.begin(), chosen.end(), k) == chosen.end()) {
+                min_index = k;
+                min_hops = table[k].hops;
+            }
+        }
+        chosen.push_back(min_index);
+    }
+    return chosen;
+}
+
+// The simulation's method: hop size from the 3 nearest beacons, then trilateration
+void trilaterate3(const Frame& frame, vector<Estimate>& out) {
+    vector<double> soa[9];
+    vector<size_t> slots;
+    size_t slot = 0;
+    for(auto const& n : frame.tables) {
+        if(n.second.size() >= 3) {
+            vector<size_t> c = closestThree(n.second);
+            for(int b = 0; b < 3; b++) {
+                const Observation& o = n.second[c[b]];
+                soa[b * 3].push_back(o.x);
+                soa[b * 3 + 1].push_back(o.y);
+                soa[b * 3 + 2].push_back(o.hops);
+            }
+            slots.push_back(slot);
+        }
+        slot++;
+    }
+    if(slots.empty()) { return; }
+
+    BeaconTriples in = { soa[0].data(), soa[1].data(), soa[2].data(), soa[3].data(), soa[4].data(),
+                         soa[5].data(), soa[6].data(), soa[7].data(), soa[8].data(), nullptr };
+    vector<double> x(slots.size()), y(slots.size());
+    vector<uint8_t> valid(slots.size());
+    BatchPositions pos = { x.data(), y.data(), valid.data() };
+    BatchLocalize(in, slots.size(), pos);
+    for(size_t k = 0; k < slots.size(); k++) {
+        out[slots[k]].valid = valid[k] != 0;
+        out[slots[k]].x = x[k];
+        out[slots[k]].y = y[k];
+    }
+}
+
+// Mean distance between the known beacons over their mean hop count
+double hopSize(const vector<Observation>& table) {
+    double distances = 0;
+    uint32_t pairs = 0;
+    double hops = 0;
+    for(size_t i = 0; i < table.size(); i++) {
+        hops += table[i].hops;
+        for(size_t j = i + 1; j < table.size(); j++) {
+            distances += hypot(table[i].x - table[j].x, table[i].y - table[j].y);
+            pairs++;
+        }
+    }
+    if(pairs == 0 || hops == 0) { return 0; }
+    return (distances / pairs) / (hops / table.size());
+}
+
+// Multilateration over every known beacon, weighted by 1 / hops^2
+void weightedLeastSquares(const Frame& frame, vector<Estimate>& out) {
+    size_t slot = 0;
+    for(auto const& n : frame.tables) {
+        const vector<Observation>& t = n.second;
+        Estimate& e = out[slot++];
+        if(t.size() < 3) { continue; }
+        double hs = hopSize(t);
+        size_t ref = 0;
+        for(size_t k = 1; k < t.size(); k++) {
+            if(t[k].hops < t[ref].hops) { ref = k; }
+        }
+        double rr = t[ref].hops * hs;
+        double a11 = 0, a12 = 0, a22 = 0, b1 = 0, b2 = 0;
+        for(size_t k = 0; k < t.size(); k++) {
+            if(k == ref) { continue; }
+            double r = t[k].hops * hs;
+            double ax = 2 * (t[k].x - t[ref].x);
+            double ay = 2 * (t[k].y - t[ref].y);
+            double b = rr * rr - r * r + t[k].x * t[k].x - t[ref].x * t[ref].x + t[k].y * t[k].y - t[ref].y * t[ref].y;
+            double w = 1.0 / ((double) t[k].hops * t[k].hops);
+            a11 += w * ax * ax;
+            a12 += w * ax * ay;
+            a22 += w * ay * ay;
+            b1 += w * ax * b;
+            b2 += w * ay * b;
+        }
+        double det = a11 * a22 - a12 * a12;
+        if(fabs(det) < 1e-12 * (a11 * a22 + 1)) { continue; }
+        e.x = (a22 * b1 - a12 * b2) / det;
+        e.y = (a11 * b2 - a12 * b1) / det;
+        e.valid = true;
+    }
+}
+
+// Center of the intersection of the boxes around each beacon
+void minMax(const Frame& frame, vector<Estimate>& out) {
+    size_t slot = 0;
+    for(auto const& n : frame.tables) {
+        const vector<Observation>& t = n.second;
+        Estimate& e = out[slot++];
+        if(t.size() < 3) { continue; }
+        double hs = hopSize(t);
+        double lx = -INFINITY, hx = INFINITY, ly = -INFINITY, hy = INFINITY;
+        for(const Observation& o : t) {
+            double r = o.hops * hs;
+            lx = max(lx, o.x - r);
+            hx = min(hx, o.x + r);
+            ly = max(ly, o.y - r);
+            hy = min(hy, o.y + r);
+        }
+        e.x = (lx + hx) / 2;
+        e.y = (ly + hy) / 2;
+        e.valid = true;
+    }
+}
+
+// Beacon positions weighted by 1 / hops
+void weightedCentroid(const Frame& frame, vector<Estimate>& out) {
+    size_t slot = 0;
+    for(auto const& n : frame.tables) {
+        const vector<Observation>& t = n.second;
+        Estimate& e = out[slot++];
+        if(t.size() < 3) { continue; }
+        double w_sum = 0;
+        for(const Observation& o : t) {
+            double w = 1.0 / o.hops;
+            e.x += w * o.x;
+            e.y += w * o.y;
+            w_sum += w;
+        }
+        e.x /= w_sum;
+        e.y /= w_sum;
+        e.valid = true;
+    }
+}
+
+const vector<Strategy>& allStrategies() {
+    static const vector<Strategy> strategies = {
+        { "trilaterate3", trilaterate3 },
+        { "wls", weightedLeastSquares },
+        { "minmax", minMax },
+        { "centroid", weightedCentroid },
+    };
+    return strategies;
+}
+
+//------------------------------------------------------------------------------
+
+struct Result {
+    size_t recording;
+    size_t frame;
+    size_t strategy;
+    size_t nodes = 0;
+    size_t localized = 0;
+    double mean = 0;
+    double p50 = 0;
+    double p95 = 0;
+};
+
+void evaluate(const Recording& rec, const Strategy& strategy, const Truth& truth, Result& result) {
+    const Frame& frame = rec.frames[result.frame];
+    vector<Estimate> estimates(frame.tables.size());
+    strategy.run(frame, estimates);
+
+    vector<double> errors;
+    size_t slot = 0;
+    for(auto const& n : frame.tables) {
+        const Estimate& e = estimates[slot++];
+        if(rec.beacons.count(n.first)) { continue; }
+        result.nodes++;
+        double tx, ty;
+        if(!e.valid || !isfinite(e.x) || !isfinite(e.y) || !truth.lookup(n.first, tx, ty)) { continue; }
+        errors.push_back(hypot(e.x - tx, e.y - ty));
+    }
+    result.localized = errors.size();
+    if(errors.empty()) { return; }
+    sort(errors.begin(), errors.end());
+    for(double err : errors) { result.mean += err; }
+    result.mean /= errors.size();
+    result.p50 = errors[(errors.size() - 1) / 2];
+    result.p95 = errors[min(errors.size() - 1, (size_t) ceil(0.95 * errors.size()) - 1)];
+}
+
+void usage() {
+    cerr << "usage: replay [options] recording [recording ...]\n";
+    cerr << "  recordings: *.distances (text dumps), *.snapshots (binary snapshots), *.pcap (captures)\n";
+    cerr << "  -t file      true positions, one \"node x y\" per line (default: grid positions)\n";
+    cerr << "  -w n         grid width in nodes (default 10)\n";
+    cerr << "  -s m         grid step in meters (default 50)\n";
+    cerr << "  -S a,b,...   strategies to run (default: all of";
+    for(const Strategy& s : allStrategies()) { cerr << " " << s.name; }
+    cerr << ")\n";
+    cerr << "  -i ms        frame interval for captures (default 1000)\n";
+    cerr << "  --final      only evaluate the last frame of every recording\n";
+    cerr << "  -j n         worker threads (default: all cores)\n";
+}
+
+bool endsWith(const string& s, const string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char** argv) {
+    Truth truth;
+    string truth_file;
+    string strategy_list;
+    uint64_t interval_ms = 1000;
+    bool final_only = false;
+    unsigned threads = 0;
+    vector<Recording> recordings;
+    for(int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool has_value = i + 1 < argc;
+        if(arg == "-t" && has_value) { truth_file = argv[++i]; }
+        else if(arg == "-w" && has_value) { truth.width = (uint32_t) atoi(argv[++i]); }
+        else if(arg == "-s" && has_value) { truth.step = atof(argv[++i]); }
+        else if(arg == "-S" && has_value) { strategy_list = argv[++i]; }
+        else if(arg == "-i" && has_value) { interval_ms = strtoull(argv[++i], nullptr, 10); }
+        else if(arg == "-j" && has_value) { threads = (unsigned) atoi(argv[++i]); }
+        else if(arg == "--final") { final_only = true; }
+        else if(arg == "-h" || arg == "--help") { usage(); return 0; }
+        else {
+            Recording rec;
+            rec.source = arg;
+            recordings.push_back(rec);
+        }
+    }
+    if(recordings.empty() || truth.width == 0 || interval_ms == 0) {
+        usage();
+        return 1;
+    }
+
+    if(!truth_file.empty()) {
+        ifstream in(truth_file);
+        uint32_t node;
+        double x, y;
+        string line;
+        while(getline(in, line)) {
+            if(sscanf(line.c_str(), "%u %lf %lf", &node, &x, &y) == 3) { truth.positions[node] = make_pair(x, y); }
+        }
+        if(truth.positions.empty()) {
+            cerr << "no positions in " << truth_file << "\n";
+            return 1;
+        }
+    }
+
+    vector<Strategy> strategies;
+    if(strategy_list.empty()) {
+        strategies = allStrategies();
+    } else {
+        istringstream is(strategy_list);
+        string name;
+        while(getline(is, name, ',')) {
+            auto it = find_if(allStrategies().begin(), allStrategies().end(), [&](const Strategy& s) { return s.name == name; });
+            if(it == allStrategies().end()) {
+                cerr << "unknown strategy " << name << "\n";
+                return 1;
+            }
+            strategies.push_back(*it);
+        }
+    }
+    if(threads == 0) { threads = thread::hardware_concurrency(); }
+    if(threads == 0) { threads = 1; }
+
+    auto parallel = [&](size_t jobs, const function<void(size_t)>& work) {
+        atomic<size_t> next(0);
+        vector<thread> workers;
+        for(unsigned t = 0; t < threads && t < jobs; t++) {
+            workers.emplace_back([&]() {
+                size_t i;
+                while((i = next++) < jobs) { work(i); }
+            });
+        }
+        for(thread& w : workers) { w.join(); }
+    };
+
+    parallel(recordings.size(), [&](size_t i) {
+        Recording& rec = recordings[i];
+        if(endsWith(rec.source, ".pcap") || endsWith(rec.source, ".pcapng")) { loadCapture(rec, interval_ms, interval_ms, truth); }
+        else if(endsWith(rec.source, ".snapshots")) { loadSnapshots(rec); }
+        else { loadDistances(rec); }
+    });
+
+    vector<Result> results;
+    for(size_t r = 0; r < recordings.size(); r++) {
+        if(!recordings[r].error.empty()) {
+            cerr << recordings[r].source << ": " << recordings[r].error << "\n";
+        }
+        size_t count = recordings[r].frames.size();
+        for(size_t f = (final_only && count ? count - 1 : 0); f < count; f++) {
+            for(size_t s = 0; s < strategies.size(); s++) {
+                Result res;
+                res.recording = r;
+                res.frame = f;
+                res.strategy = s;
+                results.push_back(res);
+            }
+        }
+    }
+    parallel(results.size(), [&](size_t i) {
+        Result& res = results[i];
+        evaluate(recordings[res.recording], strategies[res.strategy], truth, res);
+    });
+
+    cout << "SOURCE,TIME_MS,STRATEGY,NODES,LOCALIZED,MEAN_ERROR,P50_ERROR,P95_ERROR\n";
+    for(const Result& res : results) {
+        cout << recordings[res.recording].source << "," << recordings[res.recording].frames[res.frame].time_ms << ",";
+        cout << strategies[res.strategy].name << "," << res.nodes << "," << res.localized << ",";
+        cout << res.mean << "," << res.p50 << "," << res.p95 << "\n";
+    }
+    return 0;
+}
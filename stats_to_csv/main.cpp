@@ -1,6 +1,11 @@
 #include <iostream>
 #include <iomanip>
 #include <vector>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
 
 using namespace std;
 
@@ -44,7 +49,60 @@ bool isNode(string& line) {
     return true;
 }
 
-int main() {
+void usage() {
+    cerr << "usage: stats_to_csv [-e interval_ms] < simulation_output > output.csv\n"
+         << "  -e  rebuild full time series from delta reports: every interval_ms, one row\n"
+         << "      per node holding its last record, instead of one row per record\n";
+}
+
+// Dotted quad as a number, so expanded output lists nodes in address order
+uint32_t addressValue(const string& address) {
+    unsigned a = 0, b = 0, c = 0, d = 0;
+    sscanf(address.c_str(), "%u.%u.%u.%u", &a, &b, &c, &d);
+    return (a << 24) | ((b & 0xff) << 16) | ((c & 0xff) << 8) | (d & 0xff);
+}
+
+// Last record of a node, held until the next one in expanded output
+struct NodeRecord {
+    string address;
+    string hop_table_size;
+    string position_x;
+    string position_y;
+    string error_x;
+    string error_y;
+};
+
+void printNode(const string& time, const NodeRecord& r) {
+    cout << time << "," << r.address << "," << r.hop_table_size << ",";
+    cout << r.position_x << "," << r.position_y << ",";
+    cout << r.error_x << "," << r.error_y << ", " << "NONE" << "\n";
+}
+
+int main(int argc, char** argv) {
+    long long interval = 0;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "-e" && i + 1 < argc) {
+            interval = atoll(argv[++i]);
+            if(interval <= 0) { usage(); return 1; }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    // Expanded output: nodes by address, and the next sampling time
+    map<uint32_t, NodeRecord> nodes;
+    long long next_tick = 0;
+    long long last_time = -1;
+    auto emitTicksBefore = [&](long long time) {
+        for(; next_tick < time; next_tick += interval) {
+            for(auto const& n : nodes) {
+                printNode(to_string(next_tick), n.second);
+            }
+        }
+    };
+
     cout << "TIME,ADDRESS,HOP_TABLE_SIZE,POSITION_X,POSITION_Y,ERROR_X,ERROR_Y,EVENTCODE";
     while(!cin.eof()) {
         string line;
@@ -54,21 +112,35 @@ int main() {
                 vector<string> parts = splitByAt(line);
                 string time = parts.at(2);
                 string event_code = parts.at(4);
+                if(interval > 0) {
+                    last_time = atoll(time.c_str());
+                    emitTicksBefore(last_time);
+                }
                 cout << time << ",,,,,,," << event_code << "\n"; 
             } else if(isNode(line)) {
                 vector<string> parts = splitByAt(line);
                 string time = parts.at(2);
                 string address = parts.at(4);
-                string hop_table_size = parts.at(6);
-                string position_x = parts.at(8);
-                string position_y = parts.at(10);
-                string error_x = parts.at(12);
-                string error_y = parts.at(14);
-                string eventcode = "NONE";
-                cout << time << "," << address << "," << hop_table_size << ",";
-                cout << position_x << "," << position_y << ",";
-                cout << error_x << "," << error_y << ", " << eventcode << "\n";
+                NodeRecord record;
+                record.address = address;
+                record.hop_table_size = parts.at(6);
+                record.position_x = parts.at(8);
+                record.position_y = parts.at(10);
+                record.error_x = parts.at(12);
+                record.error_y = parts.at(14);
+                if(interval > 0) {
+                    // Samples before this record still show the previous one
+                    last_time = atoll(time.c_str());
+                    emitTicksBefore(last_time);
+                    nodes[addressValue(address)] = record;
+                } else {
+                    printNode(time, record);
+                }
             }
         }
     }
-}
\ No newline at end of file
+    if(interval > 0) {
+        // Through the first sample at or after the last record
+        emitTicksBefore(last_time + interval);
+    }
+}